@@ -0,0 +1,155 @@
+/**
+ * @file  bench-archive.cpp
+ * @brief Timing tests for bulk archive modifications.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // createString
+#include <camoto/gamearchive.hpp>
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Size of each file inserted into the archive.
+#define BENCH_LUMP_SIZE 16
+
+/// Insert a number of small files into a new archive, then flush it.
+/**
+ * @param code
+ *   Archive format to use.
+ *
+ * @param numFiles
+ *   Number of files to insert.
+ *
+ * @param atStart
+ *   true to insert each file before the first one, false to append each file
+ *   to the end of the archive.
+ *
+ * @return Time taken in milliseconds, including the flush.
+ */
+double benchInsert(const std::string& code, unsigned int numFiles,
+	bool atStart)
+{
+	auto archType = ArchiveManager::byCode(code);
+	if (!archType) throw camoto::error("Unknown archive format: " + code);
+
+	SuppData supps;
+	auto arch = archType->create(std::make_unique<stream::string>(), supps);
+
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < numFiles; i++) {
+		Archive::FileHandle idBeforeThis;
+		if (atStart && !arch->files().empty()) {
+			idBeforeThis = arch->files().front();
+		}
+		arch->insert(idBeforeThis, createString("LUMP" << i), BENCH_LUMP_SIZE,
+			FILETYPE_GENERIC, Archive::File::Attribute::Default);
+	}
+	arch->flush();
+	auto tEnd = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+/// Repeatedly resize the first or last file in a large archive.
+/**
+ * Resizing the last file only changes that file, so this should not get any
+ * slower as the number of files in front of it grows.  Resizing the first file
+ * moves every other file, so this checks that the format writes all the
+ * changed offsets out together (e.g. with a single updateFileOffsets() call)
+ * instead of one file at a time.
+ *
+ * @param code
+ *   Archive format to use.
+ *
+ * @param numFiles
+ *   Number of files in the archive.
+ *
+ * @param numResizes
+ *   Number of times to resize the file.
+ *
+ * @param first
+ *   true to resize the first file, false to resize the last one.
+ *
+ * @return Time taken in milliseconds, including the final flush.
+ */
+double benchResize(const std::string& code, unsigned int numFiles,
+	unsigned int numResizes, bool first)
+{
+	auto archType = ArchiveManager::byCode(code);
+	if (!archType) throw camoto::error("Unknown archive format: " + code);
+
+	SuppData supps;
+	auto arch = archType->create(std::make_unique<stream::string>(), supps);
+	for (unsigned int i = 0; i < numFiles; i++) {
+		arch->insert(nullptr, createString("LUMP" << i), BENCH_LUMP_SIZE,
+			FILETYPE_GENERIC, Archive::File::Attribute::Default);
+	}
+	arch->flush();
+
+	auto id = first ? arch->files().front() : arch->files().back();
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < numResizes; i++) {
+		stream::len newSize = BENCH_LUMP_SIZE + (i % 2);
+		arch->resize(id, newSize, newSize);
+	}
+	arch->flush();
+	auto tEnd = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+int main(void)
+{
+	const std::string code = "wad-doom";
+
+	std::cout << "Bulk insert of " << BENCH_LUMP_SIZE << "-byte files into "
+		<< code << "\n\n"
+		<< "   files   append ms  us/file   prepend ms  us/file\n";
+
+	for (unsigned int numFiles = 625; numFiles <= 5000; numFiles *= 2) {
+		double msAppend = benchInsert(code, numFiles, false);
+		double msPrepend = benchInsert(code, numFiles, true);
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(8) << numFiles
+			<< std::setw(12) << msAppend
+			<< std::setw(9) << msAppend * 1000 / numFiles
+			<< std::setw(13) << msPrepend
+			<< std::setw(9) << msPrepend * 1000 / numFiles
+			<< "\n";
+	}
+	std::cout << "\nThe time per file should stay roughly the same as the number "
+		"of files grows.\n";
+
+	std::cout << "\n1000x resize of the first and last file\n\n"
+		<< "   files    first ms     last ms\n";
+	for (unsigned int numFiles = 625; numFiles <= 10000; numFiles *= 2) {
+		double msFirst = benchResize(code, numFiles, 1000, true);
+		double msLast = benchResize(code, numFiles, 1000, false);
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(8) << numFiles
+			<< std::setw(12) << msFirst
+			<< std::setw(12) << msLast
+			<< "\n";
+	}
+
+	return 0;
+}
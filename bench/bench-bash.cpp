@@ -0,0 +1,159 @@
+/**
+ * @file  bench-bash.cpp
+ * @brief Speed of reading compressed files from a Monster Bash .DAT archive.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <camoto/filter-lzw.hpp>
+#include <camoto/stream_filtered.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // createString
+#include <camoto/gamearchive.hpp>
+#include "../src/filter-bash-rle.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to read every file in the archive.
+#define BENCH_ROUNDS 50
+
+/// Number of compressed files in the archive.
+#define BENCH_FILES 16
+
+/// Size of each file before compression (the format's limit is 64kB).
+#define BENCH_FILE_SIZE 60000
+
+/// Open a file the way the library did before the LZW and RLE stages were
+/// combined.
+/**
+ * Each stage is a separate stream::input_filtered, so every byte is copied
+ * through an extra buffer in between the two.
+ */
+std::unique_ptr<stream::input> referenceOpen(Archive& arch,
+	const Archive::FileHandle& id)
+{
+	auto st1 = std::make_unique<stream::input_filtered>(
+		arch.open(id, false),
+		std::make_shared<filter_lzw_decompress>(
+			9,   // initial codeword length (in bits)
+			12,  // maximum codeword length (in bits)
+			257, // first valid codeword
+			256, // EOF codeword is first codeword
+			256, // reset codeword is unused
+			LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
+			LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset/EOF
+		)
+	);
+	return std::make_unique<stream::input_filtered>(
+		std::move(st1),
+		std::make_shared<filter_bash_unrle>()
+	);
+}
+
+/// Generate uncompressed data with runs of repeated bytes, like the tiles and
+/// maps in the game.
+std::string samplePlain(stream::len len, uint32_t seed)
+{
+	std::string data;
+	uint32_t x = seed;
+	while (data.length() < len) {
+		x = x * 1103515245 + 12345;
+		uint8_t r = x >> 24;
+		if (r < 64) data.append(1 + (x >> 16) % 40, (char)(x >> 8));
+		else data += (char)r;
+	}
+	data.resize(len);
+	return data;
+}
+
+/// Read every file in the archive repeatedly.
+/**
+ * @param result
+ *   Set to the decompressed data of all the files, so the two methods can be
+ *   compared.
+ *
+ * @return Throughput in MB/s of decompressed data.
+ */
+template <typename F>
+double benchRead(Archive& arch, std::string *result, F openFile)
+{
+	stream::len total = 0;
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		stream::string out;
+		for (const auto& id : arch.files()) {
+			auto in = openFile(id);
+			stream::copy(out, *in);
+		}
+		total += out.data.length();
+		*result = std::move(out.data);
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return (secs > 0) ? total / secs / (1024 * 1024) : 0;
+}
+
+int main(void)
+{
+	auto archType = ArchiveManager::byCode("dat-bash");
+	if (!archType) {
+		std::cerr << "dat-bash archive format is missing\n";
+		return 1;
+	}
+
+	SuppData supps;
+	auto arch = archType->create(std::make_unique<stream::string>(), supps);
+	stream::len lenStored = 0;
+	for (unsigned int i = 0; i < BENCH_FILES; i++) {
+		auto id = arch->insert(nullptr, createString("FILE" << i << ".DAT"),
+			BENCH_FILE_SIZE, FILETYPE_GENERIC,
+			Archive::File::Attribute::Compressed);
+		auto file = arch->open(id, true);
+		file->truncate(BENCH_FILE_SIZE);
+		file->seekp(0, stream::start);
+		file->write(samplePlain(BENCH_FILE_SIZE, i + 1));
+		file->flush();
+	}
+	arch->flush();
+	for (const auto& id : arch->files()) lenStored += id->storedSize;
+
+	std::cout << "Monster Bash decompression of " << BENCH_FILES << " files ("
+		<< BENCH_FILES * BENCH_FILE_SIZE << " bytes, " << lenStored
+		<< " compressed), " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  reference MB/s  library MB/s\n";
+
+	std::string outRef, outLib;
+	double mbRef = benchRead(*arch, &outRef,
+		[&arch](const Archive::FileHandle& id) {
+			return referenceOpen(*arch, id);
+		}
+	);
+	double mbLib = benchRead(*arch, &outLib,
+		[&arch](const Archive::FileHandle& id) {
+			return arch->open(id, true);
+		}
+	);
+	std::cout << "  " << std::fixed << std::setprecision(1)
+		<< std::setw(14) << mbRef
+		<< std::setw(14) << mbLib
+		<< ((outRef == outLib) ? "" : "  (output differs!)")
+		<< "\n";
+	return 0;
+}
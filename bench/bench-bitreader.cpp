@@ -0,0 +1,416 @@
+/**
+ * @file  bench-bitreader.cpp
+ * @brief Speed of the bit-packed Zone 66 and SkyRoads decompressors.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stack>
+#include <vector>
+#include <camoto/bitstream.hpp>
+#include <camoto/filter.hpp>
+#include "../src/filter-skyroads.hpp"
+#include "../src/filter-zone66.hpp"
+#include "bench-sample.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to decompress the sample data.
+#define BENCH_ROUNDS 20
+
+/// Size of the sample data before compression.
+#define BENCH_SIZE (4 * 1024 * 1024)
+
+/// Size of each buffer passed to the filter, as stream::input_filtered uses.
+#define BENCH_BUFFER 4096
+
+/// Zone 66 decompressor reading each byte through a bitstream callback.
+/**
+ * This is the implementation the library used before bits were read straight
+ * from the input buffer, kept here so the two can be compared.
+ */
+class reference_z66_decompress: virtual public filter
+{
+	public:
+		reference_z66_decompress()
+			:	data(bitstream::bigEndian)
+		{
+		}
+
+		int nextChar(const uint8_t **in, stream::len *lenIn, stream::len *r,
+			uint8_t *out)
+		{
+			if (*r < *lenIn) {
+				*out = **in;
+				(*in)++;
+				(*r)++;
+				return 1;
+			}
+			return 0;
+		}
+
+		virtual void reset(stream::len lenInput)
+		{
+			this->outputLimit = 4;
+			this->totalWritten = 0;
+			this->state = 0;
+			this->codeLength = 9;
+			this->curDicIndex = 0;
+			this->maxDicIndex = 255;
+			for (int i = 0; i < 8192; i++) {
+				nodes[i].code = 0;
+				nodes[i].nextCode = 0;
+			}
+			this->data.flushByte();
+		}
+
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn)
+		{
+			stream::len r = 0, w = 0;
+
+			fn_getnextchar cbNext = std::bind(&reference_z66_decompress::nextChar,
+				this, &in, lenIn, &r, std::placeholders::_1);
+
+			while (
+				(w < *lenOut)
+				&& (
+					(r + 2 < *lenIn)
+					|| ((*lenIn < 10) && (r < *lenIn))
+					|| (this->state > 1)
+				)
+				&& (this->totalWritten < this->outputLimit)
+			) {
+				switch (this->state) {
+					case 0:
+						this->data.changeEndian(bitstream::littleEndian);
+						this->data.read(cbNext, 32, &this->outputLimit);
+						this->data.changeEndian(bitstream::bigEndian);
+						this->state++;
+						break;
+					case 1:
+						if (this->data.read(cbNext, this->codeLength, &this->code)
+							!= this->codeLength
+						) {
+							goto done;
+						}
+						this->curCode = this->code;
+						this->state++;
+						break;
+					case 2:
+						if (this->curCode < 256) {
+							*out++ = this->curCode;
+							w++;
+							this->totalWritten++;
+							if (!this->stack.empty()) {
+								this->curCode = this->stack.top();
+								this->stack.pop();
+							} else {
+								this->state++;
+								break;
+							}
+						} else {
+							this->curCode -= 256;
+							this->stack.push(this->nodes[this->curCode].nextCode);
+							this->curCode = this->nodes[this->curCode].code;
+							if (this->stack.size() > 65534) {
+								throw filter_error("Corrupted Zone 66 data - token stack > 64k");
+							}
+						}
+						break;
+					case 3: {
+						unsigned int value;
+						if (this->data.read(cbNext, 8, &value) != 8) goto done;
+						*out++ = value;
+						w++;
+						this->totalWritten++;
+						if (this->code >= 0x100u + this->curDicIndex) {
+							this->code = 0x100;
+						}
+						nodes[this->curDicIndex].code = this->code;
+						nodes[this->curDicIndex].nextCode = value;
+						this->curDicIndex++;
+						if (this->curDicIndex >= this->maxDicIndex) {
+							this->codeLength++;
+							if (this->codeLength == 13) {
+								this->codeLength = 9;
+								this->curDicIndex = 64;
+								this->maxDicIndex = 255;
+							} else {
+								this->maxDicIndex = (1 << this->codeLength) - 257;
+							}
+						}
+						this->state = 1;
+						break;
+					}
+				}
+			}
+
+		done:
+			*lenIn = r;
+			*lenOut = w;
+			return;
+		}
+
+	protected:
+		bitstream data;
+		int state;
+		unsigned int code, curCode;
+		std::stack<int> stack;
+		int codeLength, curDicIndex, maxDicIndex;
+		struct {
+			unsigned int code, nextCode;
+		} nodes[8192];
+		unsigned int totalWritten;
+		unsigned int outputLimit;
+};
+
+/// SkyRoads decompressor reading each byte through a bitstream callback.
+/**
+ * This is the implementation the library used before bits were read straight
+ * from the input buffer, kept here so the two can be compared.
+ */
+class reference_skyroads_unlzs: virtual public filter
+{
+	public:
+		constexpr static unsigned int DICT_SIZE = 4096;
+
+		reference_skyroads_unlzs()
+			:	data(bitstream::bigEndian),
+				dictionary(DICT_SIZE)
+		{
+		}
+
+		virtual void reset(stream::len lenInput)
+		{
+			this->state = S0_READ_LEN;
+			this->lzsLength = 0;
+			this->dictPos = 0;
+			this->data.flushByte();
+			return;
+		}
+
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn)
+		{
+			stream::len r = 0, w = 0;
+			fn_getnextchar cbNext = std::bind(bitstreamFilterNextChar, &in, lenIn,
+				&r, std::placeholders::_1);
+
+			while (w < *lenOut) {
+				bool needMoreData = false;
+				unsigned int code;
+
+				switch (this->state) {
+					case S0_READ_LEN:
+						if (*lenIn - r < 3) {
+							needMoreData = true;
+							break;
+						}
+						this->data.changeEndian(bitstream::littleEndian);
+						this->data.read(cbNext, 8, &this->width1);
+						this->data.read(cbNext, 8, &this->width2);
+						this->data.read(cbNext, 8, &this->width3);
+						this->data.changeEndian(bitstream::bigEndian);
+						this->state = S1_READ_FLAG1;
+						break;
+					case S1_READ_FLAG1:
+						if (this->data.read(cbNext, 1, &code) == 0) {
+							needMoreData = true;
+							break;
+						}
+						this->state = code ? S2_READ_FLAG2 : S3_DECOMP_SHORT;
+						break;
+					case S2_READ_FLAG2:
+						if (this->data.read(cbNext, 1, &code) == 0) {
+							needMoreData = true;
+							break;
+						}
+						this->state = code ? S5_COPY_BYTE : S4_DECOMP_LONG;
+						break;
+					case S3_DECOMP_SHORT:
+						if (this->data.read(cbNext, this->width2, &code)
+							!= (int)this->width2
+						) {
+							needMoreData = true;
+							break;
+						}
+						this->dist = 2 + code;
+						this->state = S6_GET_COUNT;
+						break;
+					case S4_DECOMP_LONG:
+						if (this->data.read(cbNext, this->width3, &code)
+							!= (int)this->width3
+						) {
+							needMoreData = true;
+							break;
+						}
+						this->dist = 2 + (1 << this->width2) + code;
+						this->state = S6_GET_COUNT;
+						break;
+					case S5_COPY_BYTE:
+						if (this->data.read(cbNext, 8, &code) != 8) {
+							needMoreData = true;
+							break;
+						}
+						this->addDict(code);
+						*out++ = code;
+						w++;
+						this->state = S1_READ_FLAG1;
+						break;
+					case S6_GET_COUNT:
+						if (this->data.read(cbNext, this->width1, &code)
+							!= (int)this->width1
+						) {
+							needMoreData = true;
+							break;
+						}
+						this->lzsLength = 2 + code;
+						this->lzsDictPos = (DICT_SIZE + this->dictPos - this->dist)
+							% DICT_SIZE;
+						this->state = S7_COPY_OFFSET;
+						break;
+					case S7_COPY_OFFSET:
+						if (this->lzsLength == 0) {
+							this->state = S1_READ_FLAG1;
+							break;
+						}
+						*out = this->dictionary[this->lzsDictPos++];
+						this->addDict(*out);
+						out++;
+						w++;
+						this->lzsDictPos %= DICT_SIZE;
+						this->lzsLength--;
+						break;
+				}
+				if (needMoreData) break;
+			}
+
+			*lenIn = r;
+			*lenOut = w;
+			return;
+		}
+
+	protected:
+		bitstream data;
+		unsigned int width1, width2, width3;
+		unsigned int dist;
+		unsigned int lzsDictPos;
+		unsigned int lzsLength;
+		std::vector<uint8_t> dictionary;
+		unsigned int dictPos;
+		enum {
+			S0_READ_LEN,
+			S1_READ_FLAG1,
+			S2_READ_FLAG2,
+			S3_DECOMP_SHORT,
+			S4_DECOMP_LONG,
+			S5_COPY_BYTE,
+			S6_GET_COUNT,
+			S7_COPY_OFFSET,
+		} state;
+
+		void addDict(uint8_t c)
+		{
+			this->dictionary[this->dictPos] = c;
+			this->dictPos = (this->dictPos + 1) % DICT_SIZE;
+			return;
+		}
+};
+
+/// Run data through a filter, a buffer at a time.
+std::vector<uint8_t> run(filter& f, const std::vector<uint8_t>& in)
+{
+	std::vector<uint8_t> out;
+	uint8_t buf[BENCH_BUFFER];
+	f.reset(in.size());
+	std::size_t pos = 0;
+	for (;;) {
+		stream::len lenIn = std::min<std::size_t>(BENCH_BUFFER, in.size() - pos);
+		stream::len lenOut = sizeof(buf);
+		f.transform(buf, &lenOut, in.data() + pos, &lenIn);
+		pos += lenIn;
+		out.insert(out.end(), buf, buf + lenOut);
+		if ((lenIn == 0) && (lenOut == 0) && (pos == in.size())) break;
+	}
+	return out;
+}
+
+/// Decompress data repeatedly.
+/**
+ * @param result
+ *   Set to the decompressed data, so the two decompressors can be compared.
+ *
+ * @return Throughput in MB/s of decompressed data.
+ */
+double benchDecode(filter& f, const std::vector<uint8_t>& data,
+	std::vector<uint8_t> *result)
+{
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		*result = run(f, data);
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return (secs > 0) ? result->size() * (double)BENCH_ROUNDS / secs / (1024 * 1024) : 0;
+}
+
+int main(void)
+{
+	std::string sample = sampleData(BENCH_SIZE);
+	std::vector<uint8_t> plain(sample.begin(), sample.end());
+
+	std::cout << "Decompression of " << BENCH_SIZE / (1024 * 1024)
+		<< "MB, " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  filter          reference MB/s  library MB/s\n";
+
+	{
+		filter_z66_compress enc;
+		auto data = run(enc, plain);
+		reference_z66_decompress ref;
+		filter_z66_decompress lib;
+		std::vector<uint8_t> outRef, outLib;
+		double mbRef = benchDecode(ref, data, &outRef);
+		double mbLib = benchDecode(lib, data, &outLib);
+		std::cout << "  " << std::left << std::setw(16) << "lzw-zone66" << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << mbRef
+			<< std::setw(14) << mbLib
+			<< (((outRef == outLib) && (outLib == plain)) ? "" : "  (output differs!)")
+			<< "\n";
+	}
+	{
+		filter_skyroads_lzs enc(filter_skyroads_lzs::Effort::Fast);
+		auto data = run(enc, plain);
+		reference_skyroads_unlzs ref;
+		filter_skyroads_unlzs lib;
+		std::vector<uint8_t> outRef, outLib;
+		double mbRef = benchDecode(ref, data, &outRef);
+		double mbLib = benchDecode(lib, data, &outLib);
+		std::cout << "  " << std::left << std::setw(16) << "lzs-skyroads" << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << mbRef
+			<< std::setw(14) << mbLib
+			<< (((outRef == outLib) && (outLib == plain)) ? "" : "  (output differs!)")
+			<< "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file  bench-detect.cpp
+ * @brief Timing tests for archive format autodetection.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <camoto/stream_file.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // createString
+#include <camoto/gamearchive.hpp>
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to run through the whole corpus.
+#define BENCH_ROUNDS 50
+
+/// Write out a small archive in every format that can be created from scratch.
+/**
+ * @return Filenames of the archives written.
+ */
+std::vector<std::string> createCorpus()
+{
+	std::vector<std::string> filenames;
+	for (const auto& archType : ArchiveManager::formats()) {
+		// Skip formats that need supplemental files, as they can't be
+		// detected from the archive alone.
+		stream::string empty;
+		if (!archType->getRequiredSupps(empty, "bench.dat").empty()) continue;
+
+		std::string data;
+		try {
+			SuppData supps;
+			auto content = std::make_unique<stream::string>();
+			auto pContent = content.get();
+			auto arch = archType->create(std::move(content), supps);
+			for (unsigned int i = 0; i < 8; i++) {
+				auto id = arch->insert(nullptr, createString("FILE" << i << ".DAT"),
+					64, FILETYPE_GENERIC, Archive::File::Attribute::Default);
+				auto file = arch->open(id, false);
+				file->write(std::string(64, 'A' + i));
+				file->flush();
+			}
+			arch->flush();
+			data = pContent->data;
+		} catch (const std::exception&) {
+			// Fixed archives, formats with limited filenames, and so on.
+			continue;
+		}
+
+		std::string filename = "bench-detect-" + archType->code() + ".tmp";
+		std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+		f << data;
+		filenames.push_back(filename);
+	}
+	return filenames;
+}
+
+/// Detect the corpus by calling isInstance() on every format, as gamearch
+/// used to.
+double benchNaive(const std::vector<std::string>& filenames)
+{
+	auto formats = ArchiveManager::formats();
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		for (const auto& f : filenames) {
+			stream::input_file content(f);
+			for (const auto& i : formats) {
+				try {
+					if (
+						i->isInstance(content) == ArchiveType::Certainty::DefinitelyYes
+					) {
+						break;
+					}
+				} catch (const stream::error&) {
+				}
+			}
+		}
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+/// Detect the corpus with Detector, reading through a normal file stream.
+double benchDetector(const std::vector<std::string>& filenames)
+{
+	Detector detector;
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		for (const auto& f : filenames) {
+			stream::input_file content(f);
+			detector.detect(content);
+		}
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+/// Detect the corpus with Detector, on memory-mapped files.
+/**
+ * @param numThreads
+ *   Number of threads to check formats without signatures on.
+ */
+double benchDetectorMapped(const std::vector<std::string>& filenames,
+	unsigned int numThreads)
+{
+	Detector detector;
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		for (const auto& f : filenames) {
+			mapped_file content(f);
+			detector.detect(content, numThreads);
+		}
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+int main(void)
+{
+	auto filenames = createCorpus();
+	unsigned int numDetects = filenames.size() * BENCH_ROUNDS;
+
+	std::cout << "Format detection over " << filenames.size()
+		<< " archives in different formats, " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  method                  total ms   us/file\n";
+
+	auto show = [numDetects](const char *name, double ms) {
+		std::cout << "  " << std::left << std::setw(22) << name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << ms
+			<< std::setw(10) << ms * 1000 / numDetects
+			<< "\n";
+	};
+	show("isInstance() loop", benchNaive(filenames));
+	show("Detector", benchDetector(filenames));
+	show("Detector, mapped", benchDetectorMapped(filenames, 1));
+	unsigned int numCPUs = std::thread::hardware_concurrency();
+	if (numCPUs > 1) {
+		show("Detector, mapped, MT", benchDetectorMapped(filenames, numCPUs));
+	}
+
+	for (const auto& f : filenames) std::remove(f.c_str());
+	return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file  bench-glb-raptor.cpp
+ * @brief Speed of the Raptor GLB decryption filter.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <camoto/filter.hpp>
+#include "../src/filter-glb-raptor.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to decrypt the sample data.
+#define BENCH_ROUNDS 20
+
+/// Size of the sample data.
+#define BENCH_SIZE (16 * 1024 * 1024)
+
+/// Size of each buffer passed to the filter, as stream::input_filtered uses.
+#define BENCH_BUFFER 4096
+
+/// Byte-at-a-time decrypter.
+/**
+ * This is the implementation the library used before the key pattern was
+ * precalculated, kept here so the two can be compared.
+ */
+class reference_glb_decrypt: virtual public filter
+{
+	public:
+		reference_glb_decrypt(const std::string& key, int lenBlock)
+			:	lenBlock(lenBlock),
+				key(key),
+				lenKey(key.length()),
+				offset(0)
+		{
+			this->reset(0);
+		}
+
+		virtual void reset(stream::len lenInput)
+		{
+			this->posKey = 25 % this->lenKey;
+			this->lastByte = this->key[this->posKey];
+			return;
+		}
+
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn)
+		{
+			stream::len lenRemaining = std::min(*lenIn, *lenOut);
+			*lenIn = 0;
+			*lenOut = 0;
+			while (lenRemaining--) {
+				if (this->lenBlock != 0) {
+					if ((this->offset % this->lenBlock) == 0) {
+						this->reset(0);
+					}
+				}
+				*out = (*in - this->key[this->posKey] - this->lastByte) & 0xFF;
+				this->posKey++;
+				this->posKey %= this->lenKey;
+				this->lastByte = *in;
+				out++;
+				in++;
+				(*lenIn)++;
+				(*lenOut)++;
+				this->offset++;
+			}
+			return;
+		}
+
+	protected:
+		int lenBlock;
+		std::string key;
+		int lenKey;
+		int posKey;
+		stream::len offset;
+		uint8_t lastByte;
+};
+
+/// Decrypt the sample data repeatedly, a buffer at a time.
+/**
+ * @param result
+ *   Set to the decrypted data, so the two decrypters can be compared.
+ *
+ * @return Throughput in MB/s.
+ */
+double benchDecrypt(filter& f, const std::vector<uint8_t>& data,
+	std::vector<uint8_t> *result)
+{
+	result->resize(data.size());
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		f.reset(data.size());
+		for (std::size_t pos = 0; pos < data.size(); ) {
+			stream::len lenIn = std::min<std::size_t>(BENCH_BUFFER,
+				data.size() - pos);
+			stream::len lenOut = lenIn;
+			f.transform(result->data() + pos, &lenOut, data.data() + pos, &lenIn);
+			pos += lenIn;
+		}
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return (secs > 0) ? data.size() * (double)BENCH_ROUNDS / secs / (1024 * 1024) : 0;
+}
+
+int main(void)
+{
+	std::vector<uint8_t> data(BENCH_SIZE);
+	uint32_t x = 1;
+	for (auto& c : data) {
+		x = x * 1103515245 + 12345;
+		c = x >> 24;
+	}
+
+	std::cout << "Raptor GLB decryption of " << BENCH_SIZE / (1024 * 1024)
+		<< "MB, " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  mode            reference MB/s  library MB/s\n";
+
+	struct {
+		const char *name;
+		int lenBlock;
+	} modes[] = {
+		{"file", 0},
+		{"FAT (28 byte)", 28},
+	};
+	for (const auto& m : modes) {
+		reference_glb_decrypt ref("32768GLB", m.lenBlock);
+		filter_glb_decrypt lib("32768GLB", m.lenBlock);
+		std::vector<uint8_t> outRef, outLib;
+		double mbRef = benchDecrypt(ref, data, &outRef);
+		double mbLib = benchDecrypt(lib, data, &outLib);
+		std::cout << "  " << std::left << std::setw(16) << m.name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << mbRef
+			<< std::setw(14) << mbLib
+			<< ((outRef == outLib) ? "" : "  (output differs!)")
+			<< "\n";
+	}
+	return 0;
+}
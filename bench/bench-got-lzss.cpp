@@ -0,0 +1,312 @@
+/**
+ * @file  bench-got-lzss.cpp
+ * @brief Speed and compression ratio of the God of Thunder LZSS filter.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <camoto/filter.hpp>
+#include <camoto/stream_filtered.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamearchive.hpp>
+#include "bench-sample.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to compress or decompress the sample data.
+#define BENCH_ROUNDS 500
+
+/// Byte-at-a-time decoder with a ring-buffer dictionary.
+/**
+ * This is the implementation the library used before whole groups were
+ * decoded at once, kept here so the two can be compared.
+ */
+class reference_unlzss: virtual public filter
+{
+	public:
+		constexpr static int GOT_DICT_SIZE = 4096;
+
+		virtual void reset(stream::len lenInput)
+		{
+			this->flags = 0;
+			this->blocksLeft = 0;
+			this->state = S0_READ_LEN;
+			this->lzssLength = 0;
+			memset(this->dictionary, 0, sizeof(uint8_t) * GOT_DICT_SIZE);
+			this->dictPos = 0;
+			this->lenDecomp = 0;
+			this->numDecomp = 0;
+			return;
+		}
+
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn)
+		{
+			stream::len r = 0, w = 0;
+
+			while (
+				(w < *lenOut)
+				&& ((r < *lenIn) || (this->lzssLength))
+				&& ((this->lenDecomp == 0) || (this->numDecomp < this->lenDecomp))
+			) {
+				bool needMoreData = false;
+
+				switch (this->state) {
+					case S0_READ_LEN:
+						if (*lenIn - r < 4) {
+							needMoreData = true;
+							break;
+						}
+						this->lenDecomp = in[0] | (in[1] << 8);
+						in += 4;
+						r += 4;
+						this->state = S1_READ_FLAGS;
+						break;
+
+					case S1_READ_FLAGS:
+						if (this->blocksLeft == 0) {
+							this->flags = *in++;
+							r++;
+							this->blocksLeft = 8;
+						}
+						if (this->flags & 1) {
+							this->state = S2_LITERAL;
+						} else {
+							this->state = S3_GET_OFFSET;
+						}
+						this->flags >>= 1;
+						this->blocksLeft--;
+						break;
+
+					case S2_LITERAL:
+						this->addDict(*in);
+						*out++ = *in++;
+						r++;
+						w++;
+						this->numDecomp++;
+						this->state = S1_READ_FLAGS;
+						break;
+
+					case S3_GET_OFFSET: {
+						if (*lenIn - r < 2) {
+							needMoreData = true;
+							break;
+						}
+						unsigned int code = in[0] | (in[1] << 8);
+						in += 2;
+						r += 2;
+						this->lzssLength = (code >> 12) + 2;
+						this->lzssDictPos = (GOT_DICT_SIZE + this->dictPos
+							- (code & 0x0FFF)) % GOT_DICT_SIZE;
+						this->state = S4_COPY_OFFSET;
+						break;
+					}
+
+					case S4_COPY_OFFSET:
+						if (this->lzssLength == 0) {
+							this->state = S1_READ_FLAGS;
+							break;
+						}
+						*out = this->dictionary[this->lzssDictPos++];
+						this->addDict(*out);
+						out++;
+						w++;
+						this->numDecomp++;
+						this->lzssDictPos %= GOT_DICT_SIZE;
+						this->lzssLength--;
+						break;
+				}
+				if (needMoreData) break;
+			}
+
+			*lenIn = r;
+			*lenOut = w;
+			return;
+		}
+
+	protected:
+		uint8_t flags;
+		unsigned int blocksLeft;
+		unsigned int lzssDictPos;
+		unsigned int lzssLength;
+		uint8_t dictionary[GOT_DICT_SIZE];
+		unsigned int dictPos;
+		unsigned int lenDecomp;
+		unsigned int numDecomp;
+		enum {
+			S0_READ_LEN,
+			S1_READ_FLAGS,
+			S2_LITERAL,
+			S3_GET_OFFSET,
+			S4_COPY_OFFSET,
+		} state;
+
+		void addDict(uint8_t c)
+		{
+			this->dictionary[this->dictPos] = c;
+			this->dictPos = (this->dictPos + 1) % GOT_DICT_SIZE;
+			return;
+		}
+};
+
+/// Generate a valid compressed stream that decodes to just under 64kB.
+/**
+ * @param literalChance
+ *   Out of 256, how likely each block is to be a literal rather than a
+ *   back-reference.
+ */
+std::string sampleCompressed(unsigned int literalChance)
+{
+	std::string body;
+	unsigned int lenDecomp = 0;
+	uint32_t x = 1;
+	auto rnd = [&x]() {
+		x = x * 1103515245 + 12345;
+		return x >> 16;
+	};
+	// Stop while there's still room for a whole group below the 64kB limit
+	while (lenDecomp < 65535 - 8 * 17) {
+		uint8_t flags = 0;
+		std::string group;
+		for (int i = 0; i < 8; i++) {
+			if ((rnd() & 0xFF) < literalChance) {
+				flags |= 1 << i;
+				group += (char)rnd();
+				lenDecomp++;
+			} else {
+				unsigned int dist = 1 + rnd() % 4095;
+				unsigned int len = rnd() % 16;
+				unsigned int code = (len << 12) | dist;
+				group += (char)(code & 0xFF);
+				group += (char)(code >> 8);
+				lenDecomp += len + 2;
+			}
+		}
+		body += (char)flags;
+		body += group;
+	}
+	std::string header;
+	header += (char)(lenDecomp & 0xFF);
+	header += (char)(lenDecomp >> 8);
+	header += '\x01';
+	header += '\x00';
+	return header + body;
+}
+
+/// Compress data repeatedly.
+/**
+ * @param encoded
+ *   Set to the compressed data.
+ *
+ * @return Throughput in MB/s of uncompressed data.
+ */
+double benchEncode(const FilterType& filterType, const std::string& plain,
+	std::string *encoded)
+{
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		auto target = std::make_unique<stream::string>();
+		auto pTarget = target.get();
+		auto out = filterType.apply(std::unique_ptr<stream::output>(
+			std::move(target)), [](stream::output_filtered*, stream::len) {});
+		out->write(plain);
+		out->flush();
+		*encoded = pTarget->data;
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return (secs > 0) ? plain.length() * BENCH_ROUNDS / secs / (1024 * 1024) : 0;
+}
+
+/// Decompress data repeatedly.
+/**
+ * @return Throughput in MB/s of decompressed data.
+ */
+template <typename F>
+double benchDecode(const std::string& data, F openStream)
+{
+	stream::len total = 0;
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		auto src = std::make_unique<stream::string>();
+		src->data = data;
+		auto in = openStream(std::move(src));
+		stream::string out;
+		stream::copy(out, *in);
+		total += out.data.length();
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return (secs > 0) ? total / secs / (1024 * 1024) : 0;
+}
+
+int main(void)
+{
+	auto filterType = FilterManager::byCode("lzss-got");
+	if (!filterType) {
+		std::cerr << "lzss-got filter is missing\n";
+		return 1;
+	}
+
+	std::cout << "God of Thunder decompression, " << BENCH_ROUNDS
+		<< " rounds\n\n"
+		<< "  data            reference MB/s  library MB/s\n";
+
+	struct {
+		const char *name;
+		unsigned int literalChance;
+	} samples[] = {
+		{"mostly literal", 224},
+		{"mixed", 128},
+		{"mostly copies", 32},
+	};
+	for (const auto& s : samples) {
+		std::string data = sampleCompressed(s.literalChance);
+		double mbRef = benchDecode(data, [](std::unique_ptr<stream::input> src) {
+			return std::make_unique<stream::input_filtered>(std::move(src),
+				std::make_shared<reference_unlzss>());
+		});
+		double mbLib = benchDecode(data, [&filterType](
+			std::unique_ptr<stream::input> src)
+		{
+			return filterType->apply(std::move(src));
+		});
+		std::cout << "  " << std::left << std::setw(16) << s.name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(14) << mbRef
+			<< std::setw(14) << mbLib
+			<< "\n";
+	}
+
+	std::string plain = sampleData(65000);
+	std::string encoded;
+	double mbEnc = benchEncode(*filterType, plain, &encoded);
+	// Size the data would be if every block was a literal, as older versions
+	// of the library wrote.
+	stream::len lenLiteral = 4 + plain.length() + (plain.length() + 7) / 8;
+	std::cout << "\nGod of Thunder compression of " << plain.length()
+		<< " bytes, " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  " << std::fixed << std::setprecision(1) << mbEnc << " MB/s, "
+		<< plain.length() << " -> " << encoded.length() << " bytes ("
+		<< encoded.length() * 100.0 / plain.length() << "%, all literals would be "
+		<< lenLiteral * 100.0 / plain.length() << "%)\n";
+	return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file  bench-sample.hpp
+ * @brief Sample data shared by the benchmarks.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEARCHIVE_BENCH_SAMPLE_HPP_
+#define _CAMOTO_GAMEARCHIVE_BENCH_SAMPLE_HPP_
+
+#include <string>
+#include <camoto/stream.hpp>
+
+/// Generate some data that is somewhat compressible, like real game data.
+/**
+ * @param len
+ *   Number of bytes to generate.
+ *
+ * @param seed
+ *   Different seeds give different data with the same mix of runs, repeated
+ *   patterns and noise.
+ */
+inline std::string sampleData(camoto::stream::len len, unsigned int seed = 0)
+{
+	std::string data(len, '\0');
+	uint32_t x = seed * 2654435761u + 1;
+	for (camoto::stream::len i = 0; i < len; i++) {
+		// Runs and repeated patterns mixed with noise
+		x = x * 1103515245 + 12345;
+		uint8_t r = x >> 24;
+		if (r < 96) data[i] = (char)(i / 64);
+		else if (r < 192) data[i] = (i > 16) ? data[i - 16] : (char)r;
+		else data[i] = (char)r;
+	}
+	return data;
+}
+
+#endif // _CAMOTO_GAMEARCHIVE_BENCH_SAMPLE_HPP_
@@ -0,0 +1,179 @@
+/**
+ * @file  bench-shift.cpp
+ * @brief Speed of inserting and removing data near the start of a large file.
+ *
+ * How much this gains depends on the filesystem, so the file is created in a
+ * directory given on the command line.  To try it on filesystems other than
+ * the one holding the build tree, loopback images can be used:
+ *
+ *   truncate -s 1G ext4.img && mkfs.ext4 -q ext4.img
+ *   truncate -s 1G xfs.img && mkfs.xfs -q xfs.img
+ *   sudo mkdir -p /mnt/ext4 /mnt/xfs
+ *   sudo mount -o loop ext4.img /mnt/ext4
+ *   sudo mount -o loop xfs.img /mnt/xfs
+ *   sudo chown $USER /mnt/ext4 /mnt/xfs
+ *   ./bench-shift /mnt/ext4
+ *   ./bench-shift /mnt/xfs
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <camoto/gamearchive/stream_shifting.hpp>
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to insert and then remove the data.
+#define BENCH_ROUNDS 20
+
+/// Default size of the file, in MB.
+#define BENCH_DEFAULT_SIZE 64
+
+/// Where the data is inserted, like a FAT entry near the start of an archive.
+#define BENCH_OFFSET 100
+
+/// Copy-only insert and remove.
+/**
+ * This moves the data the same way stream::seg does when an archive is not
+ * opened from a shifting_file, kept here so the two can be compared.
+ */
+class reference_shifting_file: public shifting_file
+{
+	public:
+		reference_shifting_file(const std::string& filename)
+			:	shifting_file(filename)
+		{
+		}
+
+		void insert(stream::pos offset, stream::len len)
+		{
+			stream::len lenFile = this->size();
+			this->truncate(lenFile + len);
+			this->copy(offset, offset + len, lenFile - offset);
+			this->zero(offset, std::min(len, lenFile - offset));
+			return;
+		}
+
+		void remove(stream::pos offset, stream::len len)
+		{
+			stream::len lenFile = this->size();
+			this->copy(offset + len, offset, lenFile - offset - len);
+			this->truncate(lenFile - len);
+			return;
+		}
+};
+
+/// Write the sample file, overwriting any existing one.
+void createFile(const std::string& filename, stream::len len)
+{
+	std::vector<char> block(65536);
+	for (unsigned int i = 0; i < block.size(); i++) block[i] = i * 7;
+	std::ofstream f(filename, std::ios::binary | std::ios::trunc);
+	for (stream::len done = 0; done < len; done += block.size()) {
+		f.write(block.data(), std::min<stream::len>(len - done, block.size()));
+	}
+	return;
+}
+
+/// Read the whole file back, so the result can be compared.
+std::vector<char> readFile(const std::string& filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(f),
+		std::istreambuf_iterator<char>());
+}
+
+/// Time BENCH_ROUNDS insert/remove pairs of one filesystem block each.
+/**
+ * @param f
+ *   File to change.
+ *
+ * @param copied
+ *   Set to the number of bytes that had to be copied.
+ *
+ * @return Average milliseconds for each insert or remove.
+ */
+template <class T>
+double benchShift(T& f, stream::len *copied)
+{
+	stream::len lenShift = f.blockSize();
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		f.insert(BENCH_OFFSET, lenShift);
+		f.remove(BENCH_OFFSET, lenShift);
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	*copied = f.bytesCopied();
+	double secs = std::chrono::duration<double>(tEnd - tStart).count();
+	return secs * 1000 / (BENCH_ROUNDS * 2);
+}
+
+int main(int argc, char *argv[])
+{
+	if ((argc > 1) && (std::string(argv[1]).compare("--help") == 0)) {
+		std::cout << "Usage: bench-shift [directory [size-in-MB]]\n"
+			"\n"
+			"Creates a file of <size-in-MB> in <directory> (default is the current\n"
+			"one) and times inserting and removing one filesystem block near the\n"
+			"start of it, first by copying and then with shifting_file.\n";
+		return 0;
+	}
+	std::string dir = (argc > 1) ? argv[1] : ".";
+	stream::len lenFile = ((argc > 2)
+		? strtoul(argv[2], nullptr, 0) : BENCH_DEFAULT_SIZE) * 1024 * 1024;
+	std::string filename = dir + "/bench-shift.tmp";
+
+	createFile(filename, lenFile);
+	auto original = readFile(filename);
+
+	stream::len copiedRef, copiedLib;
+	double msRef, msLib;
+	stream::len lenBlock;
+	{
+		reference_shifting_file f(filename);
+		msRef = benchShift(f, &copiedRef);
+		lenBlock = f.blockSize();
+	}
+	bool sameRef = readFile(filename) == original;
+	{
+		shifting_file f(filename);
+		msLib = benchShift(f, &copiedLib);
+	}
+	bool sameLib = readFile(filename) == original;
+	std::remove(filename.c_str());
+
+	std::cout << "Insert and remove " << lenBlock << " bytes at offset "
+		<< BENCH_OFFSET << " of a " << lenFile / (1024 * 1024) << "MB file in "
+		<< dir << ", " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  method          ms/op    MB copied\n"
+		<< std::fixed << std::setprecision(2)
+		<< "  copy       " << std::setw(10) << msRef
+		<< std::setw(13) << copiedRef / (1024.0 * 1024)
+		<< (sameRef ? "" : "  (output differs!)") << "\n"
+		<< "  fallocate  " << std::setw(10) << msLib
+		<< std::setw(13) << copiedLib / (1024.0 * 1024)
+		<< (sameLib ? "" : "  (output differs!)") << "\n";
+	return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file  bench-skyroads.cpp
+ * @brief Speed and compression ratio of the SkyRoads LZS filter.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <camoto/stream_filtered.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // std::make_unique
+#include "../src/filter-skyroads.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Number of times to compress or decompress each road.
+#define BENCH_ROUNDS 20
+
+/// Number of roads in the sample data, as in the game's ROADS.LZS.
+#define BENCH_NUM_ROADS 31
+
+/// Generate something that looks like a SkyRoads road.
+/**
+ * Roads are seven tiles wide, with each tile a 16-bit value.  Tiles tend to
+ * stay the same for many rows at a time, with gaps and obstacles here and
+ * there.
+ */
+std::string sampleRoad(unsigned int seed)
+{
+	uint32_t x = seed * 2654435761u + 1;
+	auto rnd = [&x]() {
+		x = x * 1103515245 + 12345;
+		return x >> 16;
+	};
+	unsigned int numRows = 150 + rnd() % 150;
+	uint16_t tiles[7] = {0};
+	std::string data;
+	for (unsigned int row = 0; row < numRows; row++) {
+		for (unsigned int col = 0; col < 7; col++) {
+			unsigned int r = rnd() % 100;
+			if (r < 4) tiles[col] = 0; // gap
+			else if (r < 10) tiles[col] = rnd() % 0x40 | ((rnd() % 4) << 8);
+			data += (char)(tiles[col] & 0xFF);
+			data += (char)(tiles[col] >> 8);
+		}
+	}
+	return data;
+}
+
+/// Compress data and time it.
+/**
+ * @return Time taken in seconds for all rounds.
+ */
+double benchEncode(const std::string& plain, filter_skyroads_lzs::Effort effort,
+	std::string *encoded)
+{
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		auto target = std::make_unique<stream::string>();
+		auto pTarget = target.get();
+		stream::output_filtered out(std::move(target),
+			std::make_shared<filter_skyroads_lzs>(effort),
+			[](stream::output_filtered*, stream::len) {});
+		out.write(plain);
+		out.flush();
+		*encoded = pTarget->data;
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(tEnd - tStart).count();
+}
+
+/// Decompress data and time it.
+/**
+ * @return Time taken in seconds for all rounds.
+ */
+double benchDecode(const std::string& encoded, const std::string& plain)
+{
+	auto tStart = std::chrono::steady_clock::now();
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		auto src = std::make_unique<stream::string>();
+		src->data = encoded;
+		stream::input_filtered in(std::move(src),
+			std::make_shared<filter_skyroads_unlzs>());
+		stream::string out;
+		stream::copy(out, in);
+		if (out.data != plain) {
+			std::cerr << "Decompressed data does not match the original!\n";
+		}
+	}
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(tEnd - tStart).count();
+}
+
+int main(void)
+{
+	std::vector<std::string> roads;
+	stream::len lenPlain = 0;
+	for (unsigned int i = 0; i < BENCH_NUM_ROADS; i++) {
+		roads.push_back(sampleRoad(i));
+		lenPlain += roads.back().length();
+	}
+
+	std::cout << "SkyRoads compression of " << BENCH_NUM_ROADS << " roads ("
+		<< lenPlain << " bytes), " << BENCH_ROUNDS << " rounds\n\n"
+		<< "  effort   size     ratio   comp MB/s  decomp MB/s\n";
+
+	struct {
+		const char *name;
+		filter_skyroads_lzs::Effort effort;
+	} efforts[] = {
+		{"fast", filter_skyroads_lzs::Effort::Fast},
+		{"best", filter_skyroads_lzs::Effort::Best},
+	};
+	for (const auto& e : efforts) {
+		stream::len lenEncoded = 0;
+		double secsEnc = 0, secsDec = 0;
+		for (const auto& plain : roads) {
+			std::string encoded;
+			secsEnc += benchEncode(plain, e.effort, &encoded);
+			secsDec += benchDecode(encoded, plain);
+			lenEncoded += encoded.length();
+		}
+		double mb = (double)lenPlain * BENCH_ROUNDS / (1024 * 1024);
+		std::cout << "  " << std::left << std::setw(7) << e.name << std::right
+			<< std::setw(6) << lenEncoded
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(9) << lenEncoded * 100.0 / lenPlain << '%'
+			<< std::setw(12) << mb / secsEnc
+			<< std::setw(13) << mb / secsDec
+			<< "\n";
+	}
+
+	// Older versions wrote every byte as a 10-bit literal
+	std::cout << "\n  (all literals would be about "
+		<< (lenPlain * 10 / 8 + 3 * BENCH_NUM_ROADS) * 100 / lenPlain << "%)\n";
+	return 0;
+}
@@ -0,0 +1,331 @@
+/**
+ * @file  bench-suite.cpp
+ * @brief Throughput figures for every archive format and filter.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#ifndef WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // createString
+#include <camoto/gamearchive.hpp>
+#include "bench-sample.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Default number of files in each generated archive.
+#define BENCH_DEFAULT_ENTRIES 500
+
+/// Default size of each file in the generated archives, in bytes.
+#define BENCH_DEFAULT_SIZE 4096
+
+/// Default amount of data to pass through each filter, in bytes.
+#define BENCH_FILTER_LEN (1024 * 1024)
+
+/// Peak resident set size of this process so far, in kB.
+/**
+ * This never goes down, which is why each format is run in its own process
+ * by isolated().
+ */
+long peakRSS()
+{
+#ifdef WIN32
+	return 0;
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+	return ru.ru_maxrss; // already in kB on Linux
+#endif
+}
+
+/// Print one line of results.
+/**
+ * Output is comma-separated so it can be loaded straight into a spreadsheet
+ * or compared against an earlier run by a script.
+ *
+ * @param kind
+ *   "archive" or "filter".
+ *
+ * @param code
+ *   Format or filter code.
+ *
+ * @param op
+ *   Operation that was timed.
+ *
+ * @param ops
+ *   Number of times the operation was performed.
+ *
+ * @param bytes
+ *   Amount of data processed, or 0 if not meaningful for this operation.
+ *
+ * @param secs
+ *   Time taken for all ops, in seconds.
+ */
+void report(const std::string& kind, const std::string& code,
+	const std::string& op, unsigned long ops, stream::len bytes, double secs)
+{
+	double opsPerSec = (secs > 0) ? ops / secs : 0;
+	double mbPerSec = (secs > 0) ? bytes / secs / (1024 * 1024) : 0;
+	std::cout << kind << ',' << code << ',' << op << ',' << ops << ','
+		<< bytes << ',' << secs << ',' << opsPerSec << ',' << mbPerSec << ','
+		<< peakRSS() << '\n' << std::flush;
+	return;
+}
+
+/// Report an operation that could not be run.
+void skipped(const std::string& kind, const std::string& code,
+	const std::string& op, const std::string& reason)
+{
+	std::cout << "# " << kind << ',' << code << ',' << op << ",skipped: "
+		<< reason << '\n' << std::flush;
+	return;
+}
+
+/// Time a block of code.
+/**
+ * @return Time taken in seconds.
+ */
+template <typename F>
+double timeIt(F fn)
+{
+	auto tStart = std::chrono::steady_clock::now();
+	fn();
+	auto tEnd = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(tEnd - tStart).count();
+}
+
+/// Run the core Archive operations on one format.
+void benchArchive(const ArchiveType& archType, unsigned int numEntries,
+	stream::len lenEntry)
+{
+	const std::string kind = "archive";
+	std::string code = archType.code();
+
+	stream::string empty;
+	if (!archType.getRequiredSupps(empty, "bench.dat").empty()) {
+		skipped(kind, code, "*", "needs supplemental files");
+		return;
+	}
+
+	std::string content = sampleData(lenEntry, 1);
+	std::string archData;
+	std::vector<std::string> names;
+	try {
+		SuppData supps;
+		auto target = std::make_unique<stream::string>();
+		auto pTarget = target.get();
+		auto arch = archType.create(std::move(target), supps);
+
+		double secs = timeIt([&]() {
+			for (unsigned int i = 0; i < numEntries; i++) {
+				std::string name = createString("F" << i);
+				auto id = arch->insert(nullptr, name, lenEntry, FILETYPE_GENERIC,
+					Archive::File::Attribute::Default);
+				names.push_back(name);
+				auto file = arch->open(id, false);
+				file->write(content);
+				file->flush();
+			}
+		});
+		report(kind, code, "insert", numEntries, numEntries * lenEntry, secs);
+
+		secs = timeIt([&]() {
+			arch->flush();
+		});
+		report(kind, code, "flush", 1, pTarget->data.length(), secs);
+
+		archData = pTarget->data;
+	} catch (const std::exception& e) {
+		skipped(kind, code, "*", e.what());
+		return;
+	}
+
+	try {
+		SuppData supps;
+		std::shared_ptr<Archive> arch;
+		double secs = timeIt([&]() {
+			auto src = std::make_unique<stream::string>();
+			src->data = archData;
+			arch = archType.open(std::move(src), supps);
+		});
+		report(kind, code, "open", 1, archData.length(), secs);
+
+		unsigned long count = 0;
+		secs = timeIt([&]() {
+			for (const auto& i : arch->files()) {
+				if (arch->isValid(i)) count++;
+			}
+		});
+		report(kind, code, "list", count, 0, secs);
+
+		unsigned long found = 0;
+		secs = timeIt([&]() {
+			for (const auto& i : names) {
+				if (arch->find(i)) found++;
+			}
+		});
+		if (found) report(kind, code, "find", names.size(), 0, secs);
+		else skipped(kind, code, "find", "format has no filenames");
+
+		stream::len bytesRead = 0;
+		secs = timeIt([&]() {
+			for (const auto& i : arch->files()) {
+				auto file = arch->open(i, true);
+				stream::string out;
+				stream::copy(out, *file);
+				bytesRead += out.data.length();
+			}
+		});
+		report(kind, code, "read", arch->files().size(), bytesRead, secs);
+
+		auto files = arch->files();
+		secs = timeIt([&]() {
+			for (const auto& i : files) {
+				arch->resize(i, lenEntry + 1, lenEntry + 1);
+			}
+		});
+		report(kind, code, "resize", files.size(), 0, secs);
+
+		secs = timeIt([&]() {
+			arch->flush();
+		});
+		report(kind, code, "flush-resized", 1, 0, secs);
+	} catch (const std::exception& e) {
+		skipped(kind, code, "*", e.what());
+	}
+	return;
+}
+
+/// Run one filter in both directions.
+void benchFilter(const FilterType& filterType, stream::len len)
+{
+	const std::string kind = "filter";
+	std::string code = filterType.code();
+	std::string plain = sampleData(len, 2);
+	std::string encoded;
+
+	try {
+		auto target = std::make_unique<stream::string>();
+		auto pTarget = target.get();
+		auto out = filterType.apply(std::unique_ptr<stream::output>(
+			std::move(target)), [](stream::output_filtered*, stream::len) {});
+		double secs = timeIt([&]() {
+			out->write(plain);
+			out->flush();
+		});
+		report(kind, code, "encode", 1, len, secs);
+		encoded = pTarget->data;
+	} catch (const std::exception& e) {
+		skipped(kind, code, "encode", e.what());
+	}
+
+	// Filters that can't encode are still decoded, using the plain data as if
+	// it had been encoded, to give a rough figure.
+	if (encoded.empty()) encoded = plain;
+
+	try {
+		auto src = std::make_unique<stream::string>();
+		src->data = encoded;
+		auto in = filterType.apply(std::unique_ptr<stream::input>(std::move(src)));
+		stream::len lenOut = 0;
+		double secs = timeIt([&]() {
+			stream::string out;
+			stream::copy(out, *in);
+			lenOut = out.data.length();
+		});
+		report(kind, code, "decode", 1, lenOut, secs);
+	} catch (const std::exception& e) {
+		skipped(kind, code, "decode", e.what());
+	}
+	return;
+}
+
+/// Run the benchmarks for one format in a child process.
+/**
+ * Each format starts from a fresh copy of this small process, so the peak
+ * memory it reports is its own, rather than the highest of every format run
+ * before it.  Where there's no fork() the format is run in this process.
+ */
+template <typename F>
+void isolated(const std::string& kind, const std::string& code, F fn)
+{
+#ifdef WIN32
+	fn();
+#else
+	std::cout << std::flush;
+	pid_t pid = fork();
+	if (pid < 0) {
+		fn();
+		return;
+	}
+	if (pid == 0) {
+		fn();
+		std::cout << std::flush;
+		_exit(0);
+	}
+	int status;
+	if (
+		(waitpid(pid, &status, 0) != pid)
+		|| !WIFEXITED(status)
+		|| (WEXITSTATUS(status) != 0)
+	) {
+		skipped(kind, code, "*", "benchmark process failed");
+	}
+#endif
+	return;
+}
+
+int main(int argc, char *argv[])
+{
+	if ((argc > 1) && (std::string(argv[1]).compare("--help") == 0)) {
+		std::cout << "Usage: bench-suite [entries [entry-size [filter-bytes]]]\n"
+			"\n"
+			"Creates an archive of <entries> files of <entry-size> bytes each in\n"
+			"every format, and times the main operations on it.  Then passes\n"
+			"<filter-bytes> bytes through each filter in both directions.\n"
+			"Results are printed as CSV, with skipped tests as # comments.\n";
+		return 0;
+	}
+	unsigned int numEntries = (argc > 1)
+		? strtoul(argv[1], nullptr, 0) : BENCH_DEFAULT_ENTRIES;
+	stream::len lenEntry = (argc > 2)
+		? strtoul(argv[2], nullptr, 0) : BENCH_DEFAULT_SIZE;
+	stream::len lenFilter = (argc > 3)
+		? strtoul(argv[3], nullptr, 0) : BENCH_FILTER_LEN;
+
+	std::cout << "kind,code,operation,ops,bytes,seconds,ops_per_sec,mb_per_sec,"
+		"peak_rss_kb\n";
+
+	for (const auto& i : ArchiveManager::formats()) {
+		isolated("archive", i->code(), [&]() {
+			benchArchive(*i, numEntries, lenEntry);
+		});
+	}
+	for (const auto& i : FilterManager::formats()) {
+		isolated("filter", i->code(), [&]() {
+			benchFilter(*i, lenFilter);
+		});
+	}
+	return 0;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <functional>
+#include <set>
 #define BOOST_FILESYSTEM_VERSION 3
 #include <boost/algorithm/string.hpp> // for case-insensitive string compare
 #include <boost/program_options.hpp>
@@ -56,6 +57,9 @@ int iRet = RET_OK;
 /// Use any decompression filters? (unset with -u option)
 bool bUseFilters = true;
 
+/// Number of threads to detect formats and extract files with (-j option)
+unsigned int numJobs = 1;
+
 // Split a string in two at a delimiter, e.g. "one=two" becomes "one" and "two"
 // and true is returned.  If there is no delimiter both output strings will be
 // the same as the input string and false will be returned.
@@ -217,12 +221,73 @@ void listFiles(const std::string& idPrefix, const std::string& path,
 	return;
 }
 
+/// Pick a local filename that won't overwrite an existing file.
+/**
+ * If the file exists, add .1 .2 .3 etc. onto the end until an unused name is
+ * found.  This allows extracting files with the same name, without them
+ * getting overwritten.
+ *
+ * @param claimed
+ *   Names about to be used by files that haven't been written yet.  These are
+ *   treated as if they already exist.
+ */
+std::string unusedName(const std::string& name,
+	const std::set<std::string>& claimed)
+{
+	if (!fs::exists(name) && !claimed.count(name)) return name;
+
+	std::ostringstream ss;
+	int j = 1;
+	do {
+		ss.str(std::string()); // empty the stringstream
+		ss << name << '.' << j;
+		j++;
+	} while (fs::exists(ss.str()) || claimed.count(ss.str()));
+	return ss.str();
+}
+
 /// Extract all the files in the archive.
 /**
  * Calls itself recursively to extract any subfolders as well.
+ *
+ * If numJobs is more than one and the archive supports it, each run of files
+ * between folders is extracted in parallel, and the progress messages are
+ * printed once the whole run has finished, in the same order and with the same
+ * content as when extracting one at a time.
  */
 void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 {
+	bool bParallel = (numJobs > 1) && archive->canReadConcurrently();
+
+	// Files waiting to be extracted in parallel, and the progress message for
+	// each one
+	std::vector<ga::ExtractJob> jobs;
+	std::vector<std::string> messages;
+	std::set<std::string> claimed;
+
+	auto runJobs = [&]() {
+		if (jobs.empty()) return;
+		ga::extractFiles(archive, jobs, bUseFilters, numJobs);
+		for (unsigned int j = 0; j < jobs.size(); j++) {
+			std::cout << messages[j];
+			if (jobs[j].success) {
+				if (bScript) std::cout << ";status=ok";
+			} else {
+				if (bScript) {
+					std::cout << ";status=fail";
+				} else {
+					std::cout << " [error]";
+				}
+				::iRet = RET_NONCRITICAL_FAILURE; // one or more files failed
+			}
+			std::cout << std::endl;
+		}
+		jobs.clear();
+		messages.clear();
+		claimed.clear();
+		return;
+	};
+
 	unsigned int index = (unsigned int)-1;
 	for (const auto& i : archive->files()) {
 		index++;
@@ -238,6 +303,9 @@ void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 		}
 
 		if (i->fAttr & ga::Archive::File::Attribute::Folder) {
+			// Finish off any files before this folder so the output stays in order
+			runJobs();
+
 			// Tell the user what's going on
 			if (bScript) {
 				std::cout << "mkdir=" << strLocalFile;
@@ -250,15 +318,9 @@ void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 				// unused name is found.  This allows extracting folders with the
 				// same name, without their files ending up lumped together in
 				// the same real on-disk folder.
-				if (fs::exists(strLocalFile)) {
-					std::ostringstream ss;
-					int j = 1;
-					do {
-						ss.str(std::string()); // empty the stringstream
-						ss << strLocalFile << '.' << j;
-						j++;
-					} while (fs::exists(ss.str()));
-					strLocalFile = ss.str();
+				std::string strUnused = unusedName(strLocalFile, claimed);
+				if (strUnused.compare(strLocalFile)) {
+					strLocalFile = strUnused;
 					if (!bScript) {
 						std::cout << " (as " << strLocalFile << ")";
 					}
@@ -284,6 +346,29 @@ void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 			auto subArch = archive->openFolder(i);
 			extractAll(std::move(subArch), bScript);
 			fs::current_path(old);
+		} else if (bParallel) {
+			// Work out the filename now, but leave the extraction until all the
+			// files up to the next folder are known.
+			std::ostringstream msg;
+			if (bScript) {
+				msg << "extracting=" << strLocalFile;
+			} else {
+				msg << " extracting: " << strLocalFile;
+			}
+			std::string strUnused = unusedName(strLocalFile, claimed);
+			if (strUnused.compare(strLocalFile)) {
+				strLocalFile = strUnused;
+				if (!bScript) msg << " (into " << strLocalFile << ")";
+			}
+			if (bScript) msg << ";wrote=" << strLocalFile;
+			claimed.insert(strLocalFile);
+
+			ga::ExtractJob job;
+			job.id = i;
+			job.target = strLocalFile;
+			job.success = false;
+			jobs.push_back(job);
+			messages.push_back(msg.str());
 		} else {
 			// Tell the user what's going on
 			if (bScript) {
@@ -296,18 +381,9 @@ void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 			try {
 				auto pfsIn = archive->open(i, bUseFilters);
 
-				// If the file exists, add .1 .2 .3 etc. onto the end until an
-				// unused name is found.  This allows extracting files with the
-				// same name, without them getting overwritten.
-				if (fs::exists(strLocalFile)) {
-					std::ostringstream ss;
-					int j = 1;
-					do {
-						ss.str(std::string()); // empty the stringstream
-						ss << strLocalFile << '.' << j;
-						j++;
-					} while (fs::exists(ss.str()));
-					strLocalFile = ss.str();
+				std::string strUnused = unusedName(strLocalFile, claimed);
+				if (strUnused.compare(strLocalFile)) {
+					strLocalFile = strUnused;
 					if (!bScript) {
 						std::cout << " (into " << strLocalFile << ")";
 					}
@@ -332,6 +408,7 @@ void extractAll(std::shared_ptr<ga::Archive> archive, bool bScript)
 			std::cout << std::endl;
 		}
 	}
+	runJobs();
 	return;
 }
 
@@ -400,6 +477,8 @@ int main(int iArgC, char *cArgV[])
 			"force open even if the archive is not in the given format")
 		("create,c",
 			"create a new archive file instead of opening an existing one")
+		("jobs,j", po::value<unsigned int>(),
+			"use this many threads to detect the format and extract files")
 	;
 
 	po::options_description poHidden("Hidden parameters");
@@ -490,6 +569,17 @@ int main(int iArgC, char *cArgV[])
 				(i->string_key.compare("create") == 0)
 			) {
 				bCreate = true;
+			} else if (
+				(i->string_key.compare("j") == 0) ||
+				(i->string_key.compare("jobs") == 0)
+			) {
+				if (i->value.size() == 0) {
+					std::cerr << PROGNAME ": --jobs (-j) requires a parameter."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+				numJobs = strtoul(i->value[0].c_str(), NULL, 0);
+				if (numJobs < 1) numJobs = 1;
 			}
 		}
 
@@ -498,17 +588,39 @@ int main(int iArgC, char *cArgV[])
 			return RET_BADARGS;
 		}
 
-		std::unique_ptr<stream::file> psArchive;
+		std::unique_ptr<stream::inout> psArchive;
 		if (bCreate && strType.empty()) {
 			std::cerr << "Error: You must specify the --type of archive to create"
 				<< std::endl;
 			return RET_BADARGS;
 		}
+
+		// If none of the actions will change the archive, map it into memory
+		// instead of going through the usual file stream, as it's quicker.
+		bool bReadOnly = !bCreate;
+		for (const auto& i : pa.options) {
+			if (
+				(i.string_key.compare("add") == 0) ||
+				(i.string_key.compare("insert") == 0) ||
+				(i.string_key.compare("set-metadata") == 0) ||
+				(i.string_key.compare("overwrite") == 0) ||
+				(i.string_key.compare("rename") == 0) ||
+				(i.string_key.compare("delete") == 0)
+			) {
+				bReadOnly = false;
+				break;
+			}
+		}
+
 		std::cout << (bCreate ? "Creating " : "Opening ") << strFilename
 			<< " as type " << (strType.empty() ? "<autodetect>" : strType)
 			<< std::endl;
 		try {
-			psArchive = std::make_unique<stream::file>(strFilename, bCreate);
+			if (bReadOnly) {
+				psArchive = std::make_unique<ga::mapped_file>(strFilename);
+			} else {
+				psArchive = std::make_unique<stream::file>(strFilename, bCreate);
+			}
 		} catch (const stream::open_error& e) {
 			std::cerr << "Error " << (bCreate ? "creating" : "opening")
 				<< " archive file " << strFilename << ": " << e.what() << std::endl;
@@ -519,8 +631,10 @@ int main(int iArgC, char *cArgV[])
 		ga::ArchiveManager::handler_t pArchType;
 		if (strType.empty()) {
 			// Need to autodetect the file format.
-			for (const auto& i : ga::ArchiveManager::formats()) {
-				ga::ArchiveType::Certainty cert = i->isInstance(*psArchive);
+			ga::Detector detector;
+			for (const auto& r : detector.detect(*psArchive, numJobs)) {
+				const auto& i = r.type;
+				ga::ArchiveType::Certainty cert = r.certainty;
 				switch (cert) {
 
 					case ga::ArchiveType::Certainty::DefinitelyNo:
@@ -824,6 +938,9 @@ finishTesting:
 			// Ignore --force/-f
 			} else if (i.string_key.compare("force") == 0) {
 			} else if (i.string_key.compare("f") == 0) {
+			// Ignore --jobs/-j
+			} else if (i.string_key.compare("jobs") == 0) {
+			} else if (i.string_key.compare("j") == 0) {
 
 			} else if ((!i.string_key.empty()) && (i.value.size() > 0)) {
 				// None of the above (single param) options matched, so it's probably
@@ -929,7 +1046,7 @@ finishTesting:
 				// else it's the archive filename, but we already have that
 			}
 		} // for (all command line elements)
-		pArchive->flush();
+		if (!bReadOnly) pArchive->flush();
 	} catch (const po::unknown_option& e) {
 		std::cerr << PROGNAME ": " << e.what()
 			<< ".  Use --help for help." << std::endl;
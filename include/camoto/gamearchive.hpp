@@ -47,7 +47,9 @@ The ArchiveType class can be used to examine files and check what file format
 they are in, and if they are in the correct format, to open them.  Successfully
 opening an archive file produces an instance of the Archive class.  The
 ArchiveType class can also be used to create new archives from scratch, which
-will again return an Archive instance.
+will again return an Archive instance.  For some formats it can also supply an
+ArchiveBuilder, which writes a complete archive from a list of files in one
+go.
 
 The Archive class is used to directly manipulate the archive file, such as by
 adding and removing files.
@@ -91,11 +93,17 @@ Additional information is available from the Camoto homepage
 
 // These are all in the camoto::gamearchive namespace
 #include <camoto/gamearchive/archive.hpp>
+#include <camoto/gamearchive/archivebuilder.hpp>
 #include <camoto/gamearchive/archivetype.hpp>
+#include <camoto/gamearchive/cache.hpp>
+#include <camoto/gamearchive/detect.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
 #include <camoto/gamearchive/fixedarchive.hpp>
 #include <camoto/gamearchive/manager.hpp>
 #include <camoto/gamearchive/stream_archfile.hpp>
+#include <camoto/gamearchive/stream_checkpoint.hpp>
+#include <camoto/gamearchive/stream_mapped.hpp>
+#include <camoto/gamearchive/stream_shifting.hpp>
 #include <camoto/gamearchive/util.hpp>
 
 #endif // _CAMOTO_GAMEARCHIVE_HPP_
@@ -21,8 +21,13 @@
 #ifndef _CAMOTO_ARCHIVE_FAT_HPP_
 #define _CAMOTO_ARCHIVE_FAT_HPP_
 
+#include <atomic>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <camoto/config.hpp>
 #include <camoto/stream_sub.hpp>
 #include <camoto/stream_seg.hpp>
@@ -31,6 +36,9 @@
 namespace camoto {
 namespace gamearchive {
 
+class mapped_file;
+class shifting_file;
+
 /// Common value for lenMaxFilename in Archive_FAT::Archive_FAT()
 #define ARCH_STD_DOS_FILENAMES  12     // 8.3 + dot
 
@@ -80,6 +88,23 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 		};
 
 	protected:
+		/// Memory-mapped file underneath content, or nullptr.
+		/**
+		 * This is set when the archive was opened with
+		 * ArchiveType::openReadOnly(), in which case the archive cannot be
+		 * modified.  It must be declared before content, as it has to be worked
+		 * out before the stream passed to the constructor is moved into content.
+		 */
+		const mapped_file *mapped;
+
+		/// File underneath content that can insert and remove data itself, or
+		/// nullptr.
+		/**
+		 * This is set when the archive was opened from a shifting_file, and like
+		 * mapped it must be declared before content.
+		 */
+		shifting_file *shifting;
+
 		/// The archive stream must be mutable, because we need to change it by
 		/// seeking and reading data in our get() functions, which don't logically
 		/// change the archive's state.
@@ -135,6 +160,8 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 		virtual bool isValid(const FileHandle& id) const;
 		virtual std::unique_ptr<stream::inout> open(const FileHandle& id,
 			bool useFilter);
+		virtual const uint8_t *mappedData(const FileHandle& id) const;
+		virtual bool canReadConcurrently() const;
 		virtual std::shared_ptr<Archive> openFolder(const FileHandle& id);
 		virtual const FileHandle insert(const FileHandle& idBeforeThis,
 			const std::string& strFilename, stream::len storedSize, std::string type,
@@ -146,14 +173,20 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 			stream::len newRealSize);
 		virtual void flush();
 
+		/// Change an attribute, refusing if the archive was opened read-only.
+		virtual void attribute(unsigned int index, int newValue);
+		virtual void attribute(unsigned int index, const std::string& newValue);
+
 	protected:
 		/// Shift any files *starting* at or after offStart by delta bytes.
 		/**
-		 * This updates the internal offsets and index numbers.  The FAT is updated
-		 * by calling updateFileOffset().  If offStart is in the middle of a file
-		 * (which should never happen) that file won't be affected, only those
-		 * following it.  This function must notify any open files that their offset
-		 * has moved.
+		 * This updates the internal offsets and index numbers.  The on-disk FAT
+		 * is not changed straight away, instead each affected file is remembered
+		 * and flushFileOffsets() later calls updateFileOffset() once for each of
+		 * them, so a long run of inserts or removes only rewrites each offset
+		 * field once.  If offStart is in the middle of a file (which should never
+		 * happen) that file won't be affected, only those following it.  This
+		 * function must notify any open files that their offset has moved.
 		 *
 		 * @param fatSkip
 		 *   Do not alter this entry, even if it is located in the area to be
@@ -174,6 +207,17 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 		virtual void shiftFiles(const FATEntry *fatSkip, stream::pos offStart,
 			stream::delta deltaOffset, int deltaIndex);
 
+		/// Write out the offsets of any files moved by shiftFiles().
+		/**
+		 * updateFileOffset() is called for every file still in the archive whose
+		 * offset has changed since the last call, in FAT order.  This is called by
+		 * flush(), but formats that override flush() and write out a cached copy
+		 * of the FAT before calling Archive_FAT::flush() must call this first.
+		 *
+		 * @throws stream::error on I/O error.
+		 */
+		void flushFileOffsets();
+
 		// Methods to be filled out by descendent classes
 
 		/// Adjust the name of the given file in the on-disk FAT.
@@ -206,11 +250,15 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 
 		/// Adjust the offset of the given file in the on-disk FAT.
 		/**
+		 * This is called from flushFileOffsets() rather than as soon as the file
+		 * moves, so pid->iIndex and the layout of the FAT are already final.
+		 *
 		 * @param pid
 		 *   The entry to update.  pid->offset is already set to the new offset.
 		 *
 		 * @param offDelta
-		 *   Amount the offset has changed, in case this value is needed.
+		 *   Total amount the offset has changed since it was last written, in
+		 *   case this value is needed.
 		 *
 		 * @throws stream::error on I/O error.
 		 *
@@ -223,6 +271,34 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 		 */
 		virtual void updateFileOffset(const FATEntry *pid, stream::delta offDelta);
 
+		/// List of files whose offsets have changed, and by how much.
+		typedef std::vector<std::pair<const FATEntry *, stream::delta>>
+			MovedFileVector;
+
+		/// Adjust the offsets of a run of consecutive files in the on-disk FAT.
+		/**
+		 * This is called by flushFileOffsets() for each run of moved files with
+		 * consecutive iIndex values.  Formats with a contiguous FAT can override
+		 * this to rewrite the whole run in one operation instead of seeking to
+		 * every entry in turn.
+		 *
+		 * @param begin
+		 *   First entry to update.  Each item is an entry along with the total
+		 *   amount its offset has changed, as passed to updateFileOffset().
+		 *
+		 * @param end
+		 *   One past the last entry to update.  There is always at least one
+		 *   entry in the range, and iIndex increases by one from each entry to
+		 *   the next.
+		 *
+		 * @throws stream::error on I/O error.
+		 *
+		 * @note The default implementation calls updateFileOffset() for each
+		 *   entry in the range.
+		 */
+		virtual void updateFileOffsets(MovedFileVector::const_iterator begin,
+			MovedFileVector::const_iterator end);
+
 		/// Adjust the size of the given file in the on-disk FAT.
 		/**
 		 * @param pid
@@ -338,9 +414,102 @@ class CAMOTO_GAMEARCHIVE_API Archive_FAT: virtual public Archive,
 		virtual std::unique_ptr<FATEntry> createNewFATEntry();
 
 	private:
+		/// Throw an exception if the archive was opened read-only.
+		/**
+		 * @throws stream::error if the archive cannot be modified.
+		 */
+		void requireWritable() const;
+
+		/// Insert or remove data in content.
+		/**
+		 * This does the same as seeking content to offset and calling insert()
+		 * or remove(), except that when the archive is in a shifting_file and
+		 * the change is a multiple of its block size, the file moves the data
+		 * itself.  On filesystems that support it, this avoids copying
+		 * everything after offset.  Otherwise the amount of data flush() will
+		 * have to move is added to lenPendingShift.
+		 *
+		 * @param offset
+		 *   Where to insert or remove the data.
+		 *
+		 * @param delta
+		 *   Number of bytes to insert if positive, or remove if negative.
+		 */
+		void shiftContent(stream::pos offset, stream::delta delta);
+
 		/// Should the given entry be moved during an insert/resize operation?
 		bool entryInRange(const FATEntry *fat, stream::pos offStart,
 			const FATEntry *fatSkip);
+
+		/// Add a file to the filename index used by find().
+		/**
+		 * If another file with the same name is already indexed, the index is
+		 * discarded (unless the new file was appended) so it can be rebuilt with
+		 * the correct entry first in line.
+		 *
+		 * @param id
+		 *   File to add.  Must already be present in vcFAT.
+		 *
+		 * @param appended
+		 *   true if the file was added to the end of vcFAT, so any existing
+		 *   entry with the same name is known to come before it.
+		 */
+		void indexFile(const FileHandle& id, bool appended) const;
+
+		/// Remove a file from the filename index used by find().
+		/**
+		 * If another file shares the same name, it takes this file's place in the
+		 * index.
+		 *
+		 * @param id
+		 *   File to remove.  id->strName must still be the name it was indexed
+		 *   under.
+		 */
+		void unindexFile(const FileHandle& id) const;
+
+		/// Case-folded filename to file lookup table, used by find().
+		/**
+		 * This is built on the first call to find() rather than in the
+		 * constructor, as descendent classes populate vcFAT after Archive_FAT has
+		 * been constructed.  When a name appears more than once only the first
+		 * file in vcFAT with that name is indexed, matching the old linear search.
+		 */
+		mutable std::unordered_map<std::string, FileHandle> nameIndex;
+
+		/// Does nameIndex reflect the current content of vcFAT?
+		mutable std::atomic<bool> nameIndexValid;
+
+		/// Held by find() while building nameIndex.
+		mutable std::mutex nameIndexLock;
+
+		/// Files moved by shiftFiles() that still need updateFileOffset() called.
+		/**
+		 * The value is the total distance the file has moved since its offset was
+		 * last written out.  Entries are removed from here when they are removed
+		 * from vcFAT, so the pointers are always valid.
+		 */
+		std::unordered_map<const FATEntry *, stream::delta> pendingOffsets;
+
+		/// All files in vcFAT, sorted by iOffset then iIndex.
+		/**
+		 * This lets shiftFiles() go straight to the first file that needs moving.
+		 * Shifting files never changes their relative order, so once built this
+		 * only needs updating when files are inserted or removed.  Like
+		 * nameIndex, it is built on first use.
+		 */
+		std::vector<FATEntry *> offsetIndex;
+
+		/// Does offsetIndex reflect the current content of vcFAT?
+		bool offsetIndexValid;
+
+		/// Roughly how much data content will move around when it is flushed.
+		/**
+		 * This is the total length of data following each insert or remove made
+		 * since the last flush.  Once it is more than the size of the archive,
+		 * writing out a fresh copy of the whole archive is less work, so if the
+		 * archive is in a shifting_file, flush() does that instead.
+		 */
+		stream::len lenPendingShift;
 };
 
 } // namespace gamearchive
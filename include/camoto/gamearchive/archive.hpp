@@ -22,6 +22,7 @@
 #ifndef _CAMOTO_GAMEARCHIVE_ARCHIVE_HPP_
 #define _CAMOTO_GAMEARCHIVE_ARCHIVE_HPP_
 
+#include <atomic>
 #include <memory>
 #include <exception>
 #include <vector>
@@ -54,7 +55,12 @@ class Archive;
  *
  * @note Multithreading: Only call one function in this class at a time.  Many
  *       of the functions seek around the underlying stream and thus will break
- *       if two or more functions are executing at the same time.
+ *       if two or more functions are executing at the same time.  The
+ *       exception is an Archive_FAT based archive opened with
+ *       ArchiveType::openReadOnly(), where files(), find(), isValid(), open()
+ *       and mappedData() may be called from any number of threads at once.
+ *       Each stream returned by open() must still only be used by one thread
+ *       at a time, and archives returned by openFolder() are not covered.
  */
 class CAMOTO_GAMEARCHIVE_API Archive: public HasAttributes
 {
@@ -128,6 +134,13 @@ class CAMOTO_GAMEARCHIVE_API Archive: public HasAttributes
 			/// One or more members from Attribute.
 			Attribute fAttr;
 
+			/// Number of times the file's stored data has been changed.
+			/**
+			 * This goes up on every write to the file and every time it is
+			 * resized, so anything derived from the data (e.g. saved decoder
+			 * states) can tell it is out of date even if the size is the same.
+			 */
+			mutable std::atomic<unsigned long> generation;
 
 			/// Empty constructor
 			File();
@@ -211,6 +224,39 @@ class CAMOTO_GAMEARCHIVE_API Archive: public HasAttributes
 		virtual std::unique_ptr<stream::inout> open(const FileHandle& id,
 			bool useFilter) = 0;
 
+		/// Get direct access to a file's data in memory.
+		/**
+		 * This is only possible when the archive was opened with
+		 * ArchiveType::openReadOnly(), in which case the archive is mapped into
+		 * memory and the file's data can be accessed without any copying.
+		 *
+		 * Note to archive format implementors: There is a default implementation
+		 * of this function which always returns nullptr, so it only needs to be
+		 * overridden if the archive can support it.
+		 *
+		 * @param id
+		 *   A valid iterator, obtained from find(), getFileList(), etc.
+		 *
+		 * @return Pointer to the first byte of the file's stored data, with
+		 *   id->storedSize bytes available, or nullptr if the data is not
+		 *   available in memory.  This is the raw data, as returned by
+		 *   open(id, false), so if id->filter is not empty the data will still
+		 *   need to be decoded.  The pointer is valid for as long as the archive
+		 *   is open.
+		 */
+		virtual const uint8_t *mappedData(const FileHandle& id) const;
+
+		/// Can files be opened and read from more than one thread at once?
+		/**
+		 * If this returns true, files(), find(), isValid(), open() and
+		 * mappedData() may be called from multiple threads at the same time, as
+		 * described in the note on this class.
+		 *
+		 * Note to archive format implementors: There is a default implementation
+		 * of this function which always returns false.
+		 */
+		virtual bool canReadConcurrently() const;
+
 		/// Open a folder in the archive.
 		/**
 		 * There is a default implementation of this which triggers an
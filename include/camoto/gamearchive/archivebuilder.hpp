@@ -0,0 +1,167 @@
+/**
+ * @file  camoto/gamearchive/archivebuilder.hpp
+ * @brief ArchiveBuilder class, used to write a whole new archive in one pass.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEARCHIVE_ARCHIVEBUILDER_HPP_
+#define _CAMOTO_GAMEARCHIVE_ARCHIVEBUILDER_HPP_
+
+#include <functional>
+#include <vector>
+#include <camoto/attribute.hpp>
+#include <camoto/config.hpp>
+#include <camoto/stream.hpp>
+#include <camoto/suppitem.hpp>
+#include <camoto/gamearchive/archive.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Writes a whole new archive from a list of files, in a single pass.
+/**
+ * Building an archive with ArchiveType::create() and Archive::insert() moves
+ * the FAT and all the data following it every time a file is added.  When
+ * all the files are known up front, an ArchiveBuilder works out the layout
+ * once and then writes the header, FAT and file data from start to finish,
+ * without ever going back over anything it has written.
+ *
+ * Instances are obtained from ArchiveType::builder().  Archive attributes
+ * (such as a description or version number) are set with attribute() before
+ * calling write(), and have the same indices and defaults as on an archive
+ * returned by ArchiveType::create().
+ */
+class CAMOTO_GAMEARCHIVE_API ArchiveBuilder: public HasAttributes
+{
+	public:
+		/// A file to put in the archive.
+		struct Entry {
+			/// Filename, as for Archive::insert().
+			std::string strName;
+
+			/// Number of bytes open() will supply.
+			/**
+			 * This is the size before any filter is applied, i.e. the amount that
+			 * would be written to the stream returned by Archive::open() with
+			 * useFilter set to true.
+			 */
+			stream::len size;
+
+			/// File type, as for Archive::insert().
+			std::string type;
+
+			/// File attributes, as for Archive::insert().
+			/**
+			 * If these cause the format to filter the file (e.g. Compressed) then
+			 * the filter is applied to the data from open() as it is written.
+			 */
+			Archive::File::Attribute fAttr;
+
+			/// Get the file's data.
+			/**
+			 * This is called once for each file, just before its data is written,
+			 * so only one file is open at any time.  It may be left empty if size
+			 * is zero.
+			 */
+			std::function<std::unique_ptr<stream::input>()> open;
+		};
+
+		virtual ~ArchiveBuilder();
+
+		/// Write out a new archive containing the given files.
+		/**
+		 * @param content
+		 *   Where to write the archive.  Data is only ever appended, starting at
+		 *   the current write position, so this can be a stream that is slow or
+		 *   unable to seek.
+		 *
+		 * @param files
+		 *   Files to put in the archive, in the order they should appear.
+		 *
+		 * @param suppData
+		 *   Any supplemental data required by this format (see
+		 *   ArchiveType::getRequiredSupps()).
+		 *
+		 * @throws stream::error if one of the files can't be stored in this
+		 *   format (e.g. the name is too long) in which case nothing is written,
+		 *   or on I/O error, which may leave a partially written archive.
+		 */
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData) = 0;
+
+	protected:
+		/// Copy a file's data into the archive unchanged.
+		/**
+		 * @param content
+		 *   Archive being written.
+		 *
+		 * @param file
+		 *   File to copy.  Exactly file.size bytes are written.
+		 *
+		 * @throws stream::error if the file supplies less data than its size.
+		 */
+		static void writeData(stream::output& content, const Entry& file);
+
+		/// Filter a file's data ready to be written to the archive.
+		/**
+		 * This is for formats that need to know the filtered size of a file
+		 * before writing its data, so the whole file is held in memory.
+		 *
+		 * @param file
+		 *   File to filter.
+		 *
+		 * @param filter
+		 *   Code of the filter to apply, e.g. "lzw-bash".
+		 *
+		 * @return The filtered data.
+		 *
+		 * @throws stream::error if the filter doesn't exist or the file supplies
+		 *   less data than its size.
+		 */
+		static std::string encode(const Entry& file, const std::string& filter);
+
+		/// Throw an exception if any filename is longer than the format allows.
+		/**
+		 * @param files
+		 *   Files to check.
+		 *
+		 * @param lenMaxFilename
+		 *   Maximum filename length, as passed to Archive_FAT::Archive_FAT().
+		 *
+		 * @throws stream::error if a filename is too long.
+		 */
+		static void checkFilenames(const std::vector<Entry>& files,
+			unsigned int lenMaxFilename);
+
+		/// Throw an exception if the archive would be too large for the format.
+		/**
+		 * @param lenArchive
+		 *   Size of the archive once it has been written.
+		 *
+		 * @param lenMax
+		 *   Largest archive the format can address, e.g. 0xFFFFFFFF for a format
+		 *   that stores offsets as 32-bit integers.
+		 *
+		 * @throws stream::error if lenArchive is larger than lenMax.
+		 */
+		static void checkArchiveSize(stream::len lenArchive, stream::len lenMax);
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEARCHIVE_ARCHIVEBUILDER_HPP_
@@ -27,6 +27,7 @@
 #include <camoto/stream.hpp>
 #include <camoto/suppitem.hpp>
 #include <camoto/gamearchive/archive.hpp>
+#include <camoto/gamearchive/archivebuilder.hpp>
 
 /// Main namespace
 namespace camoto {
@@ -78,6 +79,29 @@ class CAMOTO_GAMEARCHIVE_API ArchiveType
 		 */
 		virtual std::vector<std::string> games() const = 0;
 
+		/// Fixed bytes found at a known offset in every file of a format.
+		struct Signature {
+			stream::pos offset;  ///< Offset of the first byte, from start of file
+			std::string magic;   ///< Bytes that must appear at that offset
+		};
+
+		/// Get the signatures that identify this format.
+		/**
+		 * This lets a detector rule out most formats by looking at a single block
+		 * of data from the start of the file, instead of calling isInstance() on
+		 * every format.
+		 *
+		 * Note to archive format implementors: There is a default implementation
+		 * of this function which returns an empty list, meaning the format has
+		 * no signature and isInstance() must always be called.  Only list
+		 * signatures here if isInstance() always returns DefinitelyNo when none
+		 * of them are present.
+		 *
+		 * @return Zero or more signatures.  The file must contain at least one of
+		 *   them to be in this format.
+		 */
+		virtual std::vector<Signature> signatures() const;
+
 		/// Check a stream to see if it's in this archive format.
 		/**
 		 * @param content
@@ -114,6 +138,22 @@ class CAMOTO_GAMEARCHIVE_API ArchiveType
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const = 0;
 
+		/// Get an object that writes a whole new archive in one pass.
+		/**
+		 * This is much quicker than create() followed by a series of insert()
+		 * calls when all the files are known in advance, as the data is written
+		 * once from start to end instead of being shuffled along each time a
+		 * file is added.
+		 *
+		 * Note to archive format implementors: There is a default implementation
+		 * of this function which returns nullptr, so it only needs to be
+		 * overridden by formats that have an ArchiveBuilder.
+		 *
+		 * @return A new ArchiveBuilder, or nullptr if this format doesn't have
+		 *   one, in which case create() and Archive::insert() must be used.
+		 */
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
+
 		/// Open an archive file.
 		/**
 		 * @pre Recommended that isInstance() has returned > DefinitelyNo.
@@ -139,6 +179,31 @@ class CAMOTO_GAMEARCHIVE_API ArchiveType
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const = 0;
 
+		/// Open an archive file on disk for reading only.
+		/**
+		 * The file is memory-mapped rather than read through the usual file
+		 * stream, so reading files out of the archive does not need any system
+		 * calls, and Archive::mappedData() can be used to access unfiltered files
+		 * without copying them at all.  Any attempt to modify the archive will
+		 * throw an exception.
+		 *
+		 * @pre Recommended that isInstance() has returned > DefinitelyNo.
+		 *
+		 * @param filename
+		 *   Name of the archive file to open.
+		 *
+		 * @param suppData
+		 *   Any supplemental data required by this format (see getRequiredSupps()).
+		 *   These streams are used as-is, so will not be memory-mapped unless the
+		 *   caller has already done so.
+		 *
+		 * @return A pointer to an instance of the Archive class, as for open().
+		 *
+		 * @throws stream::open_error if the file could not be opened.
+		 */
+		std::shared_ptr<Archive> openReadOnly(const std::string& filename,
+			SuppData& suppData) const;
+
 		/// Get a list of any required supplemental files.
 		/**
 		 * For some archive formats, data is stored externally to the archive file
@@ -0,0 +1,161 @@
+/**
+ * @file  camoto/gamearchive/cache.hpp
+ * @brief Cache of decoded file data, shared by all open archives.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEARCHIVE_CACHE_HPP_
+#define _CAMOTO_GAMEARCHIVE_CACHE_HPP_
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <camoto/config.hpp>
+#include <camoto/stream.hpp>
+#include <camoto/gamearchive/archive.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Cache of decoded (e.g. decompressed) file data.
+/**
+ * When a filtered file opened with Archive::open() is decoded in full, the
+ * decoded data is kept here, so opening the same file again can skip the
+ * decoding.  The least recently used files are dropped once the cache grows
+ * beyond its budget.
+ *
+ * A file's cached data is dropped whenever it is resized, removed or written
+ * to.  Data is stored along with the Archive::File::generation it was decoded
+ * from, so data decoded before a change is never added to the cache after it.
+ * Only files with data cached are tracked, and files that have been closed are
+ * forgotten, so the cache doesn't grow with the number of files ever opened.
+ *
+ * The cache starts off with a budget of zero, so nothing is cached until
+ * setBudget() is called.  All functions can be called from any thread.
+ */
+class CAMOTO_GAMEARCHIVE_API DecodedCache
+{
+	public:
+		/// Decoded file content.
+		typedef std::shared_ptr<const std::vector<uint8_t>> Data;
+
+		/// Cache usage counters.
+		struct Stats
+		{
+			unsigned long hits;   ///< Opens served from the cache
+			unsigned long misses; ///< Opens that had to decode the data
+			stream::len size;     ///< Bytes of decoded data held
+			std::size_t count;    ///< Number of files held
+			std::size_t tracked;  ///< Number of files tracked, including closed ones
+		};
+
+		/// Get the cache used by Archive::open().
+		static DecodedCache& instance();
+
+		DecodedCache();
+
+		/// Set the most decoded data to keep.
+		/**
+		 * @param bytes
+		 *   Total size of all cached files.  Files are dropped, least recently
+		 *   used first, until the cache fits.  Zero disables the cache.
+		 */
+		void setBudget(stream::len bytes);
+
+		/// Get the most decoded data that will be kept.
+		stream::len budget() const;
+
+		/// Get the hit/miss counters and current size.
+		Stats stats() const;
+
+		/// Drop everything in the cache and zero the counters.
+		void clear();
+
+		/// Look up a file's decoded data.
+		/**
+		 * @param archive
+		 *   Archive the file belongs to.
+		 *
+		 * @param id
+		 *   File to look up.
+		 *
+		 * @param generation
+		 *   On return, the file's current generation.  Pass this to store() if
+		 *   the data is decoded later, so it is only added if the file hasn't
+		 *   been changed in the meantime.
+		 *
+		 * @return The decoded data, or nullptr if it isn't in the cache.  This
+		 *   counts as a hit or a miss.
+		 */
+		Data find(const Archive *archive, const Archive::FileHandle& id,
+			unsigned long *generation);
+
+		/// Add a file's decoded data.
+		/**
+		 * Nothing is added if the data won't fit in the cache at all, or if the
+		 * file's generation has changed since find() was called.
+		 */
+		void store(const Archive *archive, const Archive::FileHandle& id,
+			unsigned long generation, Data data);
+
+		/// Drop a file's data because it has changed.
+		void invalidate(const Archive *archive, const Archive::FileHandle& id);
+
+	protected:
+		/// Files are identified by their archive and their FileHandle.
+		typedef std::pair<const Archive *, const Archive::File *> Key;
+
+		/// Cached data for one file.
+		struct Entry
+		{
+			/// File handle, so a different file reusing the memory isn't confused
+			/// with this one.
+			std::weak_ptr<const Archive::File> id;
+			unsigned long generation;       ///< Version of the file data came from
+			Data data;                      ///< Decoded content
+			std::list<Key>::iterator lru;   ///< Position in lru
+		};
+
+		/// Drop an entry and its data.
+		void evict(std::map<Key, Entry>::iterator entry);
+
+		/// Drop least recently used data until the cache fits in its budget.
+		void trim();
+
+		/// Forget files that have been closed, if enough have built up.
+		void sweep();
+
+		mutable std::mutex lock;      ///< Protects everything below
+		std::map<Key, Entry> entries; ///< Files with data
+		std::list<Key> lru;           ///< Files with data, most recent first
+		stream::len lenBudget;        ///< Most data to keep
+		stream::len lenData;          ///< Size of all cached data
+		unsigned long hits;           ///< Number of find() calls with data
+		unsigned long misses;         ///< Number of find() calls without data
+		std::size_t lenSweep;         ///< Size of entries that triggers sweep()
+
+		/// Size of entries, so writes can skip the lock when the cache is unused.
+		std::atomic<std::size_t> numEntries;
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEARCHIVE_CACHE_HPP_
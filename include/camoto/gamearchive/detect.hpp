@@ -0,0 +1,142 @@
+/**
+ * @file  camoto/gamearchive/detect.hpp
+ * @brief Work out which format an archive file is in.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEARCHIVE_DETECT_HPP_
+#define _CAMOTO_GAMEARCHIVE_DETECT_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <camoto/config.hpp>
+#include <camoto/stream.hpp>
+#include <camoto/gamearchive/archivetype.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Number of bytes read from the start of a file by Detector.
+#define DETECT_WINDOW_LEN 4096
+
+/// Outcome of checking a file against one archive format.
+struct CAMOTO_GAMEARCHIVE_API DetectResult
+{
+	/// Format that was checked.
+	std::shared_ptr<const ArchiveType> type;
+
+	/// Value returned by type->isInstance().
+	ArchiveType::Certainty certainty;
+};
+
+/// Work out which archive formats a file could be in.
+/**
+ * Calling ArchiveType::isInstance() for every known format means the start of
+ * the file is read over and over again, once per format.  Instead, Detector
+ * reads the first DETECT_WINDOW_LEN bytes of the file once, and serves all the
+ * formats' reads from that block where it can.
+ *
+ * Formats with a signature (see ArchiveType::signatures()) are looked up in a
+ * table by their leading bytes, so only formats whose signature is actually
+ * present have isInstance() called.  The remaining formats, which have no
+ * signature, are then checked one by one in the usual order.
+ *
+ * A Detector only needs to be created once, it can then be used to check any
+ * number of files.
+ */
+class CAMOTO_GAMEARCHIVE_API Detector
+{
+	public:
+		/// Build the signature table from ArchiveManager::formats().
+		Detector();
+
+		/// Build the signature table from a specific list of formats.
+		/**
+		 * @param formats
+		 *   Formats to check files against, in the order they should be tried.
+		 */
+		Detector(std::vector<std::shared_ptr<const ArchiveType>> formats);
+
+		/// Check a file against all known formats.
+		/**
+		 * Formats whose signature matches are checked first, and if one of them
+		 * returns DefinitelyYes no further formats are checked.  Otherwise all the
+		 * formats without a signature are checked as well.
+		 *
+		 * @param content
+		 *   File to check.  If this is a memory_view (e.g. a mapped_file) the data
+		 *   is read directly out of memory, otherwise the read position will be
+		 *   changed.
+		 *
+		 * @param numThreads
+		 *   Number of threads to check the formats without a signature on.  Each
+		 *   thread gets its own view of the file, but if content is not a
+		 *   memory_view any reads past the first DETECT_WINDOW_LEN bytes still
+		 *   have to take turns.  The result is the same regardless of the number
+		 *   of threads, but with more than one thread every format is checked,
+		 *   even after a DefinitelyYes.  0 or 1 checks everything in the calling
+		 *   thread.
+		 *
+		 * @return All formats that returned something other than DefinitelyNo, in
+		 *   the order they were checked.  If the last entry is DefinitelyYes then
+		 *   checking stopped early.  Pass this to rank() to put the most likely
+		 *   formats first.
+		 */
+		std::vector<DetectResult> detect(stream::input& content,
+			unsigned int numThreads = 1) const;
+
+		/// Sort detection results so the most certain matches come first.
+		/**
+		 * Formats with the same certainty stay in the order they were checked.
+		 *
+		 * @param results
+		 *   Value returned by detect().
+		 */
+		static void rank(std::vector<DetectResult>& results);
+
+	protected:
+		/// One signature from one format.
+		struct SignatureEntry {
+			/// Full signature, including the first byte used to index it.
+			std::string magic;
+
+			/// Position of the format in the list passed to the constructor, so
+			/// matches can be checked in the original order.
+			unsigned int order;
+
+			/// Format the signature belongs to.
+			std::shared_ptr<const ArchiveType> type;
+		};
+
+		/// All signatures found at one offset, indexed by their first byte.
+		struct SignatureTable {
+			stream::pos offset;
+			std::vector<SignatureEntry> byFirstByte[256];
+		};
+
+		/// Signature tables, one for each distinct signature offset.
+		std::vector<SignatureTable> signatures;
+
+		/// Formats without a signature, in the order they should be checked.
+		std::vector<std::shared_ptr<const ArchiveType>> heuristic;
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEARCHIVE_DETECT_HPP_
@@ -23,6 +23,7 @@
 #ifndef _CAMOTO_GAMEARCHIVE_FILTERTYPE_HPP_
 #define _CAMOTO_GAMEARCHIVE_FILTERTYPE_HPP_
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <camoto/config.hpp>
@@ -33,6 +34,33 @@
 namespace camoto {
 namespace gamearchive {
 
+/// One step in decoding a filtered stream.
+/**
+ * As well as the decoder itself, this holds a way to copy the decoder along
+ * with its current state, so decoding can be paused part way through a file
+ * and picked up again later from the same point.
+ */
+struct CAMOTO_GAMEARCHIVE_API FilterStage
+{
+	/// Decoder in its initial state.
+	std::shared_ptr<filter> decoder;
+
+	/// Make an independent copy of a decoder of this type, state and all.
+	std::function<std::shared_ptr<filter>(const filter&)> clone;
+
+	/// Wrap a decoder which can be copied with its copy constructor.
+	template <class T>
+	static FilterStage of(std::shared_ptr<T> decoder)
+	{
+		return {
+			decoder,
+			[](const filter& f) -> std::shared_ptr<filter> {
+				return std::make_shared<T>(dynamic_cast<const T&>(f));
+			}
+		};
+	}
+};
+
 /// Primary interface to a filter.
 /**
  * This class represents a filter.  Its functions are used to manipulate C++
@@ -113,6 +141,59 @@ class CAMOTO_GAMEARCHIVE_API FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const = 0;
+
+		/// Get the decoders used when reading from the filtered data.
+		/**
+		 * These are the same decoders apply(std::unique_ptr<stream::input>)
+		 * chains together.  input_checkpointed uses them to save the decoder
+		 * state every so often, so reads further into the file can resume from
+		 * there instead of decoding everything before them again.
+		 *
+		 * Note to filter implementors: There is a default implementation of this
+		 * function which returns an empty list, meaning the filter can't be
+		 * checkpointed.  It should only be overridden if every decoder can be
+		 * copied, along with its current state, by its copy constructor.  Only
+		 * the first decoder is told the size of its input when it is reset, so
+		 * the others must not depend on it.
+		 *
+		 * @return Decoders in the order the data passes through them, each in its
+		 *   initial state.
+		 */
+		virtual std::vector<FilterStage> decoders() const;
+
+		/// Decode a whole file in one go.
+		/**
+		 * This gives the same result as reading everything from
+		 * apply(std::unique_ptr<stream::input>), but goes straight from one
+		 * buffer to another without any of the buffering the filtered streams
+		 * do.  Streams returned by Archive::open() use this when the whole file
+		 * is read in one go.
+		 *
+		 * Note to filter implementors: There is a default implementation of this
+		 * function which runs the data through each of the decoders() in turn, or
+		 * returns false if there aren't any.  It only needs to be overridden if
+		 * the filter can do better than that, e.g. by reading the decoded size
+		 * from the data first.
+		 *
+		 * @param in
+		 *   Filtered (e.g. compressed) data.
+		 *
+		 * @param lenIn
+		 *   Length of in.
+		 *
+		 * @param out
+		 *   On entry, this should be resized to the expected length of the
+		 *   decoded data, e.g. File::realSize.  It is enlarged if that turns out
+		 *   to be too small, and on return it is resized to the actual length.
+		 *
+		 * @return true if the data was decoded, or false if it can only be
+		 *   decoded through apply(), in which case out is left alone.
+		 *
+		 * @throw filter_error
+		 *   The data is corrupt.
+		 */
+		virtual bool decodeAll(const uint8_t *in, stream::len lenIn,
+			std::vector<uint8_t> *out) const;
 };
 
 } // namespace gamearchive
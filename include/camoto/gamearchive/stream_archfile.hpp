@@ -137,9 +137,13 @@ class CAMOTO_GAMEARCHIVE_API output_archfile:
 		output_archfile(std::shared_ptr<Archive> archive, Archive::FileHandle id,
 			std::shared_ptr<stream::output> content);
 
+		virtual stream::len try_write(const uint8_t *buffer, stream::len len);
 		virtual void truncate(stream::len size);
 		virtual void flush();
 
+		/// Get the archive this file belongs to.
+		const Archive *owner() const;
+
 		/// Set the original (decompressed) size of this stream.
 		/**
 		 * This is just a convenience function to call Archive::resize().
@@ -166,6 +170,23 @@ class CAMOTO_GAMEARCHIVE_API archfile:
 			std::shared_ptr<stream::inout> content);
 };
 
+/// Apply a filter to a file opened from an archive.
+/**
+ * If the filter supports FilterType::decodeAll() and the first read from the
+ * returned stream asks for the whole file (File::realSize bytes or more from
+ * the start), the whole file is decoded in one go and reads come straight from
+ * the decoded data.  Otherwise the file is decoded through the filtered
+ * stream as it is read.
+ *
+ * If DecodedCache has a budget set, the decoded data is taken from the cache
+ * when it's there, and added to it when it's not.
+ *
+ * @param s
+ *   Unfiltered file data.
+ *
+ * @param filter
+ *   Code of the filter to apply, or an empty string to return s unchanged.
+ */
 std::unique_ptr<stream::inout> CAMOTO_GAMEARCHIVE_API applyFilter(
 	std::unique_ptr<archfile> s, const std::string& filter);
 
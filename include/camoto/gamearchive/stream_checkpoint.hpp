@@ -0,0 +1,204 @@
+/**
+ * @file  camoto/gamearchive/stream_checkpoint.hpp
+ * @brief Filtered stream that can seek without decoding from the start.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_STREAM_CHECKPOINT_HPP_
+#define _CAMOTO_STREAM_CHECKPOINT_HPP_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <camoto/config.hpp>
+#include <camoto/filter.hpp>
+#include <camoto/stream.hpp>
+#include <camoto/gamearchive/archive.hpp>
+#include <camoto/gamearchive/filtertype.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Decoder states saved part way through a filtered file.
+/**
+ * A checkpoint is saved each time another interval() bytes have been decoded.
+ * Keep one of these for each FileHandle and pass it to every
+ * input_checkpointed opened on that file, and each stream will resume from
+ * the checkpoints saved by the others.  It can be shared between streams on
+ * different threads.
+ *
+ * If the file's stored data changes size, or its Archive::File::generation
+ * changes, all the checkpoints are discarded the next time a stream is opened
+ * with this index.
+ */
+class CAMOTO_GAMEARCHIVE_API CheckpointIndex
+{
+	public:
+		/// Create an empty index.
+		/**
+		 * @param interval
+		 *   Number of decoded bytes between checkpoints.  Smaller values make
+		 *   seeking faster but use more memory, as each checkpoint holds a copy
+		 *   of every decoder, including any dictionary or history buffer.
+		 */
+		CheckpointIndex(stream::len interval = 64 * 1024);
+
+		/// Get the number of decoded bytes between checkpoints.
+		stream::len interval() const;
+
+		/// Get the number of checkpoints saved so far.
+		std::size_t count() const;
+
+	protected:
+		friend class input_checkpointed;
+
+		/// State of one decoder.
+		struct Stage
+		{
+			std::shared_ptr<filter> decoder; ///< Decoder and its current state
+			std::vector<uint8_t> pending;    ///< Input not yet accepted by decoder
+			bool eof;                        ///< No more input to come
+		};
+
+		/// State of the whole decoder chain, lenInterval * (i + 1) bytes in.
+		struct Checkpoint
+		{
+			stream::pos offIn;         ///< Amount of filtered data read
+			std::vector<Stage> stages; ///< State of each decoder
+		};
+
+		stream::len lenInterval;              ///< Decoded bytes per checkpoint
+		mutable std::mutex lock;              ///< Protects everything below
+		std::vector<Checkpoint> checkpoints;  ///< Checkpoint i is at (i+1)*interval
+		stream::len lenSource;                ///< Size of the filtered data
+		unsigned long generation;             ///< Version of the filtered data
+		bool sizeKnown;                       ///< Has lenDecoded been found yet?
+		stream::len lenDecoded;               ///< Size of the decoded data
+};
+
+/// Read-only filtered stream which saves its progress as it goes.
+/**
+ * This decodes the data the same way as the stream returned by
+ * FilterType::apply(), except that every so often the state of all the
+ * decoders is copied into a CheckpointIndex.  Seeking then resumes decoding
+ * from the nearest checkpoint before the new position, rather than from the
+ * start of the file.  Only the data between the checkpoint and the read
+ * position is decoded and thrown away.
+ */
+class CAMOTO_GAMEARCHIVE_API input_checkpointed: virtual public stream::input
+{
+	public:
+		/// Decode a stream, saving checkpoints along the way.
+		/**
+		 * @param source
+		 *   Filtered data, e.g. from Archive::open() with useFilter set to false.
+		 *
+		 * @param decoders
+		 *   Decoders to run the data through, from FilterType::decoders().  These
+		 *   are never used directly, only copied, so they can be shared with
+		 *   other streams.
+		 *
+		 * @param index
+		 *   Checkpoints to resume from, and to add to.
+		 *
+		 * @param generation
+		 *   Version of the source data, e.g. Archive::File::generation.  If this
+		 *   is different to the last stream opened with the index, its
+		 *   checkpoints are discarded.
+		 */
+		input_checkpointed(std::unique_ptr<stream::input> source,
+			std::vector<FilterStage> decoders,
+			std::shared_ptr<CheckpointIndex> index, unsigned long generation = 0);
+
+		virtual ~input_checkpointed();
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len);
+		virtual void seekg(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellg() const;
+
+		/// Get the decoded size.
+		/**
+		 * Unless the index already knows it, this decodes the rest of the file
+		 * from the last checkpoint, saving checkpoints along the way.
+		 */
+		virtual stream::len size() const;
+
+	protected:
+		/// Where the decoders are up to.
+		struct State
+		{
+			std::vector<CheckpointIndex::Stage> stages; ///< Each decoder's state
+			stream::pos offIn;  ///< Amount of filtered data read
+			stream::pos offOut; ///< Amount of decoded data produced
+			bool finished;      ///< All data has been decoded
+		};
+
+		std::unique_ptr<stream::input> source;  ///< Filtered data
+		std::vector<FilterStage> filters;       ///< Decoders in initial state
+		std::shared_ptr<CheckpointIndex> index; ///< Saved states
+		stream::len lenSource;                  ///< Size of source
+		State current;                          ///< Decoder state for reads
+		stream::pos offRead;                    ///< Current read position
+
+		/// Get decoders to the given position.
+		/**
+		 * Starts again from the nearest checkpoint if the target is behind the
+		 * current position, or if a checkpoint is closer than the current
+		 * position.
+		 */
+		void seekState(State *st, stream::pos target) const;
+
+		/// Decode data, saving a checkpoint at each interval.
+		/**
+		 * @return Number of bytes written to out, which is only less than len if
+		 *   the end of the data was reached.
+		 */
+		stream::len decode(State *st, uint8_t *out, stream::len len) const;
+
+		/// Get decoded data out of one decoder, feeding it input as needed.
+		stream::len pull(State *st, std::size_t i, uint8_t *out, stream::len len)
+			const;
+
+		/// Make an independent copy of decoder states.
+		std::vector<CheckpointIndex::Stage> copyStages(
+			const std::vector<CheckpointIndex::Stage>& stages) const;
+};
+
+/// Open a file, using checkpoints if its filter supports them.
+/**
+ * @param archive
+ *   Archive containing the file.
+ *
+ * @param id
+ *   File to open.
+ *
+ * @param index
+ *   Checkpoints for this file.  This should be kept with the FileHandle and
+ *   passed in every time the same file is opened.
+ *
+ * @return A stream returning the decoded data.  If the file isn't filtered,
+ *   or its filter can't be checkpointed, this is the same stream as
+ *   Archive::open() would return.
+ */
+std::unique_ptr<stream::input> CAMOTO_GAMEARCHIVE_API openCheckpointed(
+	std::shared_ptr<Archive> archive, const Archive::FileHandle& id,
+	std::shared_ptr<CheckpointIndex> index);
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_STREAM_CHECKPOINT_HPP_
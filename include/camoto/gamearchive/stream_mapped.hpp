@@ -0,0 +1,119 @@
+/**
+ * @file  camoto/gamearchive/stream_mapped.hpp
+ * @brief Read-only streams backed by memory or a memory-mapped file.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_STREAM_MAPPED_HPP_
+#define _CAMOTO_STREAM_MAPPED_HPP_
+
+#include <string>
+#include <vector>
+#include <camoto/config.hpp>
+#include <camoto/stream.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Read-only stream over a block of memory owned by someone else.
+/**
+ * Each instance has its own read position, so any number of these can read
+ * the same block of memory from different threads at the same time.  This is
+ * an inout stream so it can be used anywhere an archive stream is expected,
+ * but any attempt to write to it or change its size will throw
+ * stream::write_error.
+ */
+class CAMOTO_GAMEARCHIVE_API memory_view: virtual public stream::inout
+{
+	public:
+		/// Create a stream over existing memory.
+		/**
+		 * @param base
+		 *   First byte of the data.  This must remain valid for the life of the
+		 *   stream.
+		 *
+		 * @param len
+		 *   Number of bytes available at base.
+		 */
+		memory_view(const uint8_t *base, stream::len len);
+
+		virtual ~memory_view();
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len);
+		virtual void seekg(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellg() const;
+		virtual stream::len size() const;
+
+		virtual stream::len try_write(const uint8_t *buffer, stream::len len);
+		virtual void seekp(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellp() const;
+		virtual void truncate(stream::len size);
+		virtual void flush();
+
+		/// Get direct access to the stream content.
+		/**
+		 * @return Pointer to the first byte of the data, with size() bytes
+		 *   available.  May be nullptr if the stream is empty.
+		 */
+		const uint8_t *data() const;
+
+	protected:
+		const uint8_t *base;   ///< Start of the data
+		stream::len lenData;   ///< Size of the data, in bytes
+		stream::pos offRead;   ///< Current read position
+		stream::pos offWrite;  ///< Current write position (only seeking allowed)
+};
+
+/// Read-only stream over a whole file mapped into memory.
+/**
+ * Reads are served straight out of the mapping, so once the file is open no
+ * further system calls are needed to read from it.  Use
+ * ArchiveType::openReadOnly() to open an archive this way.  Archive_FAT gives
+ * each file opened from such an archive its own memory_view over the mapping,
+ * so they can be read from different threads at once.
+ *
+ * On platforms without mmap() the whole file is read into memory instead.
+ */
+class CAMOTO_GAMEARCHIVE_API mapped_file: virtual public memory_view
+{
+	public:
+		/// Map an existing file into memory.
+		/**
+		 * @param filename
+		 *   Name of the file to open.
+		 *
+		 * @throws stream::open_error if the file could not be opened or mapped.
+		 */
+		mapped_file(const std::string& filename);
+
+		/// Unmap the file.
+		virtual ~mapped_file();
+
+		/// Prevent copying, as the mapping can only be released once.
+		mapped_file(const mapped_file&) = delete;
+
+#ifdef WIN32
+	protected:
+		/// File content, as there is no mmap() on this platform.
+		std::vector<uint8_t> buffer;
+#endif
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_STREAM_MAPPED_HPP_
@@ -0,0 +1,172 @@
+/**
+ * @file  camoto/gamearchive/stream_shifting.hpp
+ * @brief Read/write file stream that can insert and remove data in place.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_STREAM_SHIFTING_HPP_
+#define _CAMOTO_STREAM_SHIFTING_HPP_
+
+#ifndef WIN32
+
+#include <string>
+#include <camoto/config.hpp>
+#include <camoto/stream.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Read/write stream over a file, which can insert and remove data in place.
+/**
+ * Inserting or removing data in the middle of a file normally means moving
+ * everything after that point.  On Linux filesystems that support
+ * fallocate() with FALLOC_FL_INSERT_RANGE and FALLOC_FL_COLLAPSE_RANGE (such
+ * as ext4 and XFS), insert() and remove() have the filesystem do this by
+ * rearranging its blocks instead, so only the partial block at the start of
+ * the change is copied.  This only works when the amount being inserted or
+ * removed is a multiple of blockSize().  Otherwise, or on other filesystems,
+ * the data is copied as usual.
+ *
+ * Archive_FAT uses insert() and remove() directly when an archive is opened
+ * from one of these, so to get the benefit, open a writable archive with
+ * ArchiveType::open(std::make_unique<shifting_file>(filename), ...).  Since
+ * the filename is known, Archive_FAT can also use rewrite() to save an
+ * archive with a lot of changes pending.
+ */
+class CAMOTO_GAMEARCHIVE_API shifting_file: virtual public stream::inout
+{
+	public:
+		/// Open an existing file for reading and writing.
+		/**
+		 * @param filename
+		 *   Name of the file to open.
+		 *
+		 * @throws stream::open_error if the file could not be opened.
+		 */
+		shifting_file(const std::string& filename);
+
+		/// Close the file.
+		virtual ~shifting_file();
+
+		/// Prevent copying, as the file can only be closed once.
+		shifting_file(const shifting_file&) = delete;
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len);
+		virtual void seekg(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellg() const;
+		virtual stream::len size() const;
+
+		virtual stream::len try_write(const uint8_t *buffer, stream::len len);
+		virtual void seekp(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellp() const;
+		virtual void truncate(stream::len size);
+		virtual void flush();
+
+		/// Insert zero bytes, moving the data after them further into the file.
+		/**
+		 * @param offset
+		 *   Where to insert the new bytes.  May be the end of the file.
+		 *
+		 * @param len
+		 *   Number of bytes to insert.
+		 */
+		void insert(stream::pos offset, stream::len len);
+
+		/// Remove bytes, moving the data after them back to fill the gap.
+		/**
+		 * @param offset
+		 *   First byte to remove.
+		 *
+		 * @param len
+		 *   Number of bytes to remove.
+		 */
+		void remove(stream::pos offset, stream::len len);
+
+		/// Get the size insert() and remove() must be a multiple of to avoid
+		/// copying.
+		stream::len blockSize() const;
+
+		/// Get the number of bytes insert() and remove() have had to copy.
+		stream::len bytesCopied() const;
+
+		/// Replace the file with a fresh copy of some other data.
+		/**
+		 * The data is written from start to end into a temporary file in the
+		 * same directory, which is synced to disk and then renamed over the
+		 * original.  A crash part way through leaves either the old file or the
+		 * new one, never a mix of the two.  This stream then refers to the new
+		 * file.
+		 *
+		 * @param src
+		 *   Data to write.  It is read from the start.
+		 *
+		 * The new file gets the same owner, group and permissions as the old one.
+		 * Files that are hard linked elsewhere, or opened through a symlink, are
+		 * never replaced, as the other names would be left pointing at the old
+		 * data.
+		 *
+		 * @return true if the file was replaced, false if it couldn't be (e.g.
+		 *   the directory is read-only, the file has more than one name, or its
+		 *   owner couldn't be copied) in which case nothing has changed and the
+		 *   caller should update the file in place instead.
+		 *
+		 * @throws stream::error on I/O error, in which case the original file is
+		 *   left untouched.
+		 */
+		bool rewrite(stream::input& src);
+
+		/// Stop reads and writes from reaching the file.
+		/**
+		 * While detached, writes are accepted and discarded, reads return
+		 * zeroes and truncate() only changes the reported size.  This is used
+		 * after rewrite(), so a stream::seg on top of this one can flush the
+		 * changes it is holding without redoing the work.
+		 *
+		 * @param detach
+		 *   true to stop passing data through to the file, false to resume.
+		 */
+		void setDetached(bool detach);
+
+	protected:
+		std::string filename;   ///< Name of the file, for rewrite()
+		int fd;                 ///< File descriptor
+		stream::pos offRead;    ///< Current read position
+		stream::pos offWrite;   ///< Current write position
+		stream::len lenBlock;   ///< Filesystem block size
+		stream::len lenCopied;  ///< Bytes copied by insert() and remove()
+		bool detached;          ///< Discard I/O, see setDetached()
+		stream::len lenDetach;  ///< Size reported while detached
+
+		/// Copy data within the file.  The two areas may overlap.
+		void copy(stream::pos from, stream::pos to, stream::len len);
+
+		/// Overwrite part of the file with zeroes.
+		void zero(stream::pos offset, stream::len len);
+
+		/// Read exactly len bytes from a given offset.
+		void readAt(stream::pos offset, uint8_t *buffer, stream::len len);
+
+		/// Write exactly len bytes at a given offset.
+		void writeAt(stream::pos offset, const uint8_t *buffer, stream::len len);
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // WIN32
+
+#endif // _CAMOTO_STREAM_SHIFTING_HPP_
@@ -21,6 +21,8 @@
 #ifndef _CAMOTO_GAMEARCHIVE_UTIL_HPP_
 #define _CAMOTO_GAMEARCHIVE_UTIL_HPP_
 
+#include <string>
+#include <vector>
 #include <camoto/config.hpp>
 #include <camoto/stream_sub.hpp>
 #include <camoto/gamearchive/archive.hpp>
@@ -49,6 +51,59 @@ namespace gamearchive {
 void CAMOTO_GAMEARCHIVE_API findFile(std::shared_ptr<Archive> *pArchive,
 	Archive::FileHandle *pFile, const std::string& filename);
 
+/// One file to be written out by extractFiles().
+struct CAMOTO_GAMEARCHIVE_API ExtractJob
+{
+	/// File in the archive to extract.
+	Archive::FileHandle id;
+
+	/// Filename to write the data to on the local filesystem.  Any existing
+	/// file with this name is overwritten.
+	std::string target;
+
+	/// Set by extractFiles() to true if the file was written out successfully.
+	bool success;
+
+	/// Set by extractFiles() to the reason for failure if success is false.
+	std::string error;
+};
+
+/// Extract a number of files from an archive, optionally in parallel.
+/**
+ * Each file is opened, decoded (if useFilters is true) and written out by a
+ * single worker thread, which gets its own stream and filter instance from
+ * Archive::open().  Workers take the next unclaimed job from the list as soon
+ * as they finish the previous one, so a few large compressed files won't hold
+ * up the rest.  The data written is the same no matter how many threads are
+ * used.
+ *
+ * If the archive does not support concurrent reads (see
+ * Archive::canReadConcurrently()) the files are extracted one at a time in the
+ * calling thread, regardless of numThreads.
+ *
+ * @param archive
+ *   Archive holding the files.  Folders cannot be extracted with this
+ *   function, use Archive::openFolder() and extract the files inside instead.
+ *
+ * @param jobs
+ *   Files to extract.  The success and error fields are filled in on return.
+ *   Each target must be unique, otherwise two threads may write to the same
+ *   file at once.
+ *
+ * @param useFilters
+ *   true to decode the files, false to extract the raw data as stored in the
+ *   archive.  This is passed on to Archive::open().
+ *
+ * @param numThreads
+ *   Maximum number of threads to use.  0 or 1 extracts everything in the
+ *   calling thread.
+ *
+ * @return true if all files were extracted, false if any failed.  Check
+ *   ExtractJob::success to find out which ones.
+ */
+bool CAMOTO_GAMEARCHIVE_API extractFiles(std::shared_ptr<Archive> archive,
+	std::vector<ExtractJob>& jobs, bool useFilters, unsigned int numThreads);
+
 /// Truncate callback for substreams that are a fixed size.
 void CAMOTO_GAMEARCHIVE_API preventResize(stream::output_sub* sub,
 	stream::len len);
@@ -18,15 +18,27 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <functional>
 #include <boost/algorithm/string.hpp>
 #include <camoto/util.hpp> // createString
 #include <camoto/gamearchive/archive-fat.hpp>
+#include <camoto/gamearchive/cache.hpp>
 #include <camoto/gamearchive/stream_archfile.hpp>
+#include <camoto/gamearchive/stream_mapped.hpp>
+#include <camoto/gamearchive/stream_shifting.hpp>
 
 namespace camoto {
 namespace gamearchive {
 
+/// Sort order for Archive_FAT::offsetIndex.
+static bool offsetOrder(const Archive_FAT::FATEntry *a,
+	const Archive_FAT::FATEntry *b)
+{
+	if (a->iOffset != b->iOffset) return a->iOffset < b->iOffset;
+	return a->iIndex < b->iIndex;
+}
+
 Archive_FAT::FATEntry::FATEntry()
 {
 }
@@ -44,15 +56,35 @@ std::string Archive_FAT::FATEntry::getContent() const
 	return ss.str();
 }
 
+/// Get the shifting_file a stream is, or nullptr if it's some other stream.
+static shifting_file *asShifting(stream::inout *s)
+{
+#ifdef WIN32
+	return nullptr;
+#else
+	return dynamic_cast<shifting_file *>(s);
+#endif
+}
+
 Archive_FAT::Archive_FAT(std::unique_ptr<stream::inout> content,
 	stream::pos offFirstFile, int lenMaxFilename)
-	:	content(std::make_shared<stream::seg>(std::move(content))),
+	:	mapped(dynamic_cast<const mapped_file *>(content.get())),
+		shifting(asShifting(content.get())),
+		content(std::make_shared<stream::seg>(std::move(content))),
 		offFirstFile(offFirstFile),
-		lenMaxFilename(lenMaxFilename)
+		lenMaxFilename(lenMaxFilename),
+		nameIndexValid(false),
+		offsetIndexValid(false),
+		lenPendingShift(0)
 {
 }
 
 Archive_FAT::Archive_FAT()
+	:	mapped(nullptr),
+		shifting(nullptr),
+		nameIndexValid(false),
+		offsetIndexValid(false),
+		lenPendingShift(0)
 {
 }
 
@@ -78,13 +110,25 @@ const Archive::FileVector& Archive_FAT::files() const
 const Archive::FileHandle Archive_FAT::find(const std::string& strFilename) const
 {
 	// TESTED BY: fmt_grp_duke3d_*
-	for (const auto& i : this->vcFAT) {
-		auto pFAT = dynamic_cast<const FATEntry *>(&*i);
-		if (boost::iequals(pFAT->strName, strFilename)) {
-			return i;
+	if (!this->nameIndexValid.load(std::memory_order_acquire)) {
+		// Several threads may call find() at once on a read-only archive, so only
+		// let one of them build the index.
+		std::lock_guard<std::mutex> lock(this->nameIndexLock);
+		if (!this->nameIndexValid.load(std::memory_order_relaxed)) {
+			this->nameIndex.clear();
+			this->nameIndex.reserve(this->vcFAT.size());
+			for (const auto& i : this->vcFAT) {
+				// emplace() won't replace an existing key, so the first file with any
+				// given name is the one that gets returned.
+				this->nameIndex.emplace(boost::to_upper_copy(i->strName), i);
+			}
+			this->nameIndexValid.store(true, std::memory_order_release);
 		}
 	}
-	return nullptr;
+
+	auto itFile = this->nameIndex.find(boost::to_upper_copy(strFilename));
+	if (itFile == this->nameIndex.end()) return nullptr;
+	return itFile->second;
 }
 
 bool Archive_FAT::isValid(const FileHandle& id) const
@@ -116,10 +160,21 @@ std::unique_ptr<stream::inout> Archive_FAT::open(const FileHandle& id,
 			"that wasn't encapsulated in a shared_ptr!");
 	}
 
+	// Read-only archives give each stream its own view of the mapped file, so
+	// streams opened from different threads don't fight over the read position
+	// of the shared content stream.
+	std::shared_ptr<stream::inout> parent;
+	if (this->mapped) {
+		parent = std::make_shared<memory_view>(this->mapped->data(),
+			this->mapped->size());
+	} else {
+		parent = this->content;
+	}
+
 	auto raw = std::make_unique<archfile>(
 		this->shared_from_this(),
 		id,
-		this->content
+		parent
 	);
 
 	if (useFilter && !id->filter.empty()) {
@@ -132,6 +187,26 @@ std::unique_ptr<stream::inout> Archive_FAT::open(const FileHandle& id,
 	return std::move(raw);
 }
 
+const uint8_t *Archive_FAT::mappedData(const FileHandle& id) const
+{
+	if (!this->mapped) return nullptr;
+	if (!this->isValid(id)) return nullptr;
+
+	auto pFAT = FATEntry::cast(id);
+	stream::pos offData = pFAT->iOffset + pFAT->lenHeader;
+
+	// Don't hand out a pointer past the end of a truncated or corrupted archive.
+	if (offData + pFAT->storedSize > this->mapped->size()) return nullptr;
+
+	return this->mapped->data() + offData;
+}
+
+bool Archive_FAT::canReadConcurrently() const
+{
+	// Each stream gets its own memory_view in open(), see there.
+	return this->mapped != nullptr;
+}
+
 std::shared_ptr<Archive> Archive_FAT::openFolder(const FileHandle& id)
 {
 	// This function should only be called for folders (not files)
@@ -148,6 +223,7 @@ const Archive::FileHandle Archive_FAT::insert(const FileHandle& idBeforeThis,
 	// TESTED BY: fmt_grp_duke3d_insert2
 	// TESTED BY: fmt_grp_duke3d_remove_insert
 	// TESTED BY: fmt_grp_duke3d_insert_remove
+	this->requireWritable();
 
 	// Make sure filename is within the allowed limit
 	if (
@@ -224,16 +300,26 @@ const Archive::FileHandle Archive_FAT::insert(const FileHandle& idBeforeThis,
 		// TESTED BY: fmt_grp_duke3d_insert_end
 		this->vcFAT.push_back(pNewFile);
 	}
+	if (this->offsetIndexValid) {
+		this->offsetIndex.insert(
+			std::upper_bound(this->offsetIndex.begin(), this->offsetIndex.end(),
+				&*pNewFile, offsetOrder),
+			&*pNewFile
+		);
+	}
 
 	// Insert space for the file's data into the archive.  If there is a header
 	// (e.g. embedded FAT) then preInsertFile() will have inserted space for
 	// this and written the data, so our insert should start just after the
 	// header.
-	this->content->seekp(pNewFile->iOffset + pNewFile->lenHeader, stream::start);
-	this->content->insert(pNewFile->storedSize);
+	this->shiftContent(pNewFile->iOffset + pNewFile->lenHeader,
+		pNewFile->storedSize);
 
 	this->postInsertFile(&*pNewFile);
 
+	// Index the name last, as the format handler may have altered it above.
+	this->indexFile(pNewFile, !this->isValid(idBeforeThis));
+
 	return pNewFile;
 }
 
@@ -246,10 +332,13 @@ void Archive_FAT::remove(const FileHandle& id)
 
 	// Make sure the caller doesn't try to remove something that doesn't exist!
 	assert(this->isValid(id));
+	this->requireWritable();
 
 	auto pFAT = FATEntry::cast(id);
 	assert(pFAT);
 
+	DecodedCache::instance().invalidate(this, id);
+
 	// Remove the file's entry from the FAT
 	this->preRemoveFile(pFAT);
 
@@ -261,6 +350,18 @@ void Archive_FAT::remove(const FileHandle& id)
 	auto itErase = std::find(this->vcFAT.begin(), this->vcFAT.end(), id);
 	assert(itErase != this->vcFAT.end());
 	this->vcFAT.erase(itErase);
+	this->unindexFile(idCopy);
+	if (this->offsetIndexValid) {
+		auto itOffset = std::lower_bound(this->offsetIndex.begin(),
+			this->offsetIndex.end(), pFAT, offsetOrder);
+		if ((itOffset != this->offsetIndex.end()) && (*itOffset == pFAT)) {
+			this->offsetIndex.erase(itOffset);
+		} else {
+			// Shouldn't happen, but if the index has become unsorted somehow, just
+			// start again next time.
+			this->offsetIndexValid = false;
+		}
+	}
 
 	// Update the offsets of any files located after this one (since they will
 	// all have been shifted back to fill the gap made by the removal.)
@@ -271,9 +372,13 @@ void Archive_FAT::remove(const FileHandle& id)
 		-1
 	);
 
+	// preRemoveFile() may have shifted this file along with the others, but
+	// there is no longer a FAT entry to write its offset into.
+	this->pendingOffsets.erase(pFAT);
+
 	// Remove the file's data from the archive
-	this->content->seekp(pFAT->iOffset, stream::start);
-	this->content->remove(pFAT->storedSize + pFAT->lenHeader);
+	this->shiftContent(pFAT->iOffset,
+		-((stream::delta)pFAT->storedSize + (stream::delta)pFAT->lenHeader));
 
 	// Mark it as invalid in case some other code is still holding on to it.
 	pFAT->bValid = false;
@@ -287,6 +392,7 @@ void Archive_FAT::rename(const FileHandle& id, const std::string& strNewName)
 {
 	// TESTED BY: fmt_grp_duke3d_rename
 	assert(this->isValid(id));
+	this->requireWritable();
 	auto pFAT = FATEntry::cast(id);
 
 	// Make sure filename is within the allowed limit
@@ -299,12 +405,16 @@ void Archive_FAT::rename(const FileHandle& id, const std::string& strNewName)
 	}
 
 	this->updateFileName(pFAT, strNewName);
+	this->unindexFile(id);
 	pFAT->strName = strNewName;
+	this->indexFile(id, false);
 	return;
 }
 
 void Archive_FAT::move(const FileHandle& idBeforeThis, const FileHandle& id)
 {
+	this->requireWritable();
+
 	// Open the file we want to move
 	auto src = this->open(id, false);
 	assert(src);
@@ -343,6 +453,9 @@ void Archive_FAT::resize(const FileHandle& id, stream::len newStoredSize,
 	stream::len newRealSize)
 {
 	assert(this->isValid(id));
+	this->requireWritable();
+	id->generation++;
+	DecodedCache::instance().invalidate(this, id);
 	auto pFAT = FATEntry::cast(id);
 	stream::delta iDelta = newStoredSize - id->storedSize;
 
@@ -366,13 +479,11 @@ void Archive_FAT::resize(const FileHandle& id, stream::len newStoredSize,
 	if (iDelta > 0) { // inserting data
 		// TESTED BY: fmt_grp_duke3d_resize_larger
 		iStart = pFAT->iOffset + pFAT->lenHeader + oldStoredSize;
-		this->content->seekp(iStart, stream::start);
-		this->content->insert(iDelta);
+		this->shiftContent(iStart, iDelta);
 	} else if (iDelta < 0) { // removing data
 		// TESTED BY: fmt_grp_duke3d_resize_smaller
 		iStart = pFAT->iOffset + pFAT->lenHeader + newStoredSize;
-		this->content->seekp(iStart, stream::start);
-		this->content->remove(-iDelta);
+		this->shiftContent(iStart, iDelta);
 	} else if (pFAT->realSize == newRealSize) {
 		// Not resizing the internal size, and the external/real size
 		// hasn't changed either, so nothing to do.
@@ -390,16 +501,59 @@ void Archive_FAT::resize(const FileHandle& id, stream::len newStoredSize,
 
 void Archive_FAT::flush()
 {
+	this->flushFileOffsets();
+
+#ifndef WIN32
+	if (this->shifting && (this->lenPendingShift > this->content->size())) {
+		// Shuffling everything around in place would mean copying more than the
+		// whole archive, so write out a new copy from start to finish instead.
+		// content still has all the changes queued up, so once the new copy is
+		// in place it must flush them into thin air to get back in step with it.
+		if (this->shifting->rewrite(*this->content)) {
+			this->shifting->setDetached(true);
+			try {
+				this->content->flush();
+			} catch (...) {
+				this->shifting->setDetached(false);
+				throw;
+			}
+			this->shifting->setDetached(false);
+			this->lenPendingShift = 0;
+			return;
+		}
+		// Couldn't create the new copy, so carry on the slow way
+	}
+#endif
+
 	// Write out to the underlying stream
 	this->content->flush();
+	this->lenPendingShift = 0;
 	return;
 }
 
 void Archive_FAT::shiftFiles(const FATEntry *fatSkip, stream::pos offStart,
 	stream::delta deltaOffset, int deltaIndex)
 {
-	for (auto& i : this->vcFAT) {
-		auto pFAT = FATEntry::cast(i);
+	if (!this->offsetIndexValid) {
+		this->offsetIndex.clear();
+		this->offsetIndex.reserve(this->vcFAT.size());
+		for (auto& i : this->vcFAT) {
+			this->offsetIndex.push_back(FATEntry::cast(i));
+		}
+		std::sort(this->offsetIndex.begin(), this->offsetIndex.end(), offsetOrder);
+		this->offsetIndexValid = true;
+	}
+
+	// Only files starting at or after offStart can be affected, and these are
+	// all together at the end of the index.
+	auto itStart = std::lower_bound(this->offsetIndex.begin(),
+		this->offsetIndex.end(), offStart,
+		[](const FATEntry *fat, stream::pos off) {
+			return fat->iOffset < off;
+		}
+	);
+	for (auto itFAT = itStart; itFAT != this->offsetIndex.end(); itFAT++) {
+		auto pFAT = *itFAT;
 		if (this->entryInRange(pFAT, offStart, fatSkip)) {
 			// This file is located after the one we're deleting, so tweak its offset
 			pFAT->iOffset += deltaOffset;
@@ -410,9 +564,65 @@ void Archive_FAT::shiftFiles(const FATEntry *fatSkip, stream::pos offStart,
 			// ensure the right place in the file gets changed.
 			pFAT->iIndex += deltaIndex;
 
-			this->updateFileOffset(pFAT, deltaOffset);
+			// Leave the on-disk FAT until flush time, as this file could well be
+			// moved again by the next insert or remove.
+			this->pendingOffsets[pFAT] += deltaOffset;
+		}
+	}
+	return;
+}
+
+void Archive_FAT::attribute(unsigned int index, int newValue)
+{
+	this->requireWritable();
+	this->Archive::attribute(index, newValue);
+	return;
+}
+
+void Archive_FAT::attribute(unsigned int index, const std::string& newValue)
+{
+	this->requireWritable();
+	this->Archive::attribute(index, newValue);
+	return;
+}
+
+void Archive_FAT::flushFileOffsets()
+{
+	if (this->pendingOffsets.empty()) return;
+
+	MovedFileVector moved;
+	moved.reserve(this->pendingOffsets.size());
+	for (const auto& i : this->pendingOffsets) {
+		if (!i.first->bValid) continue;
+		moved.emplace_back(i.first, i.second);
+	}
+
+	// Write the entries out in FAT order, so the on-disk FAT is updated in a
+	// single pass from start to end.
+	std::sort(moved.begin(), moved.end(),
+		[](const MovedFileVector::value_type& a,
+			const MovedFileVector::value_type& b) {
+			return a.first->iIndex < b.first->iIndex;
+		}
+	);
+
+	// Hand over each run of consecutive entries in one go.
+	auto itRun = moved.cbegin();
+	while (itRun != moved.cend()) {
+		auto itEnd = itRun + 1;
+		while (
+			(itEnd != moved.cend())
+			&& (itEnd->first->iIndex == (itEnd - 1)->first->iIndex + 1)
+		) {
+			itEnd++;
 		}
+		this->updateFileOffsets(itRun, itEnd);
+		itRun = itEnd;
 	}
+
+	// Only forget the changes once they have all been written, so a failed
+	// flush can be retried.
+	this->pendingOffsets.clear();
 	return;
 }
 
@@ -427,6 +637,15 @@ void Archive_FAT::updateFileOffset(const FATEntry *pid, stream::delta offDelta)
 	return;
 }
 
+void Archive_FAT::updateFileOffsets(MovedFileVector::const_iterator begin,
+	MovedFileVector::const_iterator end)
+{
+	for (auto i = begin; i != end; i++) {
+		this->updateFileOffset(i->first, i->second);
+	}
+	return;
+}
+
 void Archive_FAT::updateFileSize(const FATEntry *pid, stream::delta sizeDelta)
 {
 	// No-op default
@@ -463,6 +682,55 @@ std::unique_ptr<Archive_FAT::FATEntry> Archive_FAT::createNewFATEntry()
 	return std::make_unique<FATEntry>();
 }
 
+void Archive_FAT::requireWritable() const
+{
+	if (this->mapped) {
+		throw stream::error("This archive was opened read-only and cannot be "
+			"modified.");
+	}
+	return;
+}
+
+void Archive_FAT::shiftContent(stream::pos offset, stream::delta delta)
+{
+#ifndef WIN32
+	if (
+		this->shifting
+		&& (delta != 0)
+		&& (delta % (stream::delta)this->shifting->blockSize() == 0)
+	) {
+		// content can't be told the file underneath it has changed, so anything
+		// it is holding on to has to be written out first, and its idea of the
+		// file size kept in step with the real one.
+		this->content->flush();
+		this->lenPendingShift = 0;
+		stream::len lenOld = this->content->size();
+		if (delta > 0) {
+			// Extend content first, otherwise it would later write zeroes over the
+			// end of the data the file has just moved there.
+			this->content->truncate(lenOld + delta);
+			this->content->flush();
+			this->shifting->truncate(lenOld);
+			this->shifting->insert(offset, delta);
+		} else {
+			this->shifting->remove(offset, -delta);
+			this->content->truncate(lenOld + delta);
+			this->content->flush();
+		}
+		return;
+	}
+#endif
+
+	if (delta != 0) this->lenPendingShift += this->content->size() - offset;
+	this->content->seekp(offset, stream::start);
+	if (delta > 0) {
+		this->content->insert(delta);
+	} else if (delta < 0) {
+		this->content->remove(-delta);
+	}
+	return;
+}
+
 bool Archive_FAT::entryInRange(const FATEntry *fat, stream::pos offStart,
 	const FATEntry *fatSkip)
 {
@@ -496,5 +764,41 @@ bool Archive_FAT::entryInRange(const FATEntry *fat, stream::pos offStart,
 	return true;
 }
 
+void Archive_FAT::indexFile(const FileHandle& id, bool appended) const
+{
+	if (!this->nameIndexValid) return; // will be picked up on the next rebuild
+
+	auto ins = this->nameIndex.emplace(boost::to_upper_copy(id->strName), id);
+	if ((!ins.second) && (!appended)) {
+		// There's already a file with this name, and we don't know whether it
+		// comes before or after the new one, so start again next time.
+		this->nameIndexValid = false;
+		this->nameIndex.clear();
+	}
+	return;
+}
+
+void Archive_FAT::unindexFile(const FileHandle& id) const
+{
+	if (!this->nameIndexValid) return;
+
+	auto itFile = this->nameIndex.find(boost::to_upper_copy(id->strName));
+	if ((itFile == this->nameIndex.end()) || (itFile->second != id)) {
+		// Either not indexed, or a duplicate earlier in the archive is indexed
+		// instead, so nothing changes.
+		return;
+	}
+	this->nameIndex.erase(itFile);
+
+	// If there's another file with the same name, it now becomes the first one.
+	for (const auto& i : this->vcFAT) {
+		if ((i != id) && boost::iequals(i->strName, id->strName)) {
+			this->nameIndex.emplace(boost::to_upper_copy(i->strName), i);
+			break;
+		}
+	}
+	return;
+}
+
 } // namespace gamearchive
 } // namespace camoto
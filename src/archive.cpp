@@ -25,6 +25,7 @@ namespace camoto {
 namespace gamearchive {
 
 Archive::File::File()
+	:	generation(0)
 {
 }
 
@@ -44,6 +45,16 @@ std::string Archive::File::getContent() const
 	);
 }
 
+const uint8_t *Archive::mappedData(const FileHandle& id) const
+{
+	return nullptr;
+}
+
+bool Archive::canReadConcurrently() const
+{
+	return false;
+}
+
 Archive::File::Attribute Archive::getSupportedAttributes() const
 {
 	return File::Attribute::Default;
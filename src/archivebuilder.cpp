@@ -0,0 +1,109 @@
+/**
+ * @file  archivebuilder.cpp
+ * @brief Shared code for writing a whole new archive in one pass.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <camoto/stream_string.hpp>
+#include <camoto/util.hpp> // createString
+#include <camoto/gamearchive/archivebuilder.hpp>
+#include <camoto/gamearchive/manager.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Size of the buffer used when copying file data into the archive.
+#define BUILD_BUFFER_SIZE 65536
+
+ArchiveBuilder::~ArchiveBuilder()
+{
+}
+
+void ArchiveBuilder::writeData(stream::output& content, const Entry& file)
+{
+	if (file.size == 0) return;
+	if (!file.open) {
+		throw stream::error(createString("No data was supplied for \""
+			<< file.strName << "\""));
+	}
+	auto src = file.open();
+
+	std::vector<uint8_t> buffer(std::min<stream::len>(file.size,
+		BUILD_BUFFER_SIZE));
+	stream::len lenRemaining = file.size;
+	while (lenRemaining) {
+		stream::len lenRead = src->try_read(buffer.data(),
+			std::min<stream::len>(lenRemaining, buffer.size()));
+		if (lenRead == 0) {
+			throw stream::error(createString("\"" << file.strName << "\" ended "
+				<< lenRemaining << " bytes short of its size of " << file.size
+				<< " bytes"));
+		}
+		content.write(buffer.data(), lenRead);
+		lenRemaining -= lenRead;
+	}
+	return;
+}
+
+std::string ArchiveBuilder::encode(const Entry& file, const std::string& filter)
+{
+	auto pFilterType = FilterManager::byCode(filter);
+	if (!pFilterType) {
+		throw stream::error(createString(
+			"could not find filter \"" << filter << "\""
+		));
+	}
+
+	// The filtered stream takes ownership of this, but it stays around until
+	// the filtered stream is destroyed at the end of this function.
+	auto out = std::make_unique<stream::string>();
+	auto& data = out->data;
+	auto filtered = pFilterType->apply(
+		std::unique_ptr<stream::output>(std::move(out)),
+		stream::fn_notify_prefiltered_size()
+	);
+	writeData(*filtered, file);
+	filtered->flush();
+	return data;
+}
+
+void ArchiveBuilder::checkFilenames(const std::vector<Entry>& files,
+	unsigned int lenMaxFilename)
+{
+	for (const auto& i : files) {
+		if (i.strName.length() > lenMaxFilename) {
+			throw stream::error(createString("maximum filename length is "
+				<< lenMaxFilename << " chars"));
+		}
+	}
+	return;
+}
+
+void ArchiveBuilder::checkArchiveSize(stream::len lenArchive,
+	stream::len lenMax)
+{
+	if (lenArchive > lenMax) {
+		throw stream::error(createString("The archive would be " << lenArchive
+			<< " bytes long, but this format cannot store archives larger than "
+			<< lenMax << " bytes."));
+	}
+	return;
+}
+
+} // namespace gamearchive
+} // namespace camoto
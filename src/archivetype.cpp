@@ -20,6 +20,7 @@
 
 #include <iostream>
 #include <camoto/gamearchive/archivetype.hpp>
+#include <camoto/gamearchive/stream_mapped.hpp>
 
 using namespace camoto;
 using namespace camoto::gamearchive;
@@ -40,3 +41,19 @@ CAMOTO_GAMEARCHIVE_API std::ostream& camoto::gamearchive::operator<< (
 #pragma GCC diagnostic pop
 	return s;
 }
+
+std::vector<ArchiveType::Signature> ArchiveType::signatures() const
+{
+	return {};
+}
+
+std::unique_ptr<ArchiveBuilder> ArchiveType::builder() const
+{
+	return nullptr;
+}
+
+std::shared_ptr<Archive> ArchiveType::openReadOnly(const std::string& filename,
+	SuppData& suppData) const
+{
+	return this->open(std::make_unique<mapped_file>(filename), suppData);
+}
@@ -0,0 +1,122 @@
+/**
+ * @file  bitreader.hpp
+ * @brief Fast big-endian bit reader for decompression filters.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_BITREADER_HPP_
+#define _CAMOTO_BITREADER_HPP_
+
+#include <stdint.h>
+#include <camoto/stream.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Read big-endian (MSB first) bit fields straight from a filter's input.
+/**
+ * This does the same job as a big-endian bitstream, but instead of fetching
+ * each byte through a callback it works on the input buffer passed to
+ * filter::transform().  Bits are held in a 64-bit buffer which is topped up
+ * eight bytes at a time while there is enough input left, and a byte at a time
+ * near the end of each input buffer.
+ *
+ * Bits left in the buffer at the end of one transform() call are kept for the
+ * next, so fields can be split across input buffers.
+ */
+class bitreader
+{
+	public:
+		/// Drop any buffered bits.
+		void reset()
+		{
+			this->buffer = 0;
+			this->count = 0;
+			return;
+		}
+
+		/// Make sure a number of bits are buffered.
+		/**
+		 * @param bits
+		 *   Number of bits needed, up to 56.
+		 *
+		 * @param in
+		 *   Input buffer passed to transform().
+		 *
+		 * @param lenIn
+		 *   Length of in.
+		 *
+		 * @param r
+		 *   Number of bytes in in that have been used.  This is increased by the
+		 *   number of bytes moved into the bit buffer.
+		 *
+		 * @return true if the bits are available, false if the input ran out
+		 *   first.  Any bits that were available are kept for the next call.
+		 */
+		bool need(unsigned int bits, const uint8_t *in, stream::len lenIn,
+			stream::len *r)
+		{
+			if (this->count >= bits) return true;
+
+			if (lenIn - *r >= 8) {
+				// Load a whole word and keep as many bytes as will fit
+				const uint8_t *p = in + *r;
+				uint64_t next =
+					((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48)
+					| ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
+					| ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16)
+					| ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+				unsigned int lenTake = (63 - this->count) >> 3;
+				this->buffer |= next >> this->count;
+				this->count += lenTake * 8;
+				// Drop the part of the byte that didn't fit
+				this->buffer &= ~(uint64_t)0 << (64 - this->count);
+				*r += lenTake;
+			} else {
+				while ((this->count <= 56) && (*r < lenIn)) {
+					this->buffer |= (uint64_t)in[(*r)++] << (56 - this->count);
+					this->count += 8;
+				}
+			}
+			return this->count >= bits;
+		}
+
+		/// Take bits from the buffer.
+		/**
+		 * need() must have returned true for at least this many bits first.
+		 *
+		 * @param bits
+		 *   Number of bits to take, up to 32.  May be zero.
+		 */
+		unsigned int get(unsigned int bits)
+		{
+			// Shifted in two steps so zero bits doesn't shift by 64
+			unsigned int value = (this->buffer >> 1) >> (63 - bits);
+			this->buffer <<= bits;
+			this->count -= bits;
+			return value;
+		}
+
+	protected:
+		uint64_t buffer;    ///< Buffered bits, first bit in the MSB
+		unsigned int count; ///< Number of bits in buffer
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_BITREADER_HPP_
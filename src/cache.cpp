@@ -0,0 +1,187 @@
+/**
+ * @file  cache.cpp
+ * @brief Cache of decoded file data, shared by all open archives.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <camoto/gamearchive/cache.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+DecodedCache& DecodedCache::instance()
+{
+	static DecodedCache cache;
+	return cache;
+}
+
+/// Fewest entries to let build up before looking for closed files.
+#define CACHE_MIN_SWEEP 256
+
+DecodedCache::DecodedCache()
+	:	lenBudget(0),
+		lenData(0),
+		hits(0),
+		misses(0),
+		lenSweep(CACHE_MIN_SWEEP),
+		numEntries(0)
+{
+}
+
+void DecodedCache::setBudget(stream::len bytes)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->lenBudget = bytes;
+	this->trim();
+	return;
+}
+
+stream::len DecodedCache::budget() const
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->lenBudget;
+}
+
+DecodedCache::Stats DecodedCache::stats() const
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	return {this->hits, this->misses, this->lenData, this->lru.size(),
+		this->entries.size()};
+}
+
+void DecodedCache::clear()
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->entries.clear();
+	this->lru.clear();
+	this->lenData = 0;
+	this->lenSweep = CACHE_MIN_SWEEP;
+	this->numEntries = 0;
+	this->hits = 0;
+	this->misses = 0;
+	return;
+}
+
+DecodedCache::Data DecodedCache::find(const Archive *archive,
+	const Archive::FileHandle& id, unsigned long *generation)
+{
+	*generation = id->generation;
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	auto i = this->entries.find(Key(archive, id.get()));
+	if (
+		(i != this->entries.end())
+		&& (
+			// Left behind by a file that has since been freed and its memory
+			// reused, or by an earlier version of this file
+			(i->second.id.lock() != id)
+			|| (i->second.generation != *generation)
+		)
+	) {
+		this->evict(i);
+		i = this->entries.end();
+	}
+	if (i == this->entries.end()) {
+		this->misses++;
+		return nullptr;
+	}
+	auto& entry = i->second;
+	// Move to the front of the queue
+	this->lru.splice(this->lru.begin(), this->lru, entry.lru);
+	this->hits++;
+	return entry.data;
+}
+
+void DecodedCache::store(const Archive *archive,
+	const Archive::FileHandle& id, unsigned long generation, Data data)
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	// The file's generation has to be checked with the lock held, so that if
+	// the file is changed straight after, invalidate() will find this entry.
+	if (id->generation != generation) return;
+	if ((this->lenBudget == 0) || (data->size() > this->lenBudget)) return;
+
+	Key key(archive, id.get());
+	auto i = this->entries.find(key);
+	if (i != this->entries.end()) {
+		if (i->second.generation == generation) return; // already stored
+		this->evict(i);
+	}
+
+	this->sweep();
+	i = this->entries.emplace(key, Entry()).first;
+	auto& entry = i->second;
+	entry.id = id;
+	entry.generation = generation;
+	entry.data = data;
+	this->lru.push_front(key);
+	entry.lru = this->lru.begin();
+	this->lenData += data->size();
+	this->numEntries = this->entries.size();
+	this->trim();
+	return;
+}
+
+void DecodedCache::invalidate(const Archive *archive,
+	const Archive::FileHandle& id)
+{
+	// Don't slow down every write to an archive when the cache isn't in use.
+	if (this->numEntries == 0) return;
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	auto i = this->entries.find(Key(archive, id.get()));
+	if (i == this->entries.end()) return;
+	this->evict(i);
+	return;
+}
+
+void DecodedCache::evict(std::map<Key, Entry>::iterator entry)
+{
+	this->lenData -= entry->second.data->size();
+	this->lru.erase(entry->second.lru);
+	this->entries.erase(entry);
+	this->numEntries = this->entries.size();
+	return;
+}
+
+void DecodedCache::trim()
+{
+	while (this->lenData > this->lenBudget) {
+		this->evict(this->entries.find(this->lru.back()));
+	}
+	return;
+}
+
+void DecodedCache::sweep()
+{
+	// Only look once the number of entries has doubled since last time, so
+	// the cost is spread out over all the store() calls in between.
+	if (this->entries.size() < this->lenSweep) return;
+	for (auto i = this->entries.begin(); i != this->entries.end(); ) {
+		auto next = std::next(i);
+		if (i->second.id.expired()) this->evict(i);
+		i = next;
+	}
+	this->lenSweep = std::max<std::size_t>(CACHE_MIN_SWEEP,
+		this->entries.size() * 2);
+	return;
+}
+
+} // namespace gamearchive
+} // namespace camoto
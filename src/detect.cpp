@@ -0,0 +1,278 @@
+/**
+ * @file  detect.cpp
+ * @brief Work out which format an archive file is in.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <camoto/gamearchive/detect.hpp>
+#include <camoto/gamearchive/manager.hpp>
+#include <camoto/gamearchive/stream_mapped.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Read-only stream that serves reads at the start of a file from memory.
+/**
+ * Anything past the end of the window is read from the underlying stream, so
+ * formats that need to look further into the file still work.  When several
+ * of these share a parent from different threads, the parent is only accessed
+ * while holding parentLock.
+ */
+class window_input: virtual public stream::input
+{
+	public:
+		window_input(stream::input& parent, const std::string& window,
+			stream::len lenParent, std::mutex& parentLock)
+			:	parent(parent),
+				window(window),
+				lenParent(lenParent),
+				parentLock(parentLock),
+				offRead(0)
+		{
+		}
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len)
+		{
+			stream::len lenDone = 0;
+			if (this->offRead < this->window.length()) {
+				lenDone = std::min<stream::len>(len,
+					this->window.length() - this->offRead);
+				memcpy(buffer, this->window.data() + this->offRead, lenDone);
+				this->offRead += lenDone;
+			}
+			if ((lenDone < len) && (this->offRead < this->lenParent)) {
+				std::lock_guard<std::mutex> lock(this->parentLock);
+				this->parent.seekg(this->offRead, stream::start);
+				stream::len lenExtra = this->parent.try_read(buffer + lenDone,
+					len - lenDone);
+				this->offRead += lenExtra;
+				lenDone += lenExtra;
+			}
+			return lenDone;
+		}
+
+		virtual void seekg(stream::delta off, stream::seek_from from)
+		{
+			stream::delta target;
+			switch (from) {
+				case stream::start: target = off; break;
+				case stream::cur: target = this->offRead + off; break;
+				case stream::end: target = this->lenParent + off; break;
+				default: throw stream::seek_error("Invalid seek origin");
+			}
+			if (target < 0) {
+				throw stream::seek_error("Attempt to seek to before start of file");
+			}
+			if ((stream::len)target > this->lenParent) {
+				throw stream::seek_error("Attempt to seek past end of file");
+			}
+			this->offRead = target;
+			return;
+		}
+
+		virtual stream::pos tellg() const
+		{
+			return this->offRead;
+		}
+
+		virtual stream::len size() const
+		{
+			return this->lenParent;
+		}
+
+	protected:
+		stream::input& parent;      ///< Stream the window came from
+		const std::string& window;  ///< Data at the start of parent
+		stream::len lenParent;      ///< Cached size of parent
+		std::mutex& parentLock;     ///< Held while reading from parent
+		stream::pos offRead;        ///< Current read position
+};
+
+Detector::Detector()
+	:	Detector(ArchiveManager::formats())
+{
+}
+
+Detector::Detector(std::vector<std::shared_ptr<const ArchiveType>> formats)
+{
+	unsigned int order = 0;
+	for (const auto& i : formats) {
+		auto sigs = i->signatures();
+		if (sigs.empty()) {
+			this->heuristic.push_back(i);
+		}
+		for (const auto& s : sigs) {
+			assert(!s.magic.empty());
+			assert(s.offset + s.magic.length() <= DETECT_WINDOW_LEN);
+			auto itTable = std::find_if(this->signatures.begin(),
+				this->signatures.end(), [&s](const SignatureTable& t) {
+					return t.offset == s.offset;
+				});
+			if (itTable == this->signatures.end()) {
+				this->signatures.emplace_back();
+				itTable = this->signatures.end() - 1;
+				itTable->offset = s.offset;
+			}
+			itTable->byFirstByte[(uint8_t)s.magic[0]].push_back({s.magic, order, i});
+		}
+		order++;
+	}
+}
+
+std::vector<DetectResult> Detector::detect(stream::input& content,
+	unsigned int numThreads) const
+{
+	std::vector<DetectResult> results;
+
+	// Grab the start of the file, unless it's already in memory.
+	std::string window;
+	const uint8_t *data;
+	stream::len lenData;
+	stream::len lenContent = content.size();
+	std::mutex contentLock;
+	auto view = dynamic_cast<const memory_view *>(&content);
+	if (view) {
+		data = view->data();
+		lenData = lenContent;
+	} else {
+		window.resize(std::min<stream::len>(lenContent, DETECT_WINDOW_LEN));
+		content.seekg(0, stream::start);
+		window.resize(content.try_read((uint8_t *)&window[0], window.length()));
+		data = (const uint8_t *)window.data();
+		lenData = window.length();
+	}
+
+	// Each format gets its own stream, so no format is affected by where the
+	// previous one left the read position, and formats can be checked from
+	// different threads at the same time.
+	auto probe = [&](const ArchiveType& type) {
+		try {
+			if (view) {
+				memory_view probe(data, lenData);
+				return type.isInstance(probe);
+			} else {
+				window_input probe(content, window, lenContent, contentLock);
+				return type.isInstance(probe);
+			}
+		} catch (const stream::error&) {
+			// Some formats read past the end of files that are too short to be
+			// in that format, which means it can't be that format.
+			return ArchiveType::Certainty::DefinitelyNo;
+		}
+	};
+
+	// Add a result to the list, and return true if no more formats should be
+	// checked.
+	auto addResult = [&results](const std::shared_ptr<const ArchiveType>& type,
+		ArchiveType::Certainty cert)
+	{
+		if (cert != ArchiveType::Certainty::DefinitelyNo) {
+			results.push_back({type, cert});
+		}
+		return cert == ArchiveType::Certainty::DefinitelyYes;
+	};
+
+	// Find all the formats whose signature is present.
+	std::vector<const SignatureEntry *> matches;
+	for (const auto& t : this->signatures) {
+		if (t.offset >= lenData) continue;
+		for (const auto& e : t.byFirstByte[data[t.offset]]) {
+			if (t.offset + e.magic.length() > lenData) continue;
+			if (memcmp(data + t.offset, e.magic.data(), e.magic.length()) != 0) {
+				continue;
+			}
+			// A format could have more than one matching signature
+			bool dupe = false;
+			for (const auto& m : matches) {
+				if (m->type == e.type) dupe = true;
+			}
+			if (!dupe) matches.push_back(&e);
+		}
+	}
+	std::sort(matches.begin(), matches.end(),
+		[](const SignatureEntry *a, const SignatureEntry *b) {
+			return a->order < b->order;
+		});
+
+	// There's rarely more than one of these, so they're not worth threading.
+	for (const auto& m : matches) {
+		if (addResult(m->type, probe(*m->type))) return results;
+	}
+
+	// No signature matched conclusively, so try everything else.
+	if (numThreads > this->heuristic.size()) {
+		numThreads = this->heuristic.size();
+	}
+	if (numThreads <= 1) {
+		for (const auto& i : this->heuristic) {
+			if (addResult(i, probe(*i))) break;
+		}
+	} else {
+		// Check every format, as we can't know in advance which one (if any) will
+		// be a definite match.  The results are then collected in the same order
+		// as the serial case, so the outcome is identical.
+		// Any other exception is kept with the format that threw it, and rethrown
+		// when the results reach that format, just as it would have propagated
+		// from the serial loop.
+		std::vector<ArchiveType::Certainty> certs(this->heuristic.size());
+		std::vector<std::exception_ptr> errors(this->heuristic.size());
+		std::atomic<std::size_t> next(0);
+		auto worker = [&]() {
+			for (;;) {
+				std::size_t j = next++;
+				if (j >= this->heuristic.size()) break;
+				try {
+					certs[j] = probe(*this->heuristic[j]);
+				} catch (...) {
+					errors[j] = std::current_exception();
+					// Formats after this one will never be reached
+					next = this->heuristic.size();
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads);
+		for (unsigned int t = 0; t < numThreads; t++) threads.emplace_back(worker);
+		for (auto& t : threads) t.join();
+
+		for (std::size_t j = 0; j < this->heuristic.size(); j++) {
+			if (errors[j]) std::rethrow_exception(errors[j]);
+			if (addResult(this->heuristic[j], certs[j])) break;
+		}
+	}
+
+	return results;
+}
+
+void Detector::rank(std::vector<DetectResult>& results)
+{
+	std::stable_sort(results.begin(), results.end(),
+		[](const DetectResult& a, const DetectResult& b) {
+			return a.certainty > b.certainty;
+		});
+	return;
+}
+
+} // namespace gamearchive
+} // namespace camoto
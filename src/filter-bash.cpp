@@ -21,17 +21,216 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <camoto/iostream_helpers.hpp>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
-#include <camoto/filter-lzw.hpp>
 
-#include "filter-bash-rle.hpp"
 #include "filter-bash.hpp"
 
 namespace camoto {
 namespace gamearchive {
 
+// Needed as this is passed by reference to std::vector::push_back()
+constexpr uint8_t filter_bash_decompress::BASH_RLE_TRIGGER;
+
+void filter_bash_decompress::reset(stream::len lenInput)
+{
+	this->lzw.reset();
+	this->strPos = 0;
+	this->strLen = 0;
+	this->prev = 0;
+	this->repeat = 0;
+	this->wantCount = false;
+	return;
+}
+
+void filter_bash_decompress::transform(uint8_t *out, stream::len *lenOut,
+	const uint8_t *in, stream::len *lenIn)
+{
+	stream::len r = 0, w = 0;
+
+	while (w < *lenOut) {
+		// Finish off any RLE repeat first
+		if (this->repeat) {
+			unsigned int n = std::min<stream::len>(this->repeat, *lenOut - w);
+			memset(out + w, this->prev, n);
+			w += n;
+			this->repeat -= n;
+			continue;
+		}
+
+		// Then run the rest of the last LZW string through the RLE decoder
+		if (this->strPos < this->strLen) {
+			if (this->wantCount) {
+				uint8_t count = this->str[this->strPos++];
+				this->wantCount = false;
+				if (count == 0) {
+					// Count of zero means a single 0x90 char
+					this->prev = BASH_RLE_TRIGGER;
+					out[w++] = BASH_RLE_TRIGGER;
+				} else {
+					// Byte already written before the 0x90 is included in count
+					this->repeat = count - 1;
+				}
+				continue;
+			}
+			// Copy everything up to the next RLE marker in one go
+			const uint8_t *start = this->str + this->strPos;
+			unsigned int n = std::min<stream::len>(this->strLen - this->strPos,
+				*lenOut - w);
+			auto marker = (const uint8_t *)memchr(start, BASH_RLE_TRIGGER, n);
+			if (marker) n = marker - start;
+			if (n) {
+				memcpy(out + w, start, n);
+				w += n;
+				this->strPos += n;
+				this->prev = start[n - 1];
+			}
+			if (marker) {
+				this->strPos++;
+				this->wantCount = true;
+			}
+			continue;
+		}
+
+		// Decode the next LZW string
+		int code = this->lzw.read(in, *lenIn, &r);
+		if (code < 0) break;
+		this->strLen = this->lzw.length(code);
+		this->lzw.expand(code, this->str);
+		this->strPos = 0;
+	}
+
+	if (
+		(*lenIn == 0) && (w == 0) && this->wantCount
+		&& (this->strPos == this->strLen)
+	) {
+		throw filter_error("Data ended on RLE code byte before giving a count!");
+	}
+
+	*lenIn = r;
+	*lenOut = w;
+	return;
+}
+
+
+void filter_bash_compress::reset(stream::len lenInput)
+{
+	this->bitBuffer = 0;
+	this->bitCount = 0;
+	this->codeBits = LZWParams_Bash::initialBits;
+	this->numCodes = 0;
+	this->prev = -1;
+	this->count = 0;
+	this->rle.clear();
+	this->posRLE = 0;
+	this->finished = false;
+	return;
+}
+
+void filter_bash_compress::transform(uint8_t *out, stream::len *lenOut,
+	const uint8_t *in, stream::len *lenIn)
+{
+	stream::len r = 0, w = 0;
+
+	for (;;) {
+		// Write out all the complete bytes
+		while ((this->bitCount >= 8) && (w < *lenOut)) {
+			out[w++] = this->bitBuffer & 0xFF;
+			this->bitBuffer >>= 8;
+			this->bitCount -= 8;
+		}
+		if (this->bitCount >= 8) break; // out of space
+
+		if (this->posRLE < this->rle.size()) {
+			this->putCode(this->rle[this->posRLE++]);
+			continue;
+		}
+		this->rle.clear();
+		this->posRLE = 0;
+
+		if (r < *lenIn) {
+			uint8_t b = in[r++];
+			if (b == this->prev) {
+				this->count++;
+			} else {
+				this->flushRun();
+				this->putByte(b);
+				this->prev = b;
+			}
+			continue;
+		}
+
+		if ((*lenIn == 0) && !this->finished) {
+			// End of the data
+			if (this->count) {
+				this->flushRun();
+				continue;
+			}
+			this->putCode(LZWParams_Bash::eofCode);
+			// Pad out the final byte with zero bits
+			this->bitCount = (this->bitCount + 7) & ~7;
+			this->finished = true;
+			continue;
+		}
+		break;
+	}
+
+	*lenIn = r;
+	*lenOut = w;
+	return;
+}
+
+void filter_bash_compress::putCode(unsigned int code)
+{
+	this->bitBuffer |= code << this->bitCount;
+	this->bitCount += this->codeBits;
+	this->numCodes++;
+
+	// The decompressor adds a dictionary entry for every codeword after the
+	// first, so it will next be expecting 256 + numCodes.  It widens the
+	// codewords once that no longer fits, so do the same here.
+	if (
+		(256 + this->numCodes == (1u << this->codeBits))
+		&& (this->codeBits < LZWParams_Bash::maxBits)
+	) {
+		this->codeBits++;
+	}
+	return;
+}
+
+void filter_bash_compress::putByte(uint8_t b)
+{
+	this->rle.push_back(b);
+	if (b == filter_bash_decompress::BASH_RLE_TRIGGER) {
+		// Zero RLE repeats escapes the control char
+		this->rle.push_back(0x00);
+	}
+	return;
+}
+
+void filter_bash_compress::flushRun()
+{
+	// Runs of three or more are worth an RLE event, with the count including
+	// the byte already written.  Anything up to 254 more repeats fits in one.
+	while (this->count > 2) {
+		this->rle.push_back(filter_bash_decompress::BASH_RLE_TRIGGER);
+		if (this->count > 254) {
+			this->rle.push_back(255);
+			this->count -= 254;
+		} else {
+			this->rle.push_back(this->count + 1);
+			this->count = 0;
+		}
+	}
+	// Shorter runs are just written out again
+	for (; this->count; this->count--) this->putByte(this->prev);
+	return;
+}
+
+
 FilterType_Bash::FilterType_Bash()
 {
 }
@@ -61,34 +260,10 @@ std::unique_ptr<stream::inout> FilterType_Bash::apply(
 	std::unique_ptr<stream::inout> target, stream::fn_notify_prefiltered_size resize)
 	const
 {
-	auto st1 = std::make_unique<stream::filtered>(
-		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			256, // EOF codeword is first codeword
-			256, // reset codeword is unused
-			LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset/EOF
-		),
-		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			256, // EOF codeword is first codeword
-			256, // reset codeword is shared with EOF
-			LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
-			LZW_EOF_PARAM_VALID  | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset
-		),
-		nullptr
-	);
-
 	return std::make_unique<stream::filtered>(
-		std::move(st1),
-		std::make_shared<filter_bash_unrle>(),
-		std::make_shared<filter_bash_rle>(),
+		std::move(target),
+		std::make_shared<filter_bash_decompress>(),
+		std::make_shared<filter_bash_compress>(),
 		resize
 	);
 }
@@ -96,22 +271,9 @@ std::unique_ptr<stream::inout> FilterType_Bash::apply(
 std::unique_ptr<stream::input> FilterType_Bash::apply(
 	std::unique_ptr<stream::input> target) const
 {
-	auto st1 = std::make_unique<stream::input_filtered>(
-		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			256, // EOF codeword is first codeword
-			256, // reset codeword is unused
-			LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset/EOF
-		)
-	);
-
 	return std::make_unique<stream::input_filtered>(
-		std::move(st1),
-		std::make_shared<filter_bash_unrle>()
+		std::move(target),
+		std::make_shared<filter_bash_decompress>()
 	);
 }
 
@@ -119,27 +281,19 @@ std::unique_ptr<stream::output> FilterType_Bash::apply(
 	std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 	const
 {
-	auto st1 = std::make_unique<stream::output_filtered>(
-		std::move(target),
-		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			256, // EOF codeword is first codeword
-			256, // reset codeword is shared with EOF
-			LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
-			LZW_EOF_PARAM_VALID  | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset
-		),
-		nullptr
-	);
-
 	return std::make_unique<stream::output_filtered>(
-		std::move(st1),
-		std::make_shared<filter_bash_rle>(),
+		std::move(target),
+		std::make_shared<filter_bash_compress>(),
 		resize
 	);
 }
 
+std::vector<FilterStage> FilterType_Bash::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_bash_decompress>()),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
@@ -21,11 +21,93 @@
 #ifndef _CAMOTO_FILTER_BASH_HPP_
 #define _CAMOTO_FILTER_BASH_HPP_
 
+#include <vector>
+#include <camoto/filter.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
+#include "filter-lzw-static.hpp"
 
 namespace camoto {
 namespace gamearchive {
 
+/// Monster Bash LZW settings.
+struct LZWParams_Bash
+{
+	static constexpr unsigned int initialBits = 9; ///< Starting codeword size
+	static constexpr unsigned int maxBits = 12;    ///< Largest codeword size
+	static constexpr unsigned int firstCode = 257; ///< First dictionary codeword
+	static constexpr int eofCode = 256;            ///< Written at the end
+	static constexpr int resetCode = 256;          ///< Clears the dictionary
+	static constexpr unsigned int flags =
+		LZW_LITTLE_ENDIAN    | // bits are split into bytes in little-endian order
+		LZW_RESET_PARAM_VALID  // Has codeword reserved for dictionary reset/EOF
+	;
+};
+
+/// Monster Bash decompressor, doing both the LZW and RLE stages at once.
+/**
+ * This produces the same output as filter_lzw_decompress followed by
+ * filter_bash_unrle, but each LZW string is run through the RLE decoder
+ * straight into the output buffer, so there is no second filter with its own
+ * buffer for the data to be copied through.
+ */
+class filter_bash_decompress: virtual public filter
+{
+	public:
+		constexpr static uint8_t BASH_RLE_TRIGGER = 0x90; ///< RLE marker byte
+
+		virtual void reset(stream::len lenInput);
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn);
+
+	protected:
+		lzw_static_decoder<LZWParams_Bash> lzw; ///< Codeword reader and dictionary
+
+		/// Most recently decoded LZW string.
+		uint8_t str[lzw_static_decoder<LZWParams_Bash>::DICT_SIZE];
+		unsigned int strPos;       ///< Next byte in str to run through RLE
+		unsigned int strLen;       ///< Length of string in str
+
+		uint8_t prev;              ///< Previous output byte, for RLE repeats
+		unsigned int repeat;       ///< How many more times to write prev
+		bool wantCount;            ///< Last byte was the RLE marker
+};
+
+/// Monster Bash compressor, doing both the RLE and LZW stages at once.
+/**
+ * This produces exactly the same output as filter_bash_rle followed by
+ * filter_lzw_compress.  Like that encoder, every RLE byte is written as its
+ * own LZW codeword, and the dictionary is only tracked so the codewords grow
+ * at the point the decompressor expects.
+ */
+class filter_bash_compress: virtual public filter
+{
+	public:
+		virtual void reset(stream::len lenInput);
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn);
+
+	protected:
+		uint32_t bitBuffer;        ///< Bits not yet written, LSB first
+		unsigned int bitCount;     ///< Number of bits in bitBuffer
+		unsigned int codeBits;     ///< Current codeword size
+		unsigned int numCodes;     ///< Codewords written so far
+
+		int prev;                  ///< Previous input byte, or -1 at the start
+		unsigned int count;        ///< Times prev has been repeated since
+		std::vector<uint8_t> rle;  ///< RLE bytes not yet written as codewords
+		std::size_t posRLE;        ///< Next byte in rle to write
+		bool finished;             ///< EOF codeword has been written
+
+		/// Write one byte as an LZW codeword.
+		void putCode(unsigned int code);
+
+		/// Add an RLE byte, escaping it if it's the RLE marker.
+		void putByte(uint8_t b);
+
+		/// Write out the repeats of prev counted so far.
+		void flushRun();
+};
+
 /// Monster Bash decompression filter.
 class FilterType_Bash: virtual public FilterType
 {
@@ -44,6 +126,7 @@ class FilterType_Bash: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
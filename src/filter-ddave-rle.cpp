@@ -304,5 +304,39 @@ std::unique_ptr<stream::output> FilterType_DDaveRLE::apply(
 	);
 }
 
+bool FilterType_DDaveRLE::decodeAll(const uint8_t *in, stream::len lenIn,
+	std::vector<uint8_t> *out) const
+{
+	// The decompressed size comes first, so the output can be sized exactly and
+	// decoded with a single call.  This is read and applied the same way
+	// filter_decomp_size_remove does, including padding with zeroes if the
+	// data runs out early.
+	stream::len lenTarget = 0;
+	if (lenIn >= 4) {
+		lenTarget = (uint32_t)in[0] | ((uint32_t)in[1] << 8)
+			| ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+	}
+	if (lenTarget == 0) {
+		out->clear();
+		return true;
+	}
+
+	// The size can't be trusted, and the most any pair of bytes can expand to
+	// is a repeat of 0x7F + 3 bytes.  Anything bigger is either corrupt or made
+	// up of padding, and is left to the stream to decode a bit at a time rather
+	// than allocating it all here.
+	if (lenTarget > (lenIn - 4) / 2 * (0x7F + 3) + (lenIn - 4) % 2) {
+		return false;
+	}
+	out->assign(lenTarget, 0);
+
+	filter_ddave_unrle unrle;
+	unrle.reset(lenIn - 4);
+	stream::len lenOut = lenTarget;
+	stream::len lenData = lenIn - 4;
+	unrle.transform(out->data(), &lenOut, in + 4, &lenData);
+	return true;
+}
+
 } // namespace gamearchive
 } // namespace camoto
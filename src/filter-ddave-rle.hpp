@@ -78,6 +78,8 @@ class FilterType_DDaveRLE: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual bool decodeAll(const uint8_t *in, stream::len lenIn,
+			std::vector<uint8_t> *out) const;
 };
 
 } // namespace gamearchive
@@ -71,27 +71,14 @@ std::unique_ptr<stream::inout> FilterType_EPFS::apply(
 {
 	return std::make_unique<stream::filtered>(
 		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			14,  // maximum codeword length (in bits)
-			256, // first valid codeword
-			0,   // EOF codeword is max codeword
-			-1,  // reset codeword is max-1
-			LZW_BIG_ENDIAN        | // bits are split into bytes in big-endian order
-			LZW_NO_BITSIZE_RESET  | // bitsize doesn't go back to 9 after dict reset
-			LZW_EOF_PARAM_VALID   | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID   // Has codeword reserved for dict reset
-		),
+		std::make_shared<filter_lzw_static_decompress<LZWParams_EPFS>>(),
 		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			14,  // maximum codeword length (in bits)
-			256, // first valid codeword
-			0,   // EOF codeword is max codeword
-			-1,  // reset codeword is max-1
-			LZW_BIG_ENDIAN        | // bits are split into bytes in big-endian order
-			LZW_NO_BITSIZE_RESET  | // bitsize doesn't go back to 9 after dict reset
-			LZW_EOF_PARAM_VALID   | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID   // Has codeword reserved for dict reset
+			LZWParams_EPFS::initialBits,
+			LZWParams_EPFS::maxBits,
+			LZWParams_EPFS::firstCode,
+			LZWParams_EPFS::eofCode,
+			LZWParams_EPFS::resetCode,
+			LZWParams_EPFS::flags
 		),
 		resize
 	);
@@ -102,17 +89,7 @@ std::unique_ptr<stream::input> FilterType_EPFS::apply(
 {
 	return std::make_unique<stream::input_filtered>(
 		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			14,  // maximum codeword length (in bits)
-			256, // first valid codeword
-			0,   // EOF codeword is max codeword
-			-1,  // reset codeword is max-1
-			LZW_BIG_ENDIAN        | // bits are split into bytes in big-endian order
-			LZW_NO_BITSIZE_RESET  | // bitsize doesn't go back to 9 after dict reset
-			LZW_EOF_PARAM_VALID   | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID   // Has codeword reserved for dict reset
-		)
+		this->decoders()[0].decoder
 	);
 }
 
@@ -123,19 +100,25 @@ std::unique_ptr<stream::output> FilterType_EPFS::apply(
 	return std::make_unique<stream::output_filtered>(
 		std::move(target),
 		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			14,  // maximum codeword length (in bits)
-			256, // first valid codeword
-			0,   // EOF codeword is max codeword
-			-1,  // reset codeword is max-1
-			LZW_BIG_ENDIAN        | // bits are split into bytes in big-endian order
-			LZW_NO_BITSIZE_RESET  | // bitsize doesn't go back to 9 after dict reset
-			LZW_EOF_PARAM_VALID   | // Has codeword reserved for EOF
-			LZW_RESET_PARAM_VALID   // Has codeword reserved for dict reset
+			LZWParams_EPFS::initialBits,
+			LZWParams_EPFS::maxBits,
+			LZWParams_EPFS::firstCode,
+			LZWParams_EPFS::eofCode,
+			LZWParams_EPFS::resetCode,
+			LZWParams_EPFS::flags
 		),
 		resize
 	);
 }
 
+std::vector<FilterStage> FilterType_EPFS::decoders() const
+{
+	return {
+		FilterStage::of(
+			std::make_shared<filter_lzw_static_decompress<LZWParams_EPFS>>()
+		),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
@@ -22,10 +22,27 @@
 #define _CAMOTO_FILTER_EPFS_HPP_
 
 #include <camoto/gamearchive/filtertype.hpp>
+#include "filter-lzw-static.hpp"
 
 namespace camoto {
 namespace gamearchive {
 
+/// EPFS LZW settings.
+struct LZWParams_EPFS
+{
+	static constexpr unsigned int initialBits = 9; ///< Starting codeword size
+	static constexpr unsigned int maxBits = 14;    ///< Largest codeword size
+	static constexpr unsigned int firstCode = 256; ///< First dictionary codeword
+	static constexpr int eofCode = 0;              ///< EOF codeword is max codeword
+	static constexpr int resetCode = -1;           ///< Reset codeword is max-1
+	static constexpr unsigned int flags =
+		LZW_BIG_ENDIAN        | // bits are split into bytes in big-endian order
+		LZW_NO_BITSIZE_RESET  | // bitsize doesn't go back to 9 after dict reset
+		LZW_EOF_PARAM_VALID   | // Has codeword reserved for EOF
+		LZW_RESET_PARAM_VALID   // Has codeword reserved for dict reset
+	;
+};
+
 /// EPFS decompression filter.
 class FilterType_EPFS: virtual public FilterType
 {
@@ -44,6 +61,7 @@ class FilterType_EPFS: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
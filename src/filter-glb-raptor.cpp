@@ -21,6 +21,12 @@
 #include <algorithm>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GLB_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 #include "filter-glb-raptor.hpp"
 
 namespace camoto {
@@ -32,6 +38,72 @@ namespace gamearchive {
 /// Length of each cipher block in the .GLB FAT
 #define GLB_BLOCKLEN 28
 
+/// Decrypt a run of bytes using a precalculated key tile.
+/**
+ * in[-1] must be the encrypted byte preceding the run.
+ */
+typedef void (*fn_glb_block)(uint8_t *out, const uint8_t *in,
+	const uint8_t *key, const uint8_t *mask, std::size_t len);
+
+static void glb_block_scalar(uint8_t *out, const uint8_t *in,
+	const uint8_t *key, const uint8_t *mask, std::size_t len)
+{
+	for (std::size_t i = 0; i < len; i++) {
+		out[i] = in[i] - key[i] - (in[i - 1] & mask[i]);
+	}
+	return;
+}
+
+#ifdef GLB_X86_DISPATCH
+__attribute__((target("sse2")))
+static void glb_block_sse2(uint8_t *out, const uint8_t *in,
+	const uint8_t *key, const uint8_t *mask, std::size_t len)
+{
+	std::size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i cur = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i prev = _mm_loadu_si128((const __m128i *)(in + i - 1));
+		__m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+		__m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+		__m128i r = _mm_sub_epi8(_mm_sub_epi8(cur, k), _mm_and_si128(prev, m));
+		_mm_storeu_si128((__m128i *)(out + i), r);
+	}
+	glb_block_scalar(out + i, in + i, key + i, mask + i, len - i);
+	return;
+}
+
+__attribute__((target("avx2")))
+static void glb_block_avx2(uint8_t *out, const uint8_t *in,
+	const uint8_t *key, const uint8_t *mask, std::size_t len)
+{
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i prev = _mm256_loadu_si256((const __m256i *)(in + i - 1));
+		__m256i k = _mm256_loadu_si256((const __m256i *)(key + i));
+		__m256i m = _mm256_loadu_si256((const __m256i *)(mask + i));
+		__m256i r = _mm256_sub_epi8(_mm256_sub_epi8(cur, k),
+			_mm256_and_si256(prev, m));
+		_mm256_storeu_si256((__m256i *)(out + i), r);
+	}
+	glb_block_scalar(out + i, in + i, key + i, mask + i, len - i);
+	return;
+}
+#endif
+
+/// Pick the fastest decryption kernel this CPU can run.
+static fn_glb_block chooseGlbBlock()
+{
+#ifdef GLB_X86_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return glb_block_avx2;
+	if (__builtin_cpu_supports("sse2")) return glb_block_sse2;
+#endif
+	return glb_block_scalar;
+}
+
+static const fn_glb_block glbBlock = chooseGlbBlock();
+
 filter_glb_decrypt::filter_glb_decrypt(const std::string& key, int lenBlock)
 	:	lenBlock(lenBlock),
 		key(key),
@@ -41,6 +113,30 @@ filter_glb_decrypt::filter_glb_decrypt(const std::string& key, int lenBlock)
 		// lastByte in reset()
 {
 	this->reset(0);
+
+	// Work out what gets subtracted from each byte.  With blocks, the key
+	// restarts at each one and the first byte in the block has the initial key
+	// byte subtracted instead of the previous byte.  Without blocks the pattern
+	// just follows the key.
+	this->lenPeriod = this->lenBlock ? this->lenBlock : this->lenKey;
+	int posKeyStart = 25 % this->lenKey;
+	this->tileKey.resize(this->lenPeriod + GLB_TILE_RUN);
+	this->tileMask.resize(this->lenPeriod + GLB_TILE_RUN);
+	for (unsigned int i = 0; i < this->tileKey.size(); i++) {
+		unsigned int p = i % this->lenPeriod;
+		if (this->lenBlock) {
+			this->tileKey[i] = this->key[(posKeyStart + p) % this->lenKey];
+			if (p == 0) {
+				this->tileKey[i] += this->key[posKeyStart];
+				this->tileMask[i] = 0x00;
+			} else {
+				this->tileMask[i] = 0xFF;
+			}
+		} else {
+			this->tileKey[i] = this->key[p];
+			this->tileMask[i] = 0xFF;
+		}
+	}
 }
 
 filter_glb_decrypt::~filter_glb_decrypt()
@@ -54,30 +150,65 @@ void filter_glb_decrypt::reset(stream::len lenInput)
 	return;
 }
 
+void filter_glb_decrypt::decryptByte(uint8_t *out, uint8_t in)
+{
+	// Reset the cipher if the block length has been reached
+	if (this->lenBlock != 0) {
+		if ((this->offset % this->lenBlock) == 0) {
+			this->reset(0);
+		}
+	}
+
+	*out = (in - this->key[this->posKey] - this->lastByte) & 0xFF;
+	this->posKey++;
+	this->posKey %= this->lenKey;
+	this->lastByte = in;
+	this->offset++;
+	return;
+}
+
 void filter_glb_decrypt::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
-	stream::len lenRemaining = std::min(*lenIn, *lenOut);
-	*lenIn = 0;
-	*lenOut = 0;
-	while (lenRemaining--) {
-		// Reset the cipher if the block length has been reached
-		if (this->lenBlock != 0) {
-			if ((this->offset % this->lenBlock) == 0) {
-				this->reset(0);
-			}
-		}
+	stream::len lenTotal = std::min(*lenIn, *lenOut);
+	stream::len i = 0;
+
+	// The first byte depends on the last one from the previous call, so it has
+	// to be done on its own.  The key tile can also only be used once the key
+	// is in step with the blocks, which will only not be the case if reset()
+	// was called part way through a block.
+	auto inStep = [this]() {
+		if (this->lenBlock == 0) return true;
+		unsigned int p = this->offset % this->lenBlock;
+		return (p == 0) || (this->posKey == (int)((25 + p) % this->lenKey));
+	};
+	while ((i < lenTotal) && ((i == 0) || !inStep())) {
+		this->decryptByte(&out[i], in[i]);
+		i++;
+	}
 
-		*out = (*in - this->key[this->posKey] - this->lastByte) & 0xFF;
-		this->posKey++;
-		this->posKey %= this->lenKey;
-		this->lastByte = *in;
-		out++;
-		in++;
-		(*lenIn)++;
-		(*lenOut)++;
-		this->offset++;
+	if (i < lenTotal) {
+		stream::len lenRun = lenTotal - i;
+		unsigned int phase = this->lenBlock
+			? this->offset % this->lenBlock : this->posKey;
+		while (i < lenTotal) {
+			unsigned int len = std::min<stream::len>(GLB_TILE_RUN, lenTotal - i);
+			glbBlock(&out[i], &in[i], &this->tileKey[phase], &this->tileMask[phase],
+				len);
+			i += len;
+			phase = (phase + len) % this->lenPeriod;
+		}
+		this->offset += lenRun;
+		this->lastByte = in[lenTotal - 1];
+		if (this->lenBlock) {
+			this->posKey = (25 + this->offset % this->lenBlock) % this->lenKey;
+		} else {
+			this->posKey = (this->posKey + lenRun) % this->lenKey;
+		}
 	}
+
+	*lenIn = lenTotal;
+	*lenOut = lenTotal;
 	return;
 }
 
@@ -21,14 +21,26 @@
 #ifndef _CAMOTO_FILTER_GLB_RAPTOR_HPP_
 #define _CAMOTO_FILTER_GLB_RAPTOR_HPP_
 
+#include <vector>
 #include <camoto/gamearchive/filtertype.hpp>
 
 namespace camoto {
 namespace gamearchive {
 
 /// Raptor .GLB decryption algorithm.
+/**
+ * Each byte is decrypted by subtracting a key byte and the previous encrypted
+ * byte, so unlike encryption every byte can be worked out independently.
+ * What is subtracted follows a pattern that repeats with the key, or with
+ * each block if the key is reset part way through, so this is precalculated
+ * and the data is then decrypted with vector instructions where available.
+ */
 class filter_glb_decrypt: virtual public filter
 {
+	public:
+		/// Most bytes to decrypt with one pass over the key tile.
+		constexpr static int GLB_TILE_RUN = 1024;
+
 	protected:
 		int lenBlock;       ///< Length of each encryption block, 0 for unlimited
 		std::string key;    ///< Encryption key
@@ -37,6 +49,21 @@ class filter_glb_decrypt: virtual public filter
 		stream::len offset; ///< Current offset (number of bytes processed)
 		uint8_t lastByte;   ///< Previous byte read
 
+		/// Number of bytes before tileKey and tileMask repeat.
+		unsigned int lenPeriod;
+
+		/// Key byte to subtract at each point in the period, repeated so
+		/// GLB_TILE_RUN bytes can be read from any starting point.
+		std::vector<uint8_t> tileKey;
+
+		/// 0xFF where the previous byte is subtracted, 0x00 where a block starts
+		/// and the initial key byte (already included in tileKey) is used
+		/// instead.
+		std::vector<uint8_t> tileMask;
+
+		/// Decrypt a single byte, one at a time the way the game does.
+		void decryptByte(uint8_t *out, uint8_t in);
+
 	public:
 		/// Create a new encryption filter with the given options.
 		/**
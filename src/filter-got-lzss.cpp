@@ -18,7 +18,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cassert>
+#include <algorithm>
+#include <cstring>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
 #include "filter-got-lzss.hpp"
@@ -27,8 +28,8 @@ namespace camoto {
 namespace gamearchive {
 
 #define ADD_DICT(c) \
-	this->dictionary[this->dictPos] = c; \
-	this->dictPos = (this->dictPos + 1) % GOT_DICT_SIZE;
+	this->reserveHistory(1); \
+	this->history[this->histPos++] = c;
 
 void filter_got_unlzss::reset(stream::len lenInput)
 {
@@ -36,13 +37,58 @@ void filter_got_unlzss::reset(stream::len lenInput)
 	this->blocksLeft = 0;
 	this->state = S0_READ_LEN;
 	this->lzssLength = 0;
-	memset(this->dictionary, 0, sizeof(uint8_t) * GOT_DICT_SIZE);
-	this->dictPos = 0;
+	// Anything referenced before the start of the data reads back as zero
+	memset(this->history, 0, sizeof(uint8_t) * GOT_DICT_SIZE);
+	this->histPos = GOT_DICT_SIZE;
 	this->lenDecomp = 0;
 	this->numDecomp = 0;
 	return;
 }
 
+void filter_got_unlzss::reserveHistory(unsigned int len)
+{
+	if (this->histPos + len > GOT_HIST_SIZE) {
+		memmove(this->history, this->history + this->histPos - GOT_DICT_SIZE,
+			GOT_DICT_SIZE);
+		this->histPos = GOT_DICT_SIZE;
+	}
+	return;
+}
+
+unsigned int filter_got_unlzss::decodeGroup(uint8_t *out, const uint8_t *&in)
+{
+	this->reserveHistory(GOT_MAX_GROUP_OUT);
+	uint8_t *start = this->history + this->histPos;
+	uint8_t *dst = start;
+
+	unsigned int flags = *in++;
+	for (int i = 0; i < 8; i++) {
+		if (flags & 1) {
+			*dst++ = *in++;
+		} else {
+			unsigned int code = in[0] | (in[1] << 8);
+			in += 2;
+			unsigned int len = (code >> 12) + 2;
+			unsigned int dist = code & 0x0FFF;
+			if (dist == 0) dist = GOT_DICT_SIZE;
+			const uint8_t *src = dst - dist;
+			if (dist >= len) {
+				memcpy(dst, src, len);
+				dst += len;
+			} else {
+				// Overlapping copy repeats the last dist bytes
+				for (unsigned int j = 0; j < len; j++) *dst++ = *src++;
+			}
+		}
+		flags >>= 1;
+	}
+
+	unsigned int lenGroup = dst - start;
+	memcpy(out, start, lenGroup);
+	this->histPos += lenGroup;
+	return lenGroup;
+}
+
 void filter_got_unlzss::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
@@ -60,6 +106,25 @@ void filter_got_unlzss::transform(uint8_t *out, stream::len *lenOut,
 			(this->numDecomp < this->lenDecomp) // we have read it, and there's more data to decompress
 		)
 	) {
+		// Decode whole flag groups at once while there's plenty of input, output
+		// space and remaining data, so the state machine below is only needed
+		// near the edges of the buffers and the end of the data.
+		if (
+			(this->state == S1_READ_FLAGS)
+			&& (this->blocksLeft == 0)
+			&& (*lenIn - r >= GOT_MAX_GROUP_IN)
+			&& (*lenOut - w >= GOT_MAX_GROUP_OUT)
+			&& (this->numDecomp + GOT_MAX_GROUP_OUT <= this->lenDecomp)
+		) {
+			const uint8_t *inStart = in;
+			unsigned int lenGroup = this->decodeGroup(out, in);
+			r += in - inStart;
+			out += lenGroup;
+			w += lenGroup;
+			this->numDecomp += lenGroup;
+			continue;
+		}
+
 		bool needMoreData = false;
 
 		switch (this->state) {
@@ -112,7 +177,9 @@ void filter_got_unlzss::transform(uint8_t *out, stream::len *lenOut,
 				code |= *in++ << 8;
 				r += 2;
 				this->lzssLength = (code >> 12) + 2;
-				this->lzssDictPos = (GOT_DICT_SIZE + this->dictPos - (code & 0x0FFF)) % GOT_DICT_SIZE;
+				this->lzssDist = code & 0x0FFF;
+				// An offset of zero refers to the oldest byte in the dictionary
+				if (this->lzssDist == 0) this->lzssDist = GOT_DICT_SIZE;
 				this->state = S4_COPY_OFFSET;
 				break;
 			}
@@ -124,12 +191,11 @@ void filter_got_unlzss::transform(uint8_t *out, stream::len *lenOut,
 					break;
 				}
 
-				*out = this->dictionary[this->lzssDictPos++];
+				*out = this->history[this->histPos - this->lzssDist];
 				ADD_DICT(*out);
 				out++;
 				w++;
 				this->numDecomp++;
-				this->lzssDictPos %= GOT_DICT_SIZE;
 				this->lzssLength--;
 				break;
 
@@ -147,9 +213,11 @@ void filter_got_lzss::reset(stream::len lenInput)
 {
 	if (lenInput > 65535) throw stream::error(
 		"God of Thunder compression only supports files less than 64kB in size.");
-	this->lenInput = lenInput;
-	this->count = 0;
-	this->state = S0_START;
+	this->input.clear();
+	this->input.reserve(lenInput);
+	this->encoded.clear();
+	this->posEncoded = 0;
+	this->state = S0_READ;
 	return;
 }
 
@@ -158,41 +226,146 @@ void filter_got_lzss::transform(uint8_t *out, stream::len *lenOut,
 {
 	stream::len r = 0, w = 0;
 
-	while (              // while there is...
-		(w < *lenOut)      // more space to write into, and
-		&& (r < *lenIn)    // more data to read, or
-	) {
-		switch (this->state) {
+	if (this->state == S0_READ) {
+		if (*lenIn) {
+			if (this->input.size() + *lenIn > 65535) throw stream::error(
+				"God of Thunder compression only supports files less than 64kB in "
+				"size.");
+			this->input.insert(this->input.end(), in, in + *lenIn);
+			r = *lenIn;
+		} else {
+			// End of the input, so we can compress it now
+			this->compress();
+			this->state = S1_WRITE;
+		}
+	}
 
-			case S0_START:
-				assert(*lenOut > 4);
-				*out++ = this->lenInput & 0xFF;
-				*out++ = (this->lenInput >> 8) & 0xFF;
-				*out++ = 0x01;
-				*out++ = 0x00;
-				w += 4;
-				this->state = S1_CODE;
-				break;
+	if (this->state == S1_WRITE) {
+		w = std::min<stream::len>(*lenOut,
+			this->encoded.size() - this->posEncoded);
+		memcpy(out, this->encoded.data() + this->posEncoded, w);
+		this->posEncoded += w;
+	}
 
-			case S1_CODE:
-				*out++ = 0xFF;
-				w++;
-				this->state = S2_DATA;
-				this->count = 8;
-				break;
+	*lenIn = r;
+	*lenOut = w;
+	return;
+}
 
-			case S2_DATA:
-				*out++ = *in++;
-				r++;
-				w++;
-				this->count--;
-				if (this->count == 0) this->state = S1_CODE;
-				break;
+void filter_got_lzss::compress()
+{
+	const uint8_t *data = this->input.data();
+	int lenData = this->input.size();
+
+	this->encoded.clear();
+	this->encoded.reserve(4 + lenData + (lenData + 7) / 8);
+	this->encoded.push_back(lenData & 0xFF);
+	this->encoded.push_back((lenData >> 8) & 0xFF);
+	this->encoded.push_back(0x01);
+	this->encoded.push_back(0x00);
+
+	// Most recent position of each two-byte sequence, and for each position the
+	// previous one with the same two bytes.
+	std::vector<int> head(65536, -1);
+	std::vector<int> prev(lenData);
+
+	auto insert = [&](int pos) {
+		if (pos + GOT_MIN_MATCH > lenData) return;
+		unsigned int key = data[pos] | (data[pos + 1] << 8);
+		prev[pos] = head[key];
+		head[key] = pos;
+	};
+
+	struct Match {
+		int len;
+		int dist;
+	};
+	auto find = [&](int pos) {
+		Match best = {0, 0};
+		if (pos + GOT_MIN_MATCH > lenData) return best;
+		int maxLen = std::min(GOT_MAX_MATCH, lenData - pos);
+		unsigned int key = data[pos] | (data[pos + 1] << 8);
+		int chain = GOT_MAX_CHAIN;
+		for (
+			int cand = head[key];
+			(cand >= 0) && (pos - cand <= GOT_MAX_DIST) && chain;
+			cand = prev[cand], chain--
+		) {
+			// Can't beat the current best unless the byte after it matches too
+			if (
+				(best.len >= GOT_MIN_MATCH)
+				&& (data[cand + best.len] != data[pos + best.len])
+			) {
+				continue;
+			}
+			// The first two bytes always match, as they're the hash key
+			int len = GOT_MIN_MATCH;
+			while ((len < maxLen) && (data[cand + len] == data[pos + len])) len++;
+			if (len > best.len) {
+				best.len = len;
+				best.dist = pos - cand;
+				if (len == maxLen) break;
+			}
+		}
+		return best;
+	};
+
+	// Blocks are written in groups of eight, after a byte of flags that says
+	// which ones are literals.
+	std::size_t posFlags = 0;
+	unsigned int numFlags = 8;
+	auto startBlock = [&]() {
+		if (numFlags == 8) {
+			posFlags = this->encoded.size();
+			this->encoded.push_back(0x00);
+			numFlags = 0;
+		}
+		numFlags++;
+	};
+	auto literal = [&](int pos) {
+		startBlock();
+		this->encoded[posFlags] |= 1 << (numFlags - 1);
+		this->encoded.push_back(data[pos]);
+	};
+	auto backref = [&](const Match& m) {
+		startBlock();
+		unsigned int code = ((m.len - GOT_MIN_MATCH) << 12) | m.dist;
+		this->encoded.push_back(code & 0xFF);
+		this->encoded.push_back(code >> 8);
+	};
+
+	int pos = 0;
+	while (pos < lenData) {
+		Match cur = find(pos);
+		insert(pos);
+
+		// If the next byte starts a longer match, write this one as a literal
+		// and use that instead.
+		while ((cur.len >= GOT_MIN_MATCH) && (cur.len < GOT_MAX_MATCH)) {
+			Match next = find(pos + 1);
+			if (next.len <= cur.len) break;
+			literal(pos);
+			pos++;
+			insert(pos);
+			cur = next;
+		}
+
+		if (cur.len >= GOT_MIN_MATCH) {
+			backref(cur);
+			for (int i = 1; i < cur.len; i++) insert(pos + i);
+			pos += cur.len;
+		} else {
+			literal(pos);
+			pos++;
 		}
 	}
 
-	*lenIn = r;
-	*lenOut = w;
+	// Mark any unused blocks in the last group as literals, as the original
+	// compressor did.  They're never read as the data ends first.
+	if (numFlags < 8) this->encoded[posFlags] |= 0xFF << numFlags;
+
+	this->input.clear();
+	this->input.shrink_to_fit();
 	return;
 }
 
@@ -254,6 +427,12 @@ std::unique_ptr<stream::output> FilterType_DAT_GOT::apply(
 	);
 }
 
+std::vector<FilterStage> FilterType_DAT_GOT::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_got_unlzss>()),
+	};
+}
 
 } // namespace gamearchive
 } // namespace camoto
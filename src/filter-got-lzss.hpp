@@ -22,6 +22,7 @@
 #define _CAMOTO_FILTER_GOT_LZSS_HPP_
 
 #include <memory>
+#include <vector>
 #include <camoto/filter.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
 
@@ -33,6 +34,21 @@ class filter_got_unlzss: virtual public filter
 	public:
 		constexpr static int GOT_DICT_SIZE = 4096;
 
+		/// Size of the history buffer.
+		/**
+		 * The last GOT_DICT_SIZE bytes of output are kept in a linear buffer, so
+		 * back-references never wrap around.  When the end of the buffer is
+		 * reached, the most recent GOT_DICT_SIZE bytes are moved back to the
+		 * start.
+		 */
+		constexpr static int GOT_HIST_SIZE = GOT_DICT_SIZE * 4;
+
+		/// Most input one flag byte and its eight blocks can use.
+		constexpr static int GOT_MAX_GROUP_IN = 1 + 8 * 2;
+
+		/// Most output one flag byte and its eight blocks can produce.
+		constexpr static int GOT_MAX_GROUP_OUT = 8 * 17;
+
 		virtual void reset(stream::len lenInput);
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn);
@@ -40,10 +56,10 @@ class filter_got_unlzss: virtual public filter
 	protected:
 		uint8_t flags; ///< Flags for next eight blocks
 		unsigned int blocksLeft; ///< Number of blocks left
-		unsigned int lzssDictPos;
+		unsigned int lzssDist; ///< How far back to copy data from
 		unsigned int lzssLength;
-		uint8_t dictionary[GOT_DICT_SIZE];
-		unsigned int dictPos;
+		uint8_t history[GOT_HIST_SIZE]; ///< Previous output
+		unsigned int histPos; ///< Where the next output byte goes in history
 		unsigned int lenDecomp; ///< Target output size
 		unsigned int numDecomp; ///< Current output size
 		enum {
@@ -53,24 +69,64 @@ class filter_got_unlzss: virtual public filter
 			S3_GET_OFFSET,   ///< Read the LZSS offset/length data
 			S4_COPY_OFFSET,  ///< Copy data from the dictionary
 		} state;
+
+		/// Make sure there's room for len more bytes in history.
+		void reserveHistory(unsigned int len);
+
+		/// Decode a flag byte and all eight of its blocks in one go.
+		/**
+		 * @pre There must be at least GOT_MAX_GROUP_IN bytes available at in,
+		 *   room for GOT_MAX_GROUP_OUT bytes at out, and at least
+		 *   GOT_MAX_GROUP_OUT bytes still to decompress.
+		 *
+		 * @return Number of bytes written to out.  in is advanced past the data
+		 *   read.
+		 */
+		unsigned int decodeGroup(uint8_t *out, const uint8_t *&in);
 };
 
+/// God of Thunder LZSS compressor.
+/**
+ * The whole file is buffered (it can't be larger than 64kB anyway) and
+ * compressed once the end of the input is reached.  Matches are found with
+ * hash chains keyed on the next two bytes, with one step of lazy matching so a
+ * short match doesn't hide a longer one starting at the following byte.
+ */
 class filter_got_lzss: virtual public filter
 {
 	public:
+		/// Largest distance a back-reference can reach.
+		/**
+		 * The format allows 4096 (stored as zero) but it's not clear whether
+		 * the game handles that, so it's never used.
+		 */
+		constexpr static int GOT_MAX_DIST = 4095;
+
+		/// Shortest back-reference.
+		constexpr static int GOT_MIN_MATCH = 2;
+
+		/// Longest back-reference.
+		constexpr static int GOT_MAX_MATCH = 17;
+
+		/// Most earlier positions to try when looking for a match.
+		constexpr static int GOT_MAX_CHAIN = 256;
+
 		virtual void reset(stream::len lenInput);
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn);
 
 	protected:
-		unsigned int lenInput; ///< Decompressed size
-		int count; ///< Number of bytes written
+		std::vector<uint8_t> input;   ///< Uncompressed data received so far
+		std::vector<uint8_t> encoded; ///< Compressed data, including header
+		std::size_t posEncoded;       ///< Amount of encoded already returned
 		/// Current state
 		enum {
-			S0_START,  ///< Write header
-			S1_CODE,   ///< LZSS code for next eight blocks
-			S2_DATA,   ///< Write data
+			S0_READ,   ///< Collecting input data
+			S1_WRITE,  ///< Returning compressed data
 		} state;
+
+		/// Compress input into encoded.
+		void compress();
 };
 
 /// God of Thunder decompression filter.
@@ -91,6 +147,7 @@ class FilterType_DAT_GOT: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
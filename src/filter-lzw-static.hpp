@@ -0,0 +1,360 @@
+/**
+ * @file  filter-lzw-static.hpp
+ * @brief LZW decompressor with its settings fixed at compile time.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_FILTER_LZW_STATIC_HPP_
+#define _CAMOTO_FILTER_LZW_STATIC_HPP_
+
+#include <algorithm>
+#include <cstring>
+#include <camoto/filter.hpp>
+#include <camoto/filter-lzw.hpp> // LZW_* flags
+#include <camoto/util.hpp> // createString
+
+namespace camoto {
+namespace gamearchive {
+
+/// LZW codeword reader and dictionary, with its settings fixed at compile time.
+/**
+ * This understands the same settings as filter_lzw_decompress, but they are
+ * taken from Params instead of being passed to the constructor, so there are
+ * no flags to check for each codeword.  Params must have these static
+ * constexpr members:
+ *
+ *  - initialBits: codeword size at the start
+ *  - maxBits: largest codeword size
+ *  - firstCode: first dictionary codeword
+ *  - eofCode: codeword marking the end of the data, if LZW_EOF_PARAM_VALID
+ *  - resetCode: codeword to clear the dictionary, if LZW_RESET_PARAM_VALID
+ *  - flags: LZW_* flags, as for filter_lzw_decompress
+ *
+ * eofCode and resetCode may be zero or negative, in which case they are
+ * relative to the largest codeword at the current size, e.g. -1 is 510 with
+ * 9-bit codewords and 1022 with 10-bit ones.  The dictionary grows into the
+ * next codeword size just before it would reach one of these codewords.
+ *
+ * This only reads codewords and keeps track of the dictionary, so it can be
+ * shared by filters that do different things with the decoded strings.
+ */
+template <class Params>
+class lzw_static_decoder
+{
+	public:
+		/// Number of codewords at the largest codeword size.
+		static constexpr unsigned int DICT_SIZE = 1u << Params::maxBits;
+
+		/// read() result when there isn't enough input for a whole codeword.
+		static constexpr int NEED_INPUT = -1;
+
+		/// read() result once the EOF codeword has been reached.
+		static constexpr int END = -2;
+
+		static_assert(Params::maxBits <= 16, "Codewords must fit in 16 bits");
+		static_assert(Params::initialBits <= Params::maxBits,
+			"Initial codeword size is larger than the maximum");
+		static_assert(Params::firstCode >= 256,
+			"Dictionary codewords overlap the single-byte ones");
+
+		/// Start decoding a new stream.
+		void reset()
+		{
+			this->bitBuffer = 0;
+			this->bitCount = 0;
+			this->bitsRead = 0;
+			this->skipBits = 0;
+			this->finished = false;
+			for (unsigned int i = 0; i < 256; i++) {
+				this->prefix[i] = 0;
+				this->len[i] = 1;
+				this->suffix[i] = i;
+				this->head[i] = i;
+			}
+			this->setBits(Params::initialBits);
+			this->resetDict();
+			return;
+		}
+
+		/// Read codewords until one gives a string.
+		/**
+		 * Reset codewords are handled here, and never returned.
+		 *
+		 * @param in
+		 *   Input data.
+		 *
+		 * @param lenIn
+		 *   Length of in.
+		 *
+		 * @param r
+		 *   Number of bytes in in that have already been used.  On return, this
+		 *   includes any more that were used.
+		 *
+		 * @return The codeword, whose string can then be written out with
+		 *   expand(), or NEED_INPUT or END.
+		 *
+		 * @throw filter_error
+		 *   The codeword is not in the dictionary.
+		 */
+		int read(const uint8_t *in, stream::len lenIn, stream::len *r)
+		{
+			for (;;) {
+				if (this->finished) {
+					// Ignore any padding after the EOF codeword
+					*r = lenIn;
+					return END;
+				}
+
+				// Skip any padding left after a reset codeword
+				while (this->skipBits) {
+					if (this->bitCount == 0) {
+						if (*r >= lenIn) return NEED_INPUT;
+						this->addByte(in[(*r)++]);
+					}
+					unsigned int n = std::min(this->skipBits, this->bitCount);
+					this->dropBits(n);
+					this->skipBits -= n;
+				}
+
+				while ((this->bitCount <= 24) && (*r < lenIn)) {
+					this->addByte(in[(*r)++]);
+				}
+				if (this->bitCount < this->codeBits) return NEED_INPUT;
+
+				unsigned int code;
+				if (Params::flags & LZW_BIG_ENDIAN) {
+					code = (this->bitBuffer >> (this->bitCount - this->codeBits))
+						& ((1u << this->codeBits) - 1);
+				} else {
+					code = this->bitBuffer & ((1u << this->codeBits) - 1);
+				}
+				this->dropBits(this->codeBits);
+				this->bitsRead += this->codeBits;
+
+				if (
+					(Params::flags & LZW_EOF_PARAM_VALID)
+					&& (code == this->special(Params::eofCode))
+				) {
+					this->finished = true;
+					continue;
+				}
+				if (
+					(Params::flags & LZW_RESET_PARAM_VALID)
+					&& (code == this->special(Params::resetCode))
+				) {
+					this->resetDict();
+					if (Params::flags & LZW_FLUSH_ON_RESET) {
+						// Next codeword starts on a 16-bit boundary
+						this->skipBits = (16 - this->bitsRead % 16) % 16;
+						this->bitsRead += this->skipBits;
+					}
+					continue;
+				}
+
+				if (
+					((code >= 256) && (code < Params::firstCode))
+					|| (code > this->nextCode)
+					|| ((code == this->nextCode)
+						&& ((this->prevCode < 0) || (this->nextCode >= this->limit)))
+				) {
+					throw filter_error(createString("Invalid LZW codeword " << code
+						<< " (next free code is " << this->nextCode << ")"));
+				}
+
+				// Add the previous string plus the first byte of this one to the
+				// dictionary.  This has to come first in case this code is the one
+				// being added.
+				if ((this->prevCode >= 0) && (this->nextCode < this->limit)) {
+					unsigned int c = this->nextCode;
+					this->prefix[c] = this->prevCode;
+					this->len[c] = this->len[this->prevCode] + 1;
+					this->head[c] = this->head[this->prevCode];
+					this->suffix[c] = this->head[(code == c) ? this->prevCode : code];
+					this->nextCode++;
+					if (this->nextCode == this->limit) {
+						if (this->codeBits < Params::maxBits) {
+							this->setBits(this->codeBits + 1);
+						} else if (Params::flags & LZW_RESET_FULL_DICT) {
+							// Leaves the entries alone, so this code can still be expanded
+							this->resetDict();
+							return code;
+						}
+					}
+				}
+				this->prevCode = code;
+				return code;
+			}
+		}
+
+		/// Get the length of a codeword's string.
+		unsigned int length(unsigned int code) const
+		{
+			return this->len[code];
+		}
+
+		/// Write out a codeword's string.
+		/**
+		 * @param dest
+		 *   Buffer with space for at least length(code) bytes.
+		 */
+		void expand(unsigned int code, uint8_t *dest) const
+		{
+			// Strings are stored last byte first
+			for (unsigned int i = this->len[code]; i > 0; i--) {
+				dest[i - 1] = this->suffix[code];
+				code = this->prefix[code];
+			}
+			return;
+		}
+
+	protected:
+		uint32_t bitBuffer;        ///< Input bits not yet used
+		unsigned int bitCount;     ///< Number of bits in bitBuffer
+		unsigned int bitsRead;     ///< Bits used so far, for LZW_FLUSH_ON_RESET
+		unsigned int skipBits;     ///< Padding bits still to skip
+		bool finished;             ///< EOF codeword has been read
+
+		unsigned int codeBits;     ///< Current codeword size
+		unsigned int limit;        ///< Dictionary must grow before this codeword
+		unsigned int nextCode;     ///< Next free dictionary entry
+		int prevCode;              ///< Previous codeword, or -1 after a reset
+
+		uint16_t prefix[DICT_SIZE]; ///< Entry this one extends
+		uint16_t len[DICT_SIZE];    ///< Length of each entry's string
+		uint8_t suffix[DICT_SIZE];  ///< Last byte of each entry's string
+		uint8_t head[DICT_SIZE];    ///< First byte of each entry's string
+
+		/// Clear the dictionary back to just the single-byte codes.
+		void resetDict()
+		{
+			if (!(Params::flags & LZW_NO_BITSIZE_RESET)) {
+				this->setBits(Params::initialBits);
+			}
+			this->nextCode = Params::firstCode;
+			this->prevCode = -1;
+			return;
+		}
+
+		/// Change the codeword size.
+		void setBits(unsigned int bits)
+		{
+			this->codeBits = bits;
+			this->limit = 1u << bits;
+			if ((Params::flags & LZW_EOF_PARAM_VALID) && (Params::eofCode <= 0)) {
+				this->limit = std::min(this->limit, this->special(Params::eofCode));
+			}
+			if ((Params::flags & LZW_RESET_PARAM_VALID) && (Params::resetCode <= 0)) {
+				this->limit = std::min(this->limit, this->special(Params::resetCode));
+			}
+			return;
+		}
+
+		/// Get the value of the EOF or reset codeword at the current size.
+		unsigned int special(int code) const
+		{
+			if (code > 0) return code;
+			return (1u << this->codeBits) - 1 + code;
+		}
+
+		/// Add the next byte of input.
+		void addByte(uint8_t b)
+		{
+			if (Params::flags & LZW_BIG_ENDIAN) {
+				this->bitBuffer = (this->bitBuffer << 8) | b;
+			} else {
+				this->bitBuffer |= (uint32_t)b << this->bitCount;
+			}
+			this->bitCount += 8;
+			return;
+		}
+
+		/// Discard bits that have been used.
+		void dropBits(unsigned int n)
+		{
+			// Big-endian bits are taken from the top, so there's nothing to move
+			if (!(Params::flags & LZW_BIG_ENDIAN)) this->bitBuffer >>= n;
+			this->bitCount -= n;
+			return;
+		}
+};
+
+/// LZW decompression filter with its settings fixed at compile time.
+/**
+ * Gives the same output as filter_lzw_decompress with the same settings.
+ * Strings are written straight into the output buffer when there is room.
+ *
+ * @see lzw_static_decoder for the members Params must have.
+ */
+template <class Params>
+class filter_lzw_static_decompress: virtual public filter
+{
+	public:
+		virtual void reset(stream::len lenInput)
+		{
+			this->lzw.reset();
+			this->strPos = 0;
+			this->strLen = 0;
+			return;
+		}
+
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn)
+		{
+			stream::len r = 0, w = 0;
+
+			while (w < *lenOut) {
+				// Finish off a string that didn't fit last time
+				if (this->strPos < this->strLen) {
+					unsigned int n = std::min<stream::len>(
+						this->strLen - this->strPos, *lenOut - w);
+					memcpy(out + w, this->str + this->strPos, n);
+					this->strPos += n;
+					w += n;
+					continue;
+				}
+
+				int code = this->lzw.read(in, *lenIn, &r);
+				if (code < 0) break;
+				unsigned int len = this->lzw.length(code);
+				if (len <= *lenOut - w) {
+					this->lzw.expand(code, out + w);
+					w += len;
+				} else {
+					this->lzw.expand(code, this->str);
+					this->strPos = 0;
+					this->strLen = len;
+				}
+			}
+
+			*lenIn = r;
+			*lenOut = w;
+			return;
+		}
+
+	protected:
+		lzw_static_decoder<Params> lzw; ///< Codeword reader and dictionary
+
+		/// String that didn't fit in the output buffer.
+		uint8_t str[lzw_static_decoder<Params>::DICT_SIZE];
+		unsigned int strPos;       ///< Next byte in str to write out
+		unsigned int strLen;       ///< Length of string in str
+};
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // _CAMOTO_FILTER_LZW_STATIC_HPP_
@@ -92,14 +92,15 @@ std::unique_ptr<stream::inout> FilterType_Prehistorik::apply(
 std::unique_ptr<stream::input> FilterType_Prehistorik::apply(
 	std::unique_ptr<stream::input> target) const
 {
+	auto stages = this->decoders();
 	auto st1 = std::make_unique<stream::input_filtered>(
 		std::move(target),
-		std::make_shared<filter_crop>(PH_DECOMP_LEN)
+		stages[0].decoder
 	);
 
 	return std::make_unique<stream::input_filtered>(
 		std::move(st1),
-		std::make_shared<filter_lzss_decompress>(bitstream::bigEndian, 2, 8)
+		stages[1].decoder
 	);
 }
 
@@ -127,5 +128,14 @@ std::unique_ptr<stream::output> FilterType_Prehistorik::apply(
 	);
 }
 
+std::vector<FilterStage> FilterType_Prehistorik::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_crop>(PH_DECOMP_LEN)),
+		FilterStage::of(
+			std::make_shared<filter_lzss_decompress>(bitstream::bigEndian, 2, 8)),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
@@ -48,6 +48,7 @@ class DLL_EXPORT FilterType_Prehistorik: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target,
 			stream::fn_notify_prefiltered_size resize) const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
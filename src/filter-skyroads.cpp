@@ -18,8 +18,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <functional>
+#include <map>
+#include <camoto/bitstream.hpp>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
 #include "filter-skyroads.hpp"
@@ -34,7 +38,6 @@ namespace gamearchive {
 	this->dictPos = (this->dictPos + 1) % SKYROADS_DICT_SIZE;
 
 filter_skyroads_unlzs::filter_skyroads_unlzs()
-	:	data(bitstream::bigEndian)
 {
 }
 
@@ -42,8 +45,9 @@ void filter_skyroads_unlzs::reset(stream::len lenInput)
 {
 	this->state = S0_READ_LEN;
 	this->lzsLength = 0;
-	this->dictionary.reset(new uint8_t[SKYROADS_DICT_SIZE]);
+	this->dictionary.assign(SKYROADS_DICT_SIZE, 0);
 	this->dictPos = 0;
+	this->data.reset();
 	return;
 }
 
@@ -51,42 +55,37 @@ void filter_skyroads_unlzs::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
 	stream::len r = 0, w = 0;
-	fn_getnextchar cbNext = std::bind(bitstreamFilterNextChar, &in, lenIn, &r,
-		std::placeholders::_1);
-
-	// While there's more space to write, and either more data to read or
-	// more data to write
-	while (              // while there is...
-		(w < *lenOut)      // more space to write into, and
-		&& (
-			(r < *lenIn)     // more data to read, or
-			|| (this->lzsLength) // more data to write, and
-		)
-	) {
+
+	// Keep going while there's more space to write, even once all the input
+	// bytes have been read, as the bit buffer may still hold the last few codes.
+	// Every state that reads bits stops when it runs out.
+	while (w < *lenOut) {
 		bool needMoreData = false;
-		unsigned int bitsRead, code;
+		unsigned int code;
 
 		switch (this->state) {
 			case S0_READ_LEN:
-				if (*lenIn - r < 3) {
+				if (!this->data.need(24, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
-				this->data.changeEndian(bitstream::littleEndian);
-				bitsRead = this->data.read(cbNext, 8, &this->width1);
-				bitsRead = this->data.read(cbNext, 8, &this->width2);
-				bitsRead = this->data.read(cbNext, 8, &this->width3);
-				this->data.changeEndian(bitstream::bigEndian);
+				this->width1 = this->data.get(8);
+				this->width2 = this->data.get(8);
+				this->width3 = this->data.get(8);
+				if ((this->width1 > 24) || (this->width2 > 24) || (this->width3 > 24)) {
+					throw filter_error("SkyRoads compressed data has codes wider than 24 "
+						"bits.  Data is probably corrupt or not in this compression format.");
+				}
 
 				this->state = S1_READ_FLAG1;
 				break;
 
 			case S1_READ_FLAG1:
-				bitsRead = this->data.read(cbNext, 1, &code);
-				if (bitsRead == 0) {
+				if (!this->data.need(1, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(1);
 				if (code == 0) {
 					this->state = S3_DECOMP_SHORT;
 				} else {
@@ -95,11 +94,11 @@ void filter_skyroads_unlzs::transform(uint8_t *out, stream::len *lenOut,
 				break;
 
 			case S2_READ_FLAG2:
-				bitsRead = this->data.read(cbNext, 1, &code);
-				if (bitsRead == 0) {
+				if (!this->data.need(1, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(1);
 				if (code == 0) {
 					this->state = S4_DECOMP_LONG;
 				} else {
@@ -108,31 +107,31 @@ void filter_skyroads_unlzs::transform(uint8_t *out, stream::len *lenOut,
 				break;
 
 			case S3_DECOMP_SHORT:
-				bitsRead = this->data.read(cbNext, this->width2, &code);
-				if (bitsRead != this->width2) {
+				if (!this->data.need(this->width2, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(this->width2);
 				this->dist = 2 + code;
 				this->state = S6_GET_COUNT;
 				break;
 
 			case S4_DECOMP_LONG:
-				bitsRead = this->data.read(cbNext, this->width3, &code);
-				if (bitsRead != this->width3) {
+				if (!this->data.need(this->width3, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(this->width3);
 				this->dist = 2 + (1 << width2) + code;
 				this->state = S6_GET_COUNT;
 				break;
 
 			case S5_COPY_BYTE:
-				bitsRead = this->data.read(cbNext, 8, &code);
-				if (bitsRead != 8) {
+				if (!this->data.need(8, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(8);
 				ADD_DICT(code);
 				*out++ = code;
 				w++;
@@ -140,11 +139,11 @@ void filter_skyroads_unlzs::transform(uint8_t *out, stream::len *lenOut,
 				break;
 
 			case S6_GET_COUNT:
-				bitsRead = this->data.read(cbNext, this->width1, &code);
-				if (bitsRead != this->width1) {
+				if (!this->data.need(this->width1, in, *lenIn, &r)) {
 					needMoreData = true;
 					break;
 				}
+				code = this->data.get(this->width1);
 				this->lzsLength = 2 + code;
 
 				if (this->lzsLength > SKYROADS_DICT_SIZE) {
@@ -184,13 +183,184 @@ void filter_skyroads_unlzs::transform(uint8_t *out, stream::len *lenOut,
 }
 
 
-filter_skyroads_lzs::filter_skyroads_lzs()
-	:	data(bitstream::bigEndian)
+/// Shortest back-reference.
+#define SKYROADS_MIN_MATCH 2
+
+/// Closest a back-reference can be, as the distance is stored minus two.
+#define SKYROADS_MIN_DIST 2
+
+/// Bits used by a literal byte, including its two-bit prefix.
+#define SKYROADS_LITERAL_BITS 10
+
+/// Widest length field that can't produce a length over the dictionary size.
+#define SKYROADS_MAX_WIDTH1 11
+
+/// Widest long-distance field that can't reach past the dictionary.
+#define SKYROADS_MAX_WIDTH3 11
+
+/// A back-reference found by lzs_matcher.
+struct lzs_match {
+	unsigned int len;
+	unsigned int dist;
+};
+
+/// Find earlier copies of the data using hash chains on the next two bytes.
+class lzs_matcher
+{
+	public:
+		lzs_matcher(const uint8_t *data, unsigned int lenData)
+			:	data(data),
+				lenData(lenData),
+				head(65536, -1),
+				prev(lenData)
+		{
+		}
+
+		/// Make the data at pos available to later matches.
+		void insert(unsigned int pos)
+		{
+			if (pos + SKYROADS_MIN_MATCH > this->lenData) return;
+			unsigned int key = this->data[pos] | (this->data[pos + 1] << 8);
+			this->prev[pos] = this->head[key];
+			this->head[key] = pos;
+			return;
+		}
+
+		/// Find the longest earlier copy of the data at pos.
+		/**
+		 * @return Match with a length of zero if there is none.
+		 */
+		lzs_match find(unsigned int pos, unsigned int maxLen,
+			unsigned int maxDist, unsigned int maxChain) const
+		{
+			lzs_match best = {0, 0};
+			if (pos + SKYROADS_MIN_MATCH > this->lenData) return best;
+			maxLen = std::min(maxLen, this->lenData - pos);
+			unsigned int key = this->data[pos] | (this->data[pos + 1] << 8);
+			for (
+				int cand = this->head[key];
+				(cand >= 0) && (pos - cand <= maxDist) && maxChain;
+				cand = this->prev[cand], maxChain--
+			) {
+				if (pos - cand < SKYROADS_MIN_DIST) continue;
+				// Can't beat the current best unless the byte after it matches too
+				if (
+					(best.len >= SKYROADS_MIN_MATCH)
+					&& (this->data[cand + best.len] != this->data[pos + best.len])
+				) {
+					continue;
+				}
+				// The first two bytes always match, as they're the hash key
+				unsigned int len = SKYROADS_MIN_MATCH;
+				while (
+					(len < maxLen) && (this->data[cand + len] == this->data[pos + len])
+				) {
+					len++;
+				}
+				if (len > best.len) {
+					best.len = len;
+					best.dist = pos - cand;
+					if (len == maxLen) break;
+				}
+			}
+			return best;
+		}
+
+	protected:
+		const uint8_t *data;
+		unsigned int lenData;
+		std::vector<int> head; ///< Most recent position of each two-byte key
+		std::vector<int> prev; ///< Previous position with the same key
+};
+
+/// Number of bits taken up by a back-reference.
+static unsigned int lzsCodeBits(unsigned int dist, unsigned int width1,
+	unsigned int width2, unsigned int width3)
+{
+	if (dist - SKYROADS_MIN_DIST < (1u << width2)) return 1 + width2 + width1;
+	return 2 + width3 + width1;
+}
+
+/// Split data into literals and back-references.
+/**
+ * @param checkCost
+ *   If true, back-references that would take up more bits than writing the
+ *   same data as literals are not used.
+ *
+ * @param fnLiteral
+ *   Called with the position of each literal byte.
+ *
+ * @param fnMatch
+ *   Called for each back-reference.
+ */
+static void lzsParse(const std::vector<uint8_t>& data, unsigned int width1,
+	unsigned int width2, unsigned int width3, unsigned int maxChain, bool lazy,
+	bool checkCost, std::function<void(unsigned int)> fnLiteral,
+	std::function<void(const lzs_match&)> fnMatch)
+{
+	unsigned int lenData = data.size();
+	unsigned int maxLen = SKYROADS_MIN_MATCH + (1 << width1) - 1;
+	unsigned int maxDist = std::min<unsigned int>(SKYROADS_DICT_SIZE,
+		SKYROADS_MIN_DIST + (1 << width2) + (1 << width3) - 1);
+	lzs_matcher matcher(data.data(), lenData);
+
+	auto find = [&](unsigned int pos) {
+		lzs_match m = matcher.find(pos, maxLen, maxDist, maxChain);
+		if (
+			checkCost
+			&& (m.len >= SKYROADS_MIN_MATCH)
+			&& (lzsCodeBits(m.dist, width1, width2, width3)
+				>= m.len * SKYROADS_LITERAL_BITS)
+		) {
+			m.len = 0;
+		}
+		return m;
+	};
+
+	unsigned int pos = 0;
+	while (pos < lenData) {
+		lzs_match cur = find(pos);
+		matcher.insert(pos);
+
+		// If the next byte starts a longer match, write this one as a literal
+		// and use that instead.
+		while (lazy && (cur.len >= SKYROADS_MIN_MATCH) && (cur.len < maxLen)) {
+			lzs_match next = find(pos + 1);
+			if (next.len <= cur.len) break;
+			fnLiteral(pos);
+			pos++;
+			matcher.insert(pos);
+			cur = next;
+		}
+
+		if (cur.len >= SKYROADS_MIN_MATCH) {
+			fnMatch(cur);
+			for (unsigned int i = 1; i < cur.len; i++) matcher.insert(pos + i);
+			pos += cur.len;
+		} else {
+			fnLiteral(pos);
+			pos++;
+		}
+	}
+	return;
+}
+
+filter_skyroads_lzs::filter_skyroads_lzs(Effort effort)
+	:	effort(effort)
 {
 }
 
 void filter_skyroads_lzs::reset(stream::len lenInput)
 {
+	// Defaults, used as-is for Effort::Fast
+	this->width1 = 4;
+	this->width2 = 6;
+	this->width3 = 10;
+	this->input.clear();
+	this->input.reserve(lenInput);
+	this->encoded.clear();
+	this->posEncoded = 0;
+	this->state = S0_READ;
 	return;
 }
 
@@ -198,16 +368,23 @@ void filter_skyroads_lzs::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
 	stream::len r = 0, w = 0;
-	fn_putnextchar cbNext = std::bind(bitstreamFilterPutChar, &out, lenOut, &w,
-		std::placeholders::_1);
-
-	while (              // while there is...
-		(w + 2 < *lenOut) // leave some leftover bytes to guarantee the codeword will be written
-		&& (r < *lenIn)    // more data to read, or
-	) {
-		this->data.write(cbNext, 2, 0x03);
-		this->data.write(cbNext, 8, *in++);
-		r++;
+
+	if (this->state == S0_READ) {
+		if (*lenIn) {
+			this->input.insert(this->input.end(), in, in + *lenIn);
+			r = *lenIn;
+		} else {
+			// End of the input, so we can compress it now
+			this->compress();
+			this->state = S1_WRITE;
+		}
+	}
+
+	if (this->state == S1_WRITE) {
+		w = std::min<stream::len>(*lenOut,
+			this->encoded.size() - this->posEncoded);
+		memcpy(out, this->encoded.data() + this->posEncoded, w);
+		this->posEncoded += w;
 	}
 
 	*lenIn = r;
@@ -215,6 +392,122 @@ void filter_skyroads_lzs::transform(uint8_t *out, stream::len *lenOut,
 	return;
 }
 
+void filter_skyroads_lzs::compress()
+{
+	bool best = this->effort == Effort::Best;
+	if (best) this->chooseWidths();
+
+	this->encoded.clear();
+	this->encoded.reserve(3 + this->input.size() * SKYROADS_LITERAL_BITS / 8 + 1);
+	this->encoded.push_back(this->width1);
+	this->encoded.push_back(this->width2);
+	this->encoded.push_back(this->width3);
+
+	bitstream bits(bitstream::bigEndian);
+	unsigned long numBits = 0;
+	fn_putnextchar cbNext = [this](uint8_t c) {
+		this->encoded.push_back(c);
+		return 1;
+	};
+	auto write = [&](unsigned int width, unsigned int val) {
+		bits.write(cbNext, width, val);
+		numBits += width;
+	};
+
+	lzsParse(this->input, this->width1, this->width2, this->width3,
+		best ? 1024 : 16, best, true,
+		[&](unsigned int pos) {
+			write(2, 0x03);
+			write(8, this->input[pos]);
+		},
+		[&](const lzs_match& m) {
+			unsigned int code = m.dist - SKYROADS_MIN_DIST;
+			if (code < (1u << this->width2)) {
+				write(1, 0x00);
+				write(this->width2, code);
+			} else {
+				write(2, 0x02);
+				write(this->width3, code - (1 << this->width2));
+			}
+			write(this->width1, m.len - SKYROADS_MIN_MATCH);
+		}
+	);
+
+	// Pad the last byte with 1 bits.  These look like the start of a literal,
+	// which the decoder won't act on as there aren't enough bits left for the
+	// byte itself.
+	unsigned int lenPad = (8 - numBits % 8) % 8;
+	if (lenPad) write(lenPad, (1 << lenPad) - 1);
+	bits.flushByte(cbNext);
+
+	this->input.clear();
+	this->input.shrink_to_fit();
+	return;
+}
+
+void filter_skyroads_lzs::chooseWidths()
+{
+	// Find matches with the widest codes, including ones that would only be
+	// worth using with narrower codes, so every combination of widths below can
+	// be estimated from them.  Only the length and the number of bits needed
+	// for the distance affect the size of a code, so the matches are counted
+	// by those.
+	unsigned long numLiterals = 0;
+	std::map<std::pair<unsigned int, unsigned int>, unsigned long> matches;
+	lzsParse(this->input, SKYROADS_MAX_WIDTH1, SKYROADS_MAX_WIDTH3 - 1,
+		SKYROADS_MAX_WIDTH3, 256, false, false,
+		[&numLiterals](unsigned int pos) {
+			numLiterals++;
+		},
+		[&matches](const lzs_match& m) {
+			unsigned int distBits = 0;
+			for (unsigned int d = m.dist - SKYROADS_MIN_DIST; d; d >>= 1) distBits++;
+			matches[std::make_pair(m.len, distBits)]++;
+		}
+	);
+	if (matches.empty()) return; // widths make no difference
+
+	unsigned long bestBits = (unsigned long)-1;
+	for (unsigned int w1 = 1; w1 <= SKYROADS_MAX_WIDTH1; w1++) {
+		unsigned int maxLen = SKYROADS_MIN_MATCH + (1 << w1) - 1;
+		for (unsigned int w3 = 1; w3 <= SKYROADS_MAX_WIDTH3; w3++) {
+			for (unsigned int w2 = 1; w2 <= w3; w2++) {
+				unsigned int maxDist = SKYROADS_MIN_DIST + (1 << w2) + (1 << w3) - 1;
+				if (maxDist > SKYROADS_DICT_SIZE) continue;
+
+				unsigned long total = numLiterals * SKYROADS_LITERAL_BITS;
+				for (const auto& i : matches) {
+					unsigned int len = i.first.first;
+					unsigned int distBits = i.first.second;
+					unsigned long lenLiteral = len * SKYROADS_LITERAL_BITS;
+					// Distances just past the end of the short range could still
+					// fit, but they're rare enough not to matter here.
+					if (distBits > w3) {
+						total += i.second * lenLiteral;
+						continue;
+					}
+					unsigned long codeBits = (distBits <= w2)
+						? 1 + w2 + w1 : 2 + w3 + w1;
+					// Matches that are too long are split into several codes, with
+					// any single byte left over written as a literal.
+					unsigned long lenLeft = len % maxLen;
+					unsigned long matchBits = (len / maxLen) * codeBits
+						+ ((lenLeft >= SKYROADS_MIN_MATCH)
+							? codeBits : lenLeft * SKYROADS_LITERAL_BITS);
+					total += i.second * std::min(matchBits, lenLiteral);
+				}
+				if (total < bestBits) {
+					bestBits = total;
+					this->width1 = w1;
+					this->width2 = w2;
+					this->width3 = w3;
+				}
+			}
+		}
+	}
+	return;
+}
+
 
 FilterType_SkyRoads::FilterType_SkyRoads()
 {
@@ -273,6 +566,12 @@ std::unique_ptr<stream::output> FilterType_SkyRoads::apply(
 	);
 }
 
+std::vector<FilterStage> FilterType_SkyRoads::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_skyroads_unlzs>()),
+	};
+}
 
 } // namespace gamearchive
 } // namespace camoto
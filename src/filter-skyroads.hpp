@@ -21,10 +21,10 @@
 #ifndef _CAMOTO_FILTER_SKYROADS_LZS_HPP_
 #define _CAMOTO_FILTER_SKYROADS_LZS_HPP_
 
-#include <camoto/bitstream.hpp>
-#include <boost/shared_array.hpp>
+#include <vector>
 #include <camoto/filter.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
+#include "bitreader.hpp"
 
 namespace camoto {
 namespace gamearchive {
@@ -39,13 +39,13 @@ class filter_skyroads_unlzs: virtual public filter
 			const uint8_t *in, stream::len *lenIn);
 
 	protected:
-		bitstream data;
+		bitreader data;
 
 		unsigned int width1, width2, width3;
 		unsigned int dist;
 		unsigned int lzsDictPos;
 		unsigned int lzsLength;
-		boost::shared_array<uint8_t> dictionary;
+		std::vector<uint8_t> dictionary;
 		unsigned int dictPos;
 		enum {
 			S0_READ_LEN,     ///< Read the header
@@ -59,17 +59,56 @@ class filter_skyroads_unlzs: virtual public filter
 		} state;
 };
 
+/// SkyRoads LZS compressor.
+/**
+ * The whole file is buffered and compressed once the end of the input is
+ * reached, as the code widths in the header have to be known before any
+ * codes can be written.
+ */
 class filter_skyroads_lzs: virtual public filter
 {
 	public:
-		filter_skyroads_lzs();
+		/// How hard to try to make the output smaller.
+		enum class Effort {
+			/// Fixed code widths, and only the most recent matches are checked.
+			Fast,
+
+			/// Code widths are picked to suit the data, more matches are
+			/// checked, and a match is skipped if a longer one starts at the next
+			/// byte.
+			Best,
+		};
+
+		filter_skyroads_lzs(Effort effort = Effort::Best);
 
 		virtual void reset(stream::len lenInput);
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn);
 
 	protected:
-		bitstream data;
+		Effort effort;                ///< Speed/size tradeoff
+		unsigned int width1;          ///< Number of bits in a length
+		unsigned int width2;          ///< Number of bits in a short distance
+		unsigned int width3;          ///< Number of bits in a long distance
+		std::vector<uint8_t> input;   ///< Uncompressed data received so far
+		std::vector<uint8_t> encoded; ///< Compressed data, including header
+		std::size_t posEncoded;       ///< Amount of encoded already returned
+		/// Current state
+		enum {
+			S0_READ,   ///< Collecting input data
+			S1_WRITE,  ///< Returning compressed data
+		} state;
+
+		/// Compress input into encoded.
+		void compress();
+
+		/// Work out the code widths that will give the smallest output.
+		/**
+		 * A trial compression is done with the widest codes allowed, and the
+		 * size of the same matches is then estimated for every combination of
+		 * widths.
+		 */
+		void chooseWidths();
 };
 
 /// SkyRoads decompression filter.
@@ -90,6 +129,7 @@ class FilterType_SkyRoads: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
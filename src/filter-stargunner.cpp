@@ -1,6 +1,6 @@
 /**
  * @file  filter-stargunner.cpp
- * @brief Filter implementation for decompressing Stargunner files.
+ * @brief Filter implementation for Stargunner compression.
  *
  * This file format is fully documented on the ModdingWiki:
  *   http://www.shikadi.net/moddingwiki/DLT_Format
@@ -23,9 +23,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <functional>
 #include <stack>
+#include <thread>
 #include <camoto/filter.hpp>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
@@ -213,8 +217,230 @@ void filter_stargunner_decompress::transform(uint8_t *out, stream::len *lenOut,
 	return;
 }
 
+filter_stargunner_compress::filter_stargunner_compress(unsigned int numThreads)
+	:	numThreads(numThreads)
+{
+}
 
-FilterType_Stargunner::FilterType_Stargunner()
+void filter_stargunner_compress::implode_chunk(const uint8_t *in,
+	unsigned int len, std::vector<uint8_t> *out)
+{
+	assert(len <= CHUNK_SIZE);
+
+	uint8_t buf[CHUNK_SIZE];
+	memcpy(buf, in, len);
+
+	uint8_t tableA[256], tableB[256];
+	uint8_t depth[256];   // how deeply each codeword nests
+	bool inUse[256];      // byte value appears in the data or is a codeword
+	for (int i = 0; i < 256; i++) {
+		tableA[i] = i;
+		depth[i] = 0;
+		inUse[i] = false;
+	}
+	for (unsigned int i = 0; i < len; i++) inUse[buf[i]] = true;
+
+	// Number of times each pair of bytes appears.  Only the entries for pairs
+	// that are present are cleared each time, as that's much quicker than
+	// clearing the whole lot.
+	std::vector<uint16_t> pairCount(65536, 0);
+
+	int nextCode = 0;
+	for (;;) {
+		// Find a byte value to use as the next codeword
+		while ((nextCode < 256) && inUse[nextCode]) nextCode++;
+		if (nextCode == 256) break;
+
+		// Find the most common pair that won't nest too deeply
+		unsigned int bestPair = 0, bestCount = MIN_PAIR_COUNT - 1;
+		bool overlap = false;
+		for (unsigned int i = 0; i + 1 < len; i++) {
+			// Only count every second pair in a run like "AAAA", as the overlapping
+			// ones can't all be replaced.
+			if (overlap) {
+				overlap = false;
+				continue;
+			}
+			overlap = (i + 2 < len) && (buf[i] == buf[i + 1])
+				&& (buf[i + 1] == buf[i + 2]);
+			unsigned int pair = (buf[i] << 8) | buf[i + 1];
+			unsigned int count = ++pairCount[pair];
+			if (
+				(count > bestCount)
+				&& (std::max(depth[buf[i]], depth[buf[i + 1]]) < MAX_DEPTH)
+			) {
+				bestCount = count;
+				bestPair = pair;
+			}
+		}
+		for (unsigned int i = 0; i + 1 < len; i++) {
+			pairCount[(buf[i] << 8) | buf[i + 1]] = 0;
+		}
+		if (bestCount < MIN_PAIR_COUNT) break;
+
+		// Replace every occurrence of the pair with the new codeword
+		uint8_t a = bestPair >> 8, b = bestPair & 0xFF;
+		unsigned int lenNew = 0;
+		for (unsigned int i = 0; i < len; i++) {
+			if ((i + 1 < len) && (buf[i] == a) && (buf[i + 1] == b)) {
+				buf[lenNew++] = nextCode;
+				i++;
+			} else {
+				buf[lenNew++] = buf[i];
+			}
+		}
+		len = lenNew;
+		tableA[nextCode] = a;
+		tableB[nextCode] = b;
+		depth[nextCode] = std::max(depth[a], depth[b]) + 1;
+		inUse[nextCode] = true;
+	}
+
+	// Write out the dictionary.  A run of bytes that expand to themselves is
+	// skipped with a single code byte, after which exactly one codeword follows.
+	// Otherwise a code byte gives the number of codewords that follow.
+	std::size_t start = out->size();
+	auto writeEntry = [&](unsigned int c) {
+		out->push_back(tableA[c]);
+		if (tableA[c] != c) out->push_back(tableB[c]);
+	};
+	unsigned int c = 0;
+	while (c < 256) {
+		if (tableA[c] == c) {
+			unsigned int run = 1;
+			while ((run < 128) && (c + run < 256) && (tableA[c + run] == c + run)) {
+				run++;
+			}
+			out->push_back(127 + run);
+			c += run;
+			if (c == 256) break;
+			writeEntry(c++);
+		} else {
+			unsigned int run = 1;
+			while ((run < 128) && (c + run < 256) && (tableA[c + run] != c + run)) {
+				run++;
+			}
+			out->push_back(run - 1);
+			for (unsigned int i = 0; i < run; i++) writeEntry(c++);
+		}
+	}
+
+	out->push_back(len & 0xFF);
+	out->push_back(len >> 8);
+	out->insert(out->end(), buf, buf + len);
+
+	assert(out->size() - start <= CMP_CHUNK_SIZE - 2);
+	return;
+}
+
+void filter_stargunner_compress::reset(stream::len lenInput)
+{
+	if (lenInput > 0xFFFFFFFF) throw stream::error(
+		"Stargunner compression only supports files less than 4GB in size.");
+	this->input.clear();
+	this->input.reserve(lenInput);
+	this->encoded.clear();
+	this->posEncoded = 0;
+	this->state = S0_READ;
+	return;
+}
+
+void filter_stargunner_compress::transform(uint8_t *out, stream::len *lenOut,
+	const uint8_t *in, stream::len *lenIn)
+{
+	stream::len r = 0, w = 0;
+
+	if (this->state == S0_READ) {
+		if (*lenIn) {
+			if (this->input.size() + *lenIn > 0xFFFFFFFF) throw stream::error(
+				"Stargunner compression only supports files less than 4GB in size.");
+			this->input.insert(this->input.end(), in, in + *lenIn);
+			r = *lenIn;
+		} else {
+			// End of the input, so we can compress it now
+			this->compress();
+			this->state = S1_WRITE;
+		}
+	}
+
+	if (this->state == S1_WRITE) {
+		w = std::min<stream::len>(*lenOut,
+			this->encoded.size() - this->posEncoded);
+		memcpy(out, this->encoded.data() + this->posEncoded, w);
+		this->posEncoded += w;
+	}
+
+	*lenIn = r;
+	*lenOut = w;
+	return;
+}
+
+void filter_stargunner_compress::compress()
+{
+	std::size_t lenData = this->input.size();
+	std::size_t numChunks = (lenData + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	// Each chunk is compressed into its own buffer, then they are joined up in
+	// order once they're all done.
+	std::vector<std::vector<uint8_t>> chunks(numChunks);
+	auto implodeOne = [&](std::size_t j) {
+		std::size_t lenChunk = std::min<std::size_t>(CHUNK_SIZE,
+			lenData - j * CHUNK_SIZE);
+		chunks[j].reserve(CMP_CHUNK_SIZE - 2);
+		implode_chunk(this->input.data() + j * CHUNK_SIZE, lenChunk, &chunks[j]);
+	};
+
+	unsigned int threadCount = this->numThreads;
+	if (threadCount > numChunks) threadCount = numChunks;
+	if (threadCount <= 1) {
+		for (std::size_t j = 0; j < numChunks; j++) implodeOne(j);
+	} else {
+		// Each worker claims the next chunk until there are none left.
+		std::atomic<std::size_t> nextChunk(0);
+		auto worker = [&]() {
+			for (;;) {
+				std::size_t j = nextChunk++;
+				if (j >= numChunks) break;
+				implodeOne(j);
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount);
+
+		// Join whichever threads were started even if starting another one
+		// throws, as destroying a running std::thread calls std::terminate().
+		struct join_all {
+			std::vector<std::thread>& threads;
+			~join_all()
+			{
+				for (auto& t : this->threads) t.join();
+			}
+		} joiner{threads};
+
+		for (unsigned int t = 0; t < threadCount; t++) threads.emplace_back(worker);
+	}
+
+	this->encoded.clear();
+	this->encoded.reserve(8 + lenData + numChunks * 8);
+	this->encoded.push_back('P');
+	this->encoded.push_back('G');
+	this->encoded.push_back('B');
+	this->encoded.push_back('P');
+	this->encoded.push_back(lenData & 0xFF);
+	this->encoded.push_back((lenData >> 8) & 0xFF);
+	this->encoded.push_back((lenData >> 16) & 0xFF);
+	this->encoded.push_back((lenData >> 24) & 0xFF);
+	for (const auto& c : chunks) {
+		this->encoded.push_back(c.size() & 0xFF);
+		this->encoded.push_back(c.size() >> 8);
+		this->encoded.insert(this->encoded.end(), c.begin(), c.end());
+	}
+	return;
+}
+
+
+FilterType_Stargunner::FilterType_Stargunner(unsigned int numThreads)
+	:	numThreads(numThreads)
 {
 }
 
@@ -246,8 +472,7 @@ std::unique_ptr<stream::inout> FilterType_Stargunner::apply(
 	return std::make_unique<stream::filtered>(
 		std::move(target),
 		std::make_shared<filter_stargunner_decompress>(),
-		/// @todo Implement Stargunner compression
-		std::unique_ptr<filter>(),//std::make_shared<filter_stargunner_compress>(),
+		std::make_shared<filter_stargunner_compress>(this->numThreads),
 		resize
 	);
 }
@@ -267,11 +492,17 @@ std::unique_ptr<stream::output> FilterType_Stargunner::apply(
 {
 	return std::make_unique<stream::output_filtered>(
 		std::move(target),
-		/// @todo Implement Stargunner compression
-		std::unique_ptr<filter>(),//std::make_shared<filter_stargunner_compress>(),
+		std::make_shared<filter_stargunner_compress>(this->numThreads),
 		resize
 	);
 }
 
+std::vector<FilterStage> FilterType_Stargunner::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_stargunner_decompress>()),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
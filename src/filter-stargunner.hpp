@@ -1,6 +1,6 @@
 /**
  * @file  filter-stargunner.hpp
- * @brief Filter implementation for decompressing Stargunner files.
+ * @brief Filter implementation for Stargunner compression.
  *
  * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
  *
@@ -22,6 +22,7 @@
 #define _CAMOTO_FILTER_STARGUNNER_HPP_
 
 #include <stack>
+#include <vector>
 #include <camoto/stream.hpp>
 #include <camoto/bitstream.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
@@ -68,11 +69,86 @@ class filter_stargunner_decompress: virtual public filter
 		unsigned int posOut;   ///< How much data has been read out of bufOut
 };
 
+/// Stargunner compressor.
+/**
+ * Each CHUNK_SIZE block of input is compressed on its own with byte-pair
+ * encoding: the most common pair of adjacent bytes is repeatedly replaced by a
+ * byte value that doesn't otherwise appear in the chunk.  Since no chunk
+ * depends on any other, the whole file is buffered and once the end of the
+ * input is reached the chunks can be shared out between several threads.
+ */
+class filter_stargunner_compress: virtual public filter
+{
+	public:
+		/// Deepest a codeword may nest.
+		/**
+		 * The decoder expands codewords on a small stack, which overflows if they
+		 * are nested too deeply.
+		 */
+		constexpr static int MAX_DEPTH = 16;
+
+		/// Fewest times a pair must appear to be worth a codeword.
+		/**
+		 * A codeword can add up to four bytes to the dictionary, so below this
+		 * the chunk could end up larger.
+		 */
+		constexpr static int MIN_PAIR_COUNT = 4;
+
+		/// Constructor.
+		/**
+		 * @param numThreads
+		 *   Most chunks to compress at the same time.  By default everything is
+		 *   compressed on the calling thread, as the caller may already be
+		 *   running one filter per core.  No threads are started when there is
+		 *   only one chunk.
+		 */
+		filter_stargunner_compress(unsigned int numThreads = 1);
+
+		/// Compress a data chunk.
+		/**
+		 * @param in
+		 *   Uncompressed data.
+		 *
+		 * @param len
+		 *   Number of bytes at in.  Must be no more than CHUNK_SIZE.
+		 *
+		 * @param out
+		 *   Compressed data is appended here, in the form explode_chunk() reads
+		 *   (i.e. without the leading chunk length.)  It will be no more than
+		 *   CMP_CHUNK_SIZE - 2 bytes long.
+		 */
+		static void implode_chunk(const uint8_t *in, unsigned int len,
+			std::vector<uint8_t> *out);
+
+		virtual void reset(stream::len lenInput);
+		virtual void transform(uint8_t *out, stream::len *lenOut,
+			const uint8_t *in, stream::len *lenIn);
+
+	protected:
+		unsigned int numThreads;      ///< Most chunks to compress at once
+		std::vector<uint8_t> input;   ///< Uncompressed data received so far
+		std::vector<uint8_t> encoded; ///< Compressed data, including header
+		std::size_t posEncoded;       ///< Amount of encoded already returned
+		/// Current state
+		enum {
+			S0_READ,   ///< Collecting input data
+			S1_WRITE,  ///< Returning compressed data
+		} state;
+
+		/// Compress input into encoded.
+		void compress();
+};
+
 /// Stargunner decompression filter.
 class FilterType_Stargunner: virtual public FilterType
 {
 	public:
-		FilterType_Stargunner();
+		/// Constructor.
+		/**
+		 * @param numThreads
+		 *   Passed to filter_stargunner_compress when writing.
+		 */
+		FilterType_Stargunner(unsigned int numThreads = 1);
 		~FilterType_Stargunner();
 
 		virtual std::string code() const;
@@ -86,6 +162,10 @@ class FilterType_Stargunner: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
+
+	protected:
+		unsigned int numThreads; ///< Threads for each compressor to use
 };
 
 } // namespace gamearchive
@@ -61,25 +61,14 @@ std::unique_ptr<stream::inout> FilterType_Stellar7::apply(
 {
 	return std::make_unique<stream::filtered>(
 		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			0,   // EOF codeword is unused
-			256, // reset codeword is first codeword
-			LZW_LITTLE_ENDIAN     | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID | // has codeword reserved for dictionary reset
-			LZW_FLUSH_ON_RESET      // Jump to next word boundary on dict reset
-		),
+		std::make_shared<filter_lzw_static_decompress<LZWParams_Stellar7>>(),
 		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			0,   // EOF codeword is unused
-			256, // reset codeword is first codeword
-			LZW_LITTLE_ENDIAN     | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID | // has codeword reserved for dictionary reset
-			LZW_FLUSH_ON_RESET      // Jump to next word boundary on dict reset
+			LZWParams_Stellar7::initialBits,
+			LZWParams_Stellar7::maxBits,
+			LZWParams_Stellar7::firstCode,
+			LZWParams_Stellar7::eofCode,
+			LZWParams_Stellar7::resetCode,
+			LZWParams_Stellar7::flags
 		),
 		resize
 	);
@@ -90,16 +79,7 @@ std::unique_ptr<stream::input> FilterType_Stellar7::apply(
 {
 	return std::make_unique<stream::input_filtered>(
 		std::move(target),
-		std::make_shared<filter_lzw_decompress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			0,   // EOF codeword is unused
-			256, // reset codeword is first codeword
-			LZW_LITTLE_ENDIAN     | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID | // has codeword reserved for dictionary reset
-			LZW_FLUSH_ON_RESET      // Jump to next word boundary on dict reset
-		)
+		std::make_shared<filter_lzw_static_decompress<LZWParams_Stellar7>>()
 	);
 }
 
@@ -110,18 +90,25 @@ std::unique_ptr<stream::output> FilterType_Stellar7::apply(
 	return std::make_unique<stream::output_filtered>(
 		std::move(target),
 		std::make_shared<filter_lzw_compress>(
-			9,   // initial codeword length (in bits)
-			12,  // maximum codeword length (in bits)
-			257, // first valid codeword
-			0,   // EOF codeword is unused
-			256, // reset codeword is first codeword
-			LZW_LITTLE_ENDIAN     | // bits are split into bytes in little-endian order
-			LZW_RESET_PARAM_VALID | // has codeword reserved for dictionary reset
-			LZW_FLUSH_ON_RESET      // Jump to next word boundary on dict reset
+			LZWParams_Stellar7::initialBits,
+			LZWParams_Stellar7::maxBits,
+			LZWParams_Stellar7::firstCode,
+			LZWParams_Stellar7::eofCode,
+			LZWParams_Stellar7::resetCode,
+			LZWParams_Stellar7::flags
 		),
 		resize
 	);
 }
 
+std::vector<FilterStage> FilterType_Stellar7::decoders() const
+{
+	return {
+		FilterStage::of(
+			std::make_shared<filter_lzw_static_decompress<LZWParams_Stellar7>>()
+		),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
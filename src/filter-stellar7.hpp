@@ -22,10 +22,26 @@
 #define _CAMOTO_FILTER_STELLAR7_HPP_
 
 #include <camoto/gamearchive/filtertype.hpp>
+#include "filter-lzw-static.hpp"
 
 namespace camoto {
 namespace gamearchive {
 
+/// Stellar 7 LZW settings.
+struct LZWParams_Stellar7
+{
+	static constexpr unsigned int initialBits = 9; ///< Starting codeword size
+	static constexpr unsigned int maxBits = 12;    ///< Largest codeword size
+	static constexpr unsigned int firstCode = 257; ///< First dictionary codeword
+	static constexpr int eofCode = 0;              ///< EOF codeword is unused
+	static constexpr int resetCode = 256;          ///< Reset codeword is first codeword
+	static constexpr unsigned int flags =
+		LZW_LITTLE_ENDIAN     | // bits are split into bytes in little-endian order
+		LZW_RESET_PARAM_VALID | // has codeword reserved for dictionary reset
+		LZW_FLUSH_ON_RESET      // Jump to next word boundary on dict reset
+	;
+};
+
 /// Stellar 7 decompression filter.
 class FilterType_Stellar7: virtual public FilterType
 {
@@ -44,6 +60,7 @@ class FilterType_Stellar7: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
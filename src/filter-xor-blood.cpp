@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
 #include "filter-xor-blood.hpp"
@@ -32,11 +33,22 @@ filter_rff_crypt::filter_rff_crypt(int lenCrypt, int seed)
 {
 }
 
-uint8_t filter_rff_crypt::getKey()
+void filter_rff_crypt::getKeys(uint8_t *keys, unsigned int len)
 {
-	return (uint8_t)(this->seed + (this->offset >> 1));
-}
+	// Every byte value in order, each one twice, enough times over that a
+	// whole block can be copied from any starting point.
+	static const struct doubled_t {
+		uint8_t v[512 + XOR_KEY_BLOCK];
+		doubled_t()
+		{
+			for (unsigned int i = 0; i < sizeof(v); i++) v[i] = i >> 1;
+		}
+	} doubled;
 
+	// seed + offset/2 is the value at seed*2 + offset
+	memcpy(keys, doubled.v + ((this->seed * 2 + this->offset) & 0x1FF), len);
+	return;
+}
 
 FilterType_RFF::FilterType_RFF()
 {
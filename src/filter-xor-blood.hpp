@@ -37,7 +37,7 @@ class filter_rff_crypt: public filter_xor_crypt
 	public:
 		filter_rff_crypt(int lenCrypt, int seed);
 
-		virtual uint8_t getKey();
+		virtual void getKeys(uint8_t *keys, unsigned int len);
 };
 
 class FilterType_RFF: virtual public FilterType
@@ -18,6 +18,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
 #include "filter-xor-sagent.hpp"
@@ -37,16 +39,33 @@ filter_sam_crypt::filter_sam_crypt(int resetInterval)
 {
 }
 
-uint8_t filter_sam_crypt::getKey()
-{
-	if ((this->resetInterval == 42) && ((this->offset % 42) == 41)) {
-		// Special case for last char in each row of map file
-		return 0;
+void filter_sam_crypt::getKeys(uint8_t *keys, unsigned int len)
+{
+	unsigned int posInterval = this->offset % this->resetInterval;
+	unsigned int posKey = posInterval % SAM_KEYLEN;
+	unsigned int i = 0;
+	while (i < len) {
+		// Copy up to the end of the key, the end of the interval or the end of
+		// the block, whichever comes first
+		unsigned int lenRun = std::min<unsigned int>(SAM_KEYLEN - posKey,
+			this->resetInterval - posInterval);
+		if (lenRun > len - i) lenRun = len - i;
+		memcpy(keys + i, sam_key + posKey, lenRun);
+		i += lenRun;
+		posInterval += lenRun;
+		posKey += lenRun;
+		if (posInterval == (unsigned int)this->resetInterval) {
+			// Special case for last char in each row of map file
+			if (this->resetInterval == 42) keys[i - 1] = 0;
+			posInterval = 0;
+			posKey = 0;
+		} else if (posKey == SAM_KEYLEN) {
+			posKey = 0;
+		}
 	}
-	return (uint8_t)(sam_key[(this->offset % this->resetInterval) % SAM_KEYLEN]);
+	return;
 }
 
-
 FilterType_SAM_Base::FilterType_SAM_Base(int resetInterval)
 	:	resetInterval(resetInterval)
 {
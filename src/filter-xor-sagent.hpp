@@ -33,7 +33,7 @@ class filter_sam_crypt: public filter_xor_crypt
 {
 	public:
 		filter_sam_crypt(int resetInterval);
-		virtual uint8_t getKey();
+		virtual void getKeys(uint8_t *keys, unsigned int len);
 
 	protected:
 		/// How many bytes to decode before jumping back to the start of the key
@@ -18,16 +18,76 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XOR_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 #include "filter-xor.hpp"
 
 namespace camoto {
 namespace gamearchive {
 
+static void xor_block_scalar(uint8_t *out, const uint8_t *in,
+	const uint8_t *keys, std::size_t len)
+{
+	for (std::size_t i = 0; i < len; i++) out[i] = in[i] ^ keys[i];
+	return;
+}
+
+#ifdef XOR_X86_DISPATCH
+__attribute__((target("sse2")))
+static void xor_block_sse2(uint8_t *out, const uint8_t *in,
+	const uint8_t *keys, std::size_t len)
+{
+	std::size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i d = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i k = _mm_loadu_si128((const __m128i *)(keys + i));
+		_mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(d, k));
+	}
+	xor_block_scalar(out + i, in + i, keys + i, len - i);
+	return;
+}
+
+__attribute__((target("avx2")))
+static void xor_block_avx2(uint8_t *out, const uint8_t *in,
+	const uint8_t *keys, std::size_t len)
+{
+	std::size_t i = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i d = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i k = _mm256_loadu_si256((const __m256i *)(keys + i));
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_xor_si256(d, k));
+	}
+	xor_block_scalar(out + i, in + i, keys + i, len - i);
+	return;
+}
+#endif
+
+const std::vector<filter_xor_crypt::Kernel>& filter_xor_crypt::kernels()
+{
+	static const std::vector<Kernel> available = []() {
+		// Slowest first, so the default is always the last one
+		std::vector<Kernel> k{{"scalar", xor_block_scalar}};
+#ifdef XOR_X86_DISPATCH
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2")) k.push_back({"sse2", xor_block_sse2});
+		if (__builtin_cpu_supports("avx2")) k.push_back({"avx2", xor_block_avx2});
+#endif
+		return k;
+	}();
+	return available;
+}
+
 filter_xor_crypt::filter_xor_crypt(int lenCrypt, int seed)
-	:	lenCrypt(lenCrypt),
+	:	xorBlock(kernels().back().fn),
+		lenCrypt(lenCrypt),
 		seed(seed)
 {
 }
@@ -45,32 +105,35 @@ void filter_xor_crypt::reset(stream::len lenInput)
 void filter_xor_crypt::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
-	stream::len w = 0;
+	stream::len lenTotal = std::min(*lenIn, *lenOut);
+
+	// Work out how much of this is in the crypted portion
+	stream::len lenCrypted = lenTotal;
+	if (this->lenCrypt != 0) {
+		if (this->offset < this->lenCrypt) {
+			lenCrypted = std::min<stream::len>(lenTotal,
+				this->lenCrypt - this->offset);
+		} else {
+			lenCrypted = 0;
+		}
+	}
 
-	// Copy the crypted portion
-	while (
-		(w < *lenOut)
-		&& (w < *lenIn)
-		&& (
-			(this->lenCrypt == 0)
-			|| (this->offset < this->lenCrypt)
-		)
-	) {
-		*out++ = *in++ ^ this->getKey();
-		// We have to alter the offset here as its value is used by getKey()
-		this->offset++;
-		w++;
+	// Crypt it a block at a time
+	uint8_t keys[XOR_KEY_BLOCK];
+	stream::len w = 0;
+	while (w < lenCrypted) {
+		unsigned int lenBlock = std::min<stream::len>(XOR_KEY_BLOCK,
+			lenCrypted - w);
+		this->getKeys(keys, lenBlock);
+		this->xorBlock(out + w, in + w, keys, lenBlock);
+		this->offset += lenBlock;
+		w += lenBlock;
 	}
 
 	// Copy any plaintext portion
-	stream::len rem = *lenIn - w;
-	stream::len remOut = *lenOut - w;
-	if (remOut < rem) rem = remOut;
-
-	memcpy(out, in, (size_t)rem);
-	w += rem;
-	*lenOut = w;
-	*lenIn = w;
+	memcpy(out + w, in + w, (size_t)(lenTotal - w));
+	*lenOut = lenTotal;
+	*lenIn = lenTotal;
 
 	return;
 }
@@ -81,9 +144,26 @@ void filter_xor_crypt::setSeed(int val)
 	return;
 }
 
-uint8_t filter_xor_crypt::getKey()
+void filter_xor_crypt::setKernel(fn_xor_block fn)
+{
+	this->xorBlock = fn;
+	return;
+}
+
+void filter_xor_crypt::getKeys(uint8_t *keys, unsigned int len)
 {
-	return (uint8_t)(this->seed + this->offset);
+	// Every byte value in order, enough times over that a whole block can be
+	// copied from any starting value.
+	static const struct ascending_t {
+		uint8_t v[256 + XOR_KEY_BLOCK];
+		ascending_t()
+		{
+			for (unsigned int i = 0; i < sizeof(v); i++) v[i] = i;
+		}
+	} ascending;
+
+	memcpy(keys, ascending.v + (uint8_t)(this->seed + this->offset), len);
+	return;
 }
 
 
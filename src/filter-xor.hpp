@@ -21,20 +21,49 @@
 #ifndef _CAMOTO_FILTER_XOR_HPP_
 #define _CAMOTO_FILTER_XOR_HPP_
 
+#include <vector>
 #include <camoto/filter.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
 
 namespace camoto {
 namespace gamearchive {
 
+/// XOR a block of data with its key bytes.
+typedef void (*fn_xor_block)(uint8_t *out, const uint8_t *in,
+	const uint8_t *keys, std::size_t len);
+
 /// Encrypt data using XOR encryption.
 /**
  * This starts by encrypting the first byte with the given seed value, then
  * the seed is incremented by one for the following byte.
+ *
+ * Key bytes are generated a block at a time by getKeys(), and each block is
+ * then XOR'd with the data using the widest vector instructions the CPU
+ * supports.
  */
 class filter_xor_crypt: virtual public filter
 {
+	public:
+		/// Most key bytes to generate in one call to getKeys().
+		constexpr static int XOR_KEY_BLOCK = 1024;
+
+		/// One implementation of the block XOR, see kernels().
+		struct Kernel {
+			const char *name;  ///< Instruction set used, e.g. "sse2"
+			fn_xor_block fn;   ///< Function doing the XOR
+		};
+
+		/// Get every block XOR implementation this CPU can run.
+		/**
+		 * The first entry is always the plain C++ version, and the last one is
+		 * the fastest, which new filters use unless setKernel() is called.
+		 */
+		static const std::vector<Kernel>& kernels();
+
 	protected:
+		/// Function used to XOR each block with its keys.
+		fn_xor_block xorBlock;
+
 		/// Number of bytes to crypt, after this data is left as plaintext.
 		/// 0 means crypt everything.
 		int lenCrypt;
@@ -65,12 +94,23 @@ class filter_xor_crypt: virtual public filter
 		/// Change the next XOR value
 		void setSeed(int val);
 
-		/// Get the next byte's seed value.
+		/// Use a different block XOR implementation, taken from kernels().
+		void setKernel(fn_xor_block fn);
+
+		/// Get the key bytes for the next block of data.
 		/**
 		 * This can be overridden by descendent classes to provide
 		 * custom algorithms here.
+		 *
+		 * @param keys
+		 *   Set to the key for each byte, starting at the current offset.
+		 *
+		 * @param len
+		 *   Number of key bytes to generate, no more than XOR_KEY_BLOCK.
+		 *
+		 * @post The offset is unchanged.
 		 */
-		virtual uint8_t getKey();
+		virtual void getKeys(uint8_t *keys, unsigned int len);
 };
 
 /// Encrypt a stream using XOR encryption.
@@ -23,6 +23,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
 #include <functional>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/util.hpp> // std::make_unique
@@ -33,7 +34,6 @@ namespace camoto {
 namespace gamearchive {
 
 filter_z66_decompress::filter_z66_decompress()
-	:	data(bitstream::bigEndian)
 {
 }
 
@@ -41,18 +41,6 @@ filter_z66_decompress::~filter_z66_decompress()
 {
 }
 
-int filter_z66_decompress::nextChar(const uint8_t **in, stream::len *lenIn,
-	stream::len *r, uint8_t *out)
-{
-	if (*r < *lenIn) {
-		*out = **in; // "read" byte
-		(*in)++;     // increment read buffer
-		(*r)++;      // increment read count
-		return 1;    // return number of bytes read
-	}
-	return 0; // EOF
-}
-
 void filter_z66_decompress::reset(stream::len lenInput)
 {
 	this->outputLimit = 4; // need to allow enough to read the length field
@@ -67,7 +55,7 @@ void filter_z66_decompress::reset(stream::len lenInput)
 		nodes[i].nextCode = 0;
 	}
 
-	this->data.flushByte(); // drop any pending byte
+	this->data.reset(); // drop any pending bits
 }
 
 void filter_z66_decompress::transform(uint8_t *out, stream::len *lenOut,
@@ -75,37 +63,27 @@ void filter_z66_decompress::transform(uint8_t *out, stream::len *lenOut,
 {
 	stream::len r = 0, w = 0;
 
-	fn_getnextchar cbNext = std::bind(&filter_z66_decompress::nextChar, this,
-		&in, lenIn, &r, std::placeholders::_1);
-
 	while (
 		(w < *lenOut)  // while there is more space to write into
-		&& (
-			(r + 2 < *lenIn) // and there's at least two more bytes to read
-			|| (
-				(*lenIn < 10)   // or there's less than 10 bytes to read in this buffer (i.e. near EOF)
-				&& (r < *lenIn) // and there's at least one more byte to read
-			)
-			|| (this->state > 1) // or we're still processing what we read previously
-		)
 		&& (this->totalWritten < this->outputLimit) // and we haven't reached the target file size yet
 	) {
+		// Each state that reads bits stops when they run out, which may not be
+		// until after all the input bytes have been read as they are buffered.
 		switch (this->state) {
 			case 0: {
 				// Read the first four bytes (decompressed size) so we can limit the
 				// output size appropriately.
-				this->data.changeEndian(bitstream::littleEndian);
-				this->data.read(cbNext, 32, &this->outputLimit);
-				this->data.changeEndian(bitstream::bigEndian);
+				if (!this->data.need(32, in, *lenIn, &r)) goto done;
+				this->outputLimit = this->data.get(8);
+				this->outputLimit |= this->data.get(8) << 8;
+				this->outputLimit |= this->data.get(8) << 16;
+				this->outputLimit |= this->data.get(8) << 24;
 				this->state++;
 				break;
 			}
 			case 1: {
-				if (this->data.read(cbNext, this->codeLength, &this->code)
-					!= this->codeLength
-				) {
-					goto done;
-				}
+				if (!this->data.need(this->codeLength, in, *lenIn, &r)) goto done;
+				this->code = this->data.get(this->codeLength);
 				this->curCode = this->code;
 				this->state++;
 				break;
@@ -132,8 +110,8 @@ void filter_z66_decompress::transform(uint8_t *out, stream::len *lenOut,
 				}
 				break;
 			case 3: {
-				unsigned int value;
-				if (this->data.read(cbNext, 8, &value) != 8) goto done;
+				if (!this->data.need(8, in, *lenIn, &r)) goto done;
+				unsigned int value = this->data.get(8);
 				*out++ = value;
 				w++;
 				this->totalWritten++;
@@ -196,6 +174,8 @@ void filter_z66_compress::reset(stream::len lenInput)
 	this->codeLength = 9;
 	this->curDicIndex = 0;
 	this->maxDicIndex = 255;
+	this->curCode = -1;
+	memset(this->hash, 0, sizeof(this->hash));
 
 	this->data.flushByte(); // drop any pending byte
 }
@@ -208,54 +188,113 @@ void filter_z66_compress::transform(uint8_t *out, stream::len *lenOut,
 	fn_putnextchar cbNext = std::bind(&filter_z66_compress::putChar, this, &out,
 		lenOut, &w, std::placeholders::_1);
 
-	if (*lenIn == 0) {
-		// No more data to read, so flush
-		this->data.flushByte(cbNext);
-	}
-
 	while (
-		(w + 2 < *lenOut)  // while there is more space to write into
+		(w + 4 <= *lenOut) // while there's room for the header or a code+literal
 		&& (r < *lenIn) // and there's at least one more byte to read
 	) {
 		switch (this->state) {
 			case 0:
-				// Read the first four bytes (decompressed size) so we can limit the
-				// output size appropriately.
-				this->data.changeEndian(bitstream::littleEndian);
-				this->data.write(cbNext, 32, this->outputLimit);
-				this->data.changeEndian(bitstream::bigEndian);
+				this->writeHeader(cbNext);
 				this->state++;
 				break;
-			case 1:
-				this->data.write(cbNext, this->codeLength, *in++);
-				r++;
-				this->state++;
-				break;
-			case 2:
-				this->data.write(cbNext, 8, *in++);
+			case 1: {
+				uint8_t next = *in++;
 				r++;
-
-				this->curDicIndex++;
-				if (this->curDicIndex >= this->maxDicIndex) {
-					this->codeLength++;
-					if (this->codeLength == 13) {
-						this->codeLength = 9;
-						this->curDicIndex = 64;
-						this->maxDicIndex = 255;
-					} else {
-						this->maxDicIndex = (1 << this->codeLength) - 257;
-					}
+				if (this->curCode < 0) {
+					this->curCode = next;
+					break;
 				}
-				this->state = 1;
+				unsigned int key = (this->curCode << 8) | next;
+				int code = this->findCode(key);
+				if (code >= 0) {
+					// Still in the dictionary, see if it can be extended further
+					this->curCode = code;
+					break;
+				}
+				// The string with this byte added isn't in the dictionary, so write
+				// out the string matched so far, and this byte as a literal.
+				this->data.write(cbNext, this->codeLength, this->curCode);
+				this->data.write(cbNext, 8, next);
+				this->addEntry(key);
+				this->curCode = -1;
 				break;
+			}
 		} // switch(state)
 	} // while (more data to be read)
 
+	if (
+		(*lenIn == 0)
+		&& (this->state != 2)
+		&& (w + 8 <= *lenOut) // header, last code and partial byte
+	) {
+		// No more data to read, so write out any partial match and flush
+		if (this->state == 0) this->writeHeader(cbNext);
+		if (this->curCode >= 0) {
+			this->data.write(cbNext, this->codeLength, this->curCode);
+		}
+		this->data.flushByte(cbNext);
+		this->state = 2;
+	}
+
 	*lenIn = r;
 	*lenOut = w;
 	return;
 }
 
+void filter_z66_compress::writeHeader(fn_putnextchar cbNext)
+{
+	this->data.changeEndian(bitstream::littleEndian);
+	this->data.write(cbNext, 32, this->outputLimit);
+	this->data.changeEndian(bitstream::bigEndian);
+	return;
+}
+
+int filter_z66_compress::findCode(unsigned int key) const
+{
+	unsigned int mask = (1 << Z66_HASH_BITS) - 1;
+	for (unsigned int i = (key * 2654435761u) >> (32 - Z66_HASH_BITS);
+		this->hash[i].code; i = (i + 1) & mask
+	) {
+		if (this->hash[i].key == key) return this->hash[i].code;
+	}
+	return -1;
+}
+
+void filter_z66_compress::insertCode(unsigned int key, unsigned int code)
+{
+	unsigned int mask = (1 << Z66_HASH_BITS) - 1;
+	unsigned int i = (key * 2654435761u) >> (32 - Z66_HASH_BITS);
+	while (this->hash[i].code) i = (i + 1) & mask;
+	this->hash[i].key = key;
+	this->hash[i].code = code;
+	return;
+}
+
+void filter_z66_compress::addEntry(unsigned int key)
+{
+	this->entryKey[this->curDicIndex] = key;
+	this->insertCode(key, 256 + this->curDicIndex);
+	this->curDicIndex++;
+
+	if (this->curDicIndex >= this->maxDicIndex) {
+		this->codeLength++;
+		if (this->codeLength == 13) {
+			// The decompressor keeps the first 64 entries and starts overwriting
+			// the rest, so forget everything after those.
+			this->codeLength = 9;
+			this->curDicIndex = 64;
+			this->maxDicIndex = 255;
+			memset(this->hash, 0, sizeof(this->hash));
+			for (int i = 0; i < this->curDicIndex; i++) {
+				this->insertCode(this->entryKey[i], 256 + i);
+			}
+		} else {
+			this->maxDicIndex = (1 << this->codeLength) - 257;
+		}
+	}
+	return;
+}
+
 FilterType_Zone66::FilterType_Zone66()
 {
 }
@@ -313,5 +352,12 @@ std::unique_ptr<stream::output> FilterType_Zone66::apply(
 	);
 }
 
+std::vector<FilterStage> FilterType_Zone66::decoders() const
+{
+	return {
+		FilterStage::of(std::make_shared<filter_z66_decompress>()),
+	};
+}
+
 } // namespace gamearchive
 } // namespace camoto
@@ -25,6 +25,7 @@
 #include <camoto/stream.hpp>
 #include <camoto/bitstream.hpp>
 #include <camoto/gamearchive/filtertype.hpp>
+#include "bitreader.hpp"
 
 namespace camoto {
 namespace gamearchive {
@@ -36,15 +37,12 @@ class filter_z66_decompress: virtual public filter
 		filter_z66_decompress();
 		virtual ~filter_z66_decompress();
 
-		int nextChar(const uint8_t **in, stream::len *lenIn, stream::len *r,
-			uint8_t *out);
-
 		virtual void reset(stream::len lenInput);
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn);
 
 	protected:
-		bitstream data;
+		bitreader data;
 		int state;
 
 		unsigned int code, curCode;
@@ -62,10 +60,13 @@ class filter_z66_decompress: virtual public filter
 
 /// Zone 66 compression filter
 /**
- * This is a "fake" compression filter, in that it does not actually compress
- * the data, it just writes it out in such a way that when the game tries to
- * decompress it, it will recover the original data.  This also means the
- * "compressed" data will always be larger than the original data.
+ * Each code written is the longest string already in the dictionary, followed
+ * by the next byte as a literal.  That string plus the literal then becomes
+ * the next dictionary entry, exactly as the decompressor builds it.
+ *
+ * The dictionary is kept as a hash table keyed on each entry's prefix code and
+ * final byte, so finding whether the current string can be extended by one
+ * more byte is a single lookup.
  */
 class filter_z66_compress: virtual public filter
 {
@@ -81,10 +82,44 @@ class filter_z66_compress: virtual public filter
 			const uint8_t *in, stream::len *lenIn);
 
 	protected:
+		/// Number of slots in the hash table, must be a power of two.
+		constexpr static unsigned int Z66_HASH_BITS = 14;
+
 		bitstream data;
 		int state;
 		int codeLength, curDicIndex, maxDicIndex;
 		unsigned int outputLimit;  ///< Maximum number of bytes to write out overall
+		int curCode; ///< Code for the input matched so far, or -1 if none
+
+		/// Hash table of dictionary entries.
+		struct {
+			unsigned int key;  ///< Prefix code << 8 | final byte
+			unsigned int code; ///< Code for this string, or 0 if the slot is free
+		} hash[1 << Z66_HASH_BITS];
+
+		/// Key of each dictionary entry, so the table can be rebuilt when the
+		/// dictionary is reset.
+		unsigned int entryKey[4096];
+
+		/// Write the header containing the decompressed size.
+		void writeHeader(fn_putnextchar cbNext);
+
+		/// Look up a string in the dictionary.
+		/**
+		 * @param key
+		 *   Code for the string without its final byte, shifted left eight bits
+		 *   and ORed with the final byte.
+		 *
+		 * @return Code for the string, or -1 if it's not in the dictionary.
+		 */
+		int findCode(unsigned int key) const;
+
+		/// Add a string to the hash table with the given code.
+		void insertCode(unsigned int key, unsigned int code);
+
+		/// Add a string to the dictionary, as the decompressor will do when it
+		/// reads the code and literal for it.
+		void addEntry(unsigned int key);
 };
 
 /// Zone 66 compression handler
@@ -105,6 +140,7 @@ class FilterType_Zone66: virtual public FilterType
 		virtual std::unique_ptr<stream::output> apply(
 			std::unique_ptr<stream::output> target, stream::fn_notify_prefiltered_size resize)
 			const;
+		virtual std::vector<FilterStage> decoders() const;
 };
 
 } // namespace gamearchive
@@ -0,0 +1,89 @@
+/**
+ * @file  filtertype.cpp
+ * @brief Utility functions for FilterType.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <camoto/gamearchive/filtertype.hpp>
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+/// Run all of some data through one decoder.
+/**
+ * @param out
+ *   Decoded data.  Its initial size is used as the first guess at how much
+ *   space is needed, and it is trimmed to the actual length at the end.
+ */
+static void decodeStage(filter& decoder, const uint8_t *in, stream::len lenIn,
+	std::vector<uint8_t> *out)
+{
+	stream::len r = 0, w = 0;
+	bool eof = false;
+	for (;;) {
+		if (w == out->size()) {
+			out->resize(std::max<std::size_t>(out->size() * 2, 4096));
+		}
+
+		// Once the decoder can't do any more with what's left, an empty buffer
+		// tells it to flush anything it's still holding on to.
+		stream::len lenChunkIn = eof ? 0 : lenIn - r;
+		stream::len lenChunkOut = out->size() - w;
+		decoder.transform(out->data() + w, &lenChunkOut, in + r, &lenChunkIn);
+		r += lenChunkIn;
+		w += lenChunkOut;
+
+		if ((lenChunkIn == 0) && (lenChunkOut == 0)) {
+			if (eof) break;
+			eof = true;
+		}
+	}
+	out->resize(w);
+	return;
+}
+
+std::vector<FilterStage> FilterType::decoders() const
+{
+	return {};
+}
+
+bool FilterType::decodeAll(const uint8_t *in, stream::len lenIn,
+	std::vector<uint8_t> *out) const
+{
+	auto stages = this->decoders();
+	if (stages.empty()) return false;
+
+	// Each stage except the last decodes into one of these, for the next stage
+	// to read from.
+	std::vector<uint8_t> buffer[2];
+	for (std::size_t i = 0; i < stages.size(); i++) {
+		std::vector<uint8_t> *dest;
+		if (i + 1 == stages.size()) {
+			dest = out;
+		} else {
+			dest = &buffer[i % 2];
+			dest->resize(lenIn);
+		}
+		// Only the first decoder knows how much input it will get
+		stages[i].decoder->reset((i == 0) ? lenIn : 0);
+		decodeStage(*stages[i].decoder, in, lenIn, dest);
+		in = dest->data();
+		lenIn = dest->size();
+	}
+	return true;
+}
@@ -22,6 +22,7 @@
 #include <boost/algorithm/string.hpp>
 #include <functional>
 #include <camoto/util.hpp>
+#include <camoto/gamearchive/cache.hpp>
 #include <camoto/gamearchive/fixedarchive.hpp>
 #include <camoto/gamearchive/stream_archfile.hpp>
 
@@ -146,6 +147,8 @@ void FixedArchive::resize(const FileHandle& id, stream::pos newStoredSize,
 {
 	auto entry = FixedEntry::cast(id);
 	const FixedArchiveFile *file = &this->vcFiles[entry->index];
+	id->generation++;
+	DecodedCache::instance().invalidate(this, id);
 	if (file->fnResize) {
 		file->fnResize(*this->content, entry, newStoredSize, newRealSize);
 	} else if (id->storedSize != newStoredSize) {
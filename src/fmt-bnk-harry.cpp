@@ -255,11 +255,7 @@ void Archive_BNK_Harry::preInsertFile(const FATEntry *idBeforeThis, FATEntry *pN
 	;
 
 	// Since we've inserted some data for the embedded header, we need to update
-	// the other file offsets accordingly.  This call updates the offset of the
-	// files, then calls updateFileOffset() on them, using the *new* offset, so
-	// we need to do this after the insert() call above to make sure the extra
-	// data has been inserted.  Then when updateFileOffset() writes data out it
-	// will go into the correct spot.
+	// the other file offsets accordingly.
 	this->shiftFiles(NULL, pNewEntry->iOffset, pNewEntry->lenHeader, 0);
 
 	// Write out same again but into the BNK file's external FAT
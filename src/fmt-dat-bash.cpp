@@ -43,6 +43,35 @@
 namespace camoto {
 namespace gamearchive {
 
+/// Work out the type code stored in the FAT from a filename's extension.
+/**
+ * @return The type code, or 32 for a file with an extension that doesn't
+ *   correspond to a type, which is stored with its extension as part of the
+ *   name.
+ */
+static int typeFromFilename(const std::string& name)
+{
+	if (name.length() < 4) return 32;
+	std::string ext = name.substr(name.length() - 4);
+	int typeNum;
+	if (boost::iequals(ext, ".mif")) typeNum = 0;
+	else if (boost::iequals(ext, ".mbg")) typeNum = 1;
+	else if (boost::iequals(ext, ".mfg")) typeNum = 2;
+	else if (boost::iequals(ext, ".tbg")) typeNum = 3;
+	else if (boost::iequals(ext, ".tfg")) typeNum = 4;
+	else if (boost::iequals(ext, ".tbn")) typeNum = 5;
+	else if (boost::iequals(ext, ".sgl")) typeNum = 6;
+	else if (boost::iequals(ext, ".msp")) typeNum = 7;
+	else if (boost::iequals(ext, ".snd")) typeNum = 8;
+	else if (boost::iequals(ext, ".pbg")) typeNum = 12;
+	else if (boost::iequals(ext, ".pfg")) typeNum = 13;
+	else if (boost::iequals(ext, ".pal")) typeNum = 14;
+	else if (boost::iequals(ext, ".pbn")) typeNum = 16;
+	else if (boost::iequals(ext, ".spr")) typeNum = 64;
+	else typeNum = 32;
+	return typeNum;
+}
+
 ArchiveType_DAT_Bash::ArchiveType_DAT_Bash()
 {
 }
@@ -129,6 +158,11 @@ std::shared_ptr<Archive> ArchiveType_DAT_Bash::create(
 	return std::make_shared<Archive_DAT_Bash>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_DAT_Bash::builder() const
+{
+	return std::make_unique<ArchiveBuilder_DAT_Bash>();
+}
+
 std::shared_ptr<Archive> ArchiveType_DAT_Bash::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -142,6 +176,67 @@ SuppFilenames ArchiveType_DAT_Bash::getRequiredSupps(stream::input& content,
 }
 
 
+void ArchiveBuilder_DAT_Bash::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	// Check all the names before anything is written
+	std::vector<int> typeNums;
+	std::vector<std::string> nativeNames;
+	for (const auto& i : files) {
+		int typeNum = typeFromFilename(i.strName);
+		std::string strNativeName;
+		if ((typeNum != 32) && (typeNum != 8)) {
+			// Custom file, chop off extension
+			strNativeName = i.strName.substr(0, i.strName.length() - 4);
+		} else {
+			strNativeName = i.strName;
+		}
+		if (strNativeName.length() > DAT_MAX_FILENAME_LEN) {
+			throw stream::error("maximum filename length is "
+				TOSTRING(DAT_MAX_FILENAME_LEN) " chars");
+		}
+		if (i.size > 65535) {
+			throw stream::error(createString("The file \"" << i.strName
+				<< "\" is " << i.size << " bytes long, but the Monster Bash .DAT "
+				"file cannot store files larger than 65535 bytes."));
+		}
+		typeNums.push_back(typeNum);
+		nativeNames.push_back(strNativeName);
+	}
+
+	for (unsigned int i = 0; i < files.size(); i++) {
+		const auto& file = files[i];
+		if (file.fAttr & Archive::File::Attribute::Compressed) {
+			// The compressed size goes in the header, so the whole file has to be
+			// compressed before it can be written.
+			std::string data = this->encode(file, "lzw-bash");
+			if (data.length() > 65535) {
+				throw stream::error(createString("The file \"" << file.strName
+					<< "\" is " << data.length() << " bytes long once compressed, but "
+					"the Monster Bash .DAT file cannot store files larger than 65535 "
+					"bytes."));
+			}
+			content
+				<< u16le(typeNums[i])
+				<< u16le(data.length())
+				<< nullPadded(nativeNames[i], DAT_FILENAME_FIELD_LEN)
+				<< u16le(file.size)
+			;
+			content.write(data.data(), data.length());
+		} else {
+			content
+				<< u16le(typeNums[i])
+				<< u16le(file.size)
+				<< nullPadded(nativeNames[i], DAT_FILENAME_FIELD_LEN)
+				<< u16le(0)
+			;
+			this->writeData(content, file);
+		}
+	}
+	return;
+}
+
+
 Archive_DAT_Bash::Archive_DAT_Bash(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), DAT_FIRST_FILE_OFFSET, DAT_MAX_FILENAME_LEN)
 {
@@ -259,24 +354,8 @@ Archive::File::Attribute Archive_DAT_Bash::getSupportedAttributes() const
 
 void Archive_DAT_Bash::updateFileName(const FATEntry *pid, const std::string& strNewName)
 {
-	int typeNum;
+	int typeNum = typeFromFilename(strNewName);
 	int newLen = strNewName.length();
-	std::string ext = strNewName.substr(newLen - 4);
-	if (boost::iequals(ext, ".mif")) typeNum = 0;
-	else if (boost::iequals(ext, ".mbg")) typeNum = 1;
-	else if (boost::iequals(ext, ".mfg")) typeNum = 2;
-	else if (boost::iequals(ext, ".tbg")) typeNum = 3;
-	else if (boost::iequals(ext, ".tfg")) typeNum = 4;
-	else if (boost::iequals(ext, ".tbn")) typeNum = 5;
-	else if (boost::iequals(ext, ".sgl")) typeNum = 6;
-	else if (boost::iequals(ext, ".msp")) typeNum = 7;
-	else if (boost::iequals(ext, ".snd")) typeNum = 8;
-	else if (boost::iequals(ext, ".pbg")) typeNum = 12;
-	else if (boost::iequals(ext, ".pfg")) typeNum = 13;
-	else if (boost::iequals(ext, ".pal")) typeNum = 14;
-	else if (boost::iequals(ext, ".pbn")) typeNum = 16;
-	else if (boost::iequals(ext, ".spr")) typeNum = 64;
-	else typeNum = 32;
 
 	std::string strNativeName; // name to write to .dat file
 	if ((typeNum != 32) && (typeNum != 8)) {
@@ -376,11 +455,7 @@ void Archive_DAT_Bash::preInsertFile(const FATEntry *idBeforeThis,
 	}
 
 	// Since we've inserted some data for the embedded header, we need to update
-	// the other file offsets accordingly.  This call updates the offset of the
-	// files, then calls updateFileOffset() on them, using the *new* offset, so
-	// we need to do this after the insert() call above to make sure the extra
-	// data has been inserted.  Then when updateFileOffset() writes data out it
-	// will go into the correct spot.
+	// the other file offsets accordingly.
 	this->shiftFiles(NULL, pNewEntry->iOffset, pNewEntry->lenHeader, 0);
 
 	return;
@@ -390,25 +465,8 @@ void Archive_DAT_Bash::postInsertFile(FATEntry *pNewEntry)
 {
 	this->content->seekp(pNewEntry->iOffset, stream::start);
 
-	int typeNum;
-
+	int typeNum = typeFromFilename(pNewEntry->strName);
 	int newLen = pNewEntry->strName.length();
-	std::string ext = pNewEntry->strName.substr(newLen - 4);
-	if (boost::iequals(ext, ".mif")) typeNum = 0;
-	else if (boost::iequals(ext, ".mbg")) typeNum = 1;
-	else if (boost::iequals(ext, ".mfg")) typeNum = 2;
-	else if (boost::iequals(ext, ".tbg")) typeNum = 3;
-	else if (boost::iequals(ext, ".tfg")) typeNum = 4;
-	else if (boost::iequals(ext, ".tbn")) typeNum = 5;
-	else if (boost::iequals(ext, ".sgl")) typeNum = 6;
-	else if (boost::iequals(ext, ".msp")) typeNum = 7;
-	else if (boost::iequals(ext, ".snd")) typeNum = 8;
-	else if (boost::iequals(ext, ".pbg")) typeNum = 12;
-	else if (boost::iequals(ext, ".pfg")) typeNum = 13;
-	else if (boost::iequals(ext, ".pal")) typeNum = 14;
-	else if (boost::iequals(ext, ".pbn")) typeNum = 16;
-	else if (boost::iequals(ext, ".spr")) typeNum = 64;
-	else typeNum = 32;
 
 	if ((typeNum != 32) && (typeNum != 8)) {
 		// Custom file, chop off extension
@@ -41,12 +41,21 @@ class ArchiveType_DAT_Bash: virtual public ArchiveType
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Monster Bash .DAT archive in one pass.
+class ArchiveBuilder_DAT_Bash: virtual public ArchiveBuilder
+{
+	public:
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Monster Bash .DAT archive instance.
 class Archive_DAT_Bash: virtual public Archive_FAT
 {
@@ -235,6 +235,9 @@ Archive_DAT_GoT::~Archive_DAT_GoT()
 
 void Archive_DAT_GoT::flush()
 {
+	// Update the FAT before it gets encrypted and written out
+	this->flushFileOffsets();
+
 	this->fatStream->flush();
 
 	// Commit this->content
@@ -78,6 +78,13 @@ std::vector<std::string> ArchiveType_DLT_Stargunner::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_DLT_Stargunner::signatures() const
+{
+	return {
+		{0, "DAVE"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_DLT_Stargunner::isInstance(
 	stream::input& content) const
 {
@@ -230,11 +237,7 @@ void Archive_DLT_Stargunner::preInsertFile(const FATEntry *idBeforeThis, FATEntr
 		<< u32le(pNewEntry->storedSize);
 
 	// Since we've inserted some data for the embedded header, we need to update
-	// the other file offsets accordingly.  This call updates the offset of the
-	// files, then calls updateFileOffset() on them, using the *new* offset, so
-	// we need to do this after the insert() call above to make sure the extra
-	// data has been inserted.  Then when updateFileOffset() writes data out it
-	// will go into the correct spot.
+	// the other file offsets accordingly.
 	this->shiftFiles(NULL, pNewEntry->iOffset, pNewEntry->lenHeader, 0);
 
 	this->updateFileCount(this->vcFAT.size() + 1);
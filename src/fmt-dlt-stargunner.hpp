@@ -38,6 +38,7 @@ class ArchiveType_DLT_Stargunner: virtual public ArchiveType
 		virtual std::string friendlyName() const;
 		virtual std::vector<std::string> fileExtensions() const;
 		virtual std::vector<std::string> games() const;
+		virtual std::vector<Signature> signatures() const;
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
@@ -89,6 +89,13 @@ std::vector<std::string> ArchiveType_EPF_LionKing::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_EPF_LionKing::signatures() const
+{
+	return {
+		{0, "EPFS"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_EPF_LionKing::isInstance(
 	stream::input& content) const
 {
@@ -76,6 +76,13 @@ std::vector<std::string> ArchiveType_GLB_Galactix::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_GLB_Galactix::signatures() const
+{
+	return {
+		{4, std::string("GLIB FILE\0", 10)},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_GLB_Galactix::isInstance(
 	stream::input& content) const
 {
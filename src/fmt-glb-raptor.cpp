@@ -209,6 +209,9 @@ Archive_GLB_Raptor::~Archive_GLB_Raptor()
 
 void Archive_GLB_Raptor::flush()
 {
+	// Update the FAT before it gets encrypted and written out
+	this->flushFileOffsets();
+
 	FilterType_GLB_Raptor_FAT glbFilterType;
 	auto substrFAT = std::make_unique<stream::output_sub>(
 		this->content, 0,
@@ -79,6 +79,13 @@ std::vector<std::string> ArchiveType_GRP_Duke3D::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_GRP_Duke3D::signatures() const
+{
+	return {
+		{0, "KenSilverman"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_GRP_Duke3D::isInstance(
 	stream::input& content) const
 {
@@ -108,6 +115,11 @@ std::shared_ptr<Archive> ArchiveType_GRP_Duke3D::create(
 	return std::make_shared<Archive_GRP_Duke3D>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_GRP_Duke3D::builder() const
+{
+	return std::make_unique<ArchiveBuilder_GRP_Duke3D>();
+}
+
 std::shared_ptr<Archive> ArchiveType_GRP_Duke3D::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -121,6 +133,28 @@ SuppFilenames ArchiveType_GRP_Duke3D::getRequiredSupps(stream::input& data,
 }
 
 
+void ArchiveBuilder_GRP_Duke3D::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	this->checkFilenames(files, GRP_MAX_FILENAME_LEN);
+	stream::len lenArchive = GRP_HEADER_LEN + files.size() * GRP_FAT_ENTRY_LEN;
+	for (const auto& i : files) lenArchive += i.size;
+	this->checkArchiveSize(lenArchive, 0xFFFFFFFF);
+
+	content.write("KenSilverman", 12);
+	content << u32le(files.size());
+	for (const auto& i : files) {
+		content
+			<< nullPadded(boost::to_upper_copy(i.strName), GRP_FILENAME_FIELD_LEN)
+			<< u32le(i.size);
+	}
+	for (const auto& i : files) {
+		this->writeData(content, i);
+	}
+	return;
+}
+
+
 Archive_GRP_Duke3D::Archive_GRP_Duke3D(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), GRP_FIRST_FILE_OFFSET, GRP_MAX_FILENAME_LEN)
 {
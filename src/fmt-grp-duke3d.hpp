@@ -38,15 +38,25 @@ class ArchiveType_GRP_Duke3D: virtual public ArchiveType
 		virtual std::string friendlyName() const;
 		virtual std::vector<std::string> fileExtensions() const;
 		virtual std::vector<std::string> games() const;
+		virtual std::vector<Signature> signatures() const;
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Duke Nukem 3D .GRP archive in one pass.
+class ArchiveBuilder_GRP_Duke3D: virtual public ArchiveBuilder
+{
+	public:
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Duke Nukem 3D .GRP archive instance.
 class Archive_GRP_Duke3D: virtual public Archive_FAT
 {
@@ -74,6 +74,13 @@ std::vector<std::string> ArchiveType_GWx_HomeBrew::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_GWx_HomeBrew::signatures() const
+{
+	return {
+		{0, "HomeBrew File Folder\x1A"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_GWx_HomeBrew::isInstance(
 	stream::input& content) const
 {
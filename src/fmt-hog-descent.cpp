@@ -72,6 +72,13 @@ std::vector<std::string> ArchiveType_HOG_Descent::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_HOG_Descent::signatures() const
+{
+	return {
+		{0, "DHF"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_HOG_Descent::isInstance(
 	stream::input& content) const
 {
@@ -99,6 +106,11 @@ std::shared_ptr<Archive> ArchiveType_HOG_Descent::create(
 	return std::make_shared<Archive_HOG_Descent>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_HOG_Descent::builder() const
+{
+	return std::make_unique<ArchiveBuilder_HOG_Descent>();
+}
+
 std::shared_ptr<Archive> ArchiveType_HOG_Descent::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -112,6 +124,29 @@ SuppFilenames ArchiveType_HOG_Descent::getRequiredSupps(stream::input& content,
 }
 
 
+void ArchiveBuilder_HOG_Descent::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	if (files.size() > HOG_MAX_FILECOUNT) {
+		throw stream::error("too many files, maximum is "
+			TOSTRING(HOG_MAX_FILECOUNT) " files");
+	}
+	this->checkFilenames(files, HOG_MAX_FILENAME_LEN);
+	for (const auto& i : files) this->checkArchiveSize(i.size, 0xFFFFFFFF);
+
+	// Each FAT entry sits just before its file's data, so nothing has to be
+	// worked out in advance.
+	content.write("DHF", 3);
+	for (const auto& i : files) {
+		content
+			<< nullPadded(i.strName, HOG_FILENAME_FIELD_LEN)
+			<< u32le(i.size);
+		this->writeData(content, i);
+	}
+	return;
+}
+
+
 Archive_HOG_Descent::Archive_HOG_Descent(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), HOG_FIRST_FILE_OFFSET, HOG_MAX_FILENAME_LEN)
 {
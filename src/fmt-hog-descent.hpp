@@ -38,15 +38,25 @@ class ArchiveType_HOG_Descent: virtual public ArchiveType
 		virtual std::string friendlyName() const;
 		virtual std::vector<std::string> fileExtensions() const;
 		virtual std::vector<std::string> games() const;
+		virtual std::vector<Signature> signatures() const;
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Descent .HOG archive in one pass.
+class ArchiveBuilder_HOG_Descent: virtual public ArchiveBuilder
+{
+	public:
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Descent .HOG archive instance.
 class Archive_HOG_Descent: virtual public Archive_FAT
 {
@@ -77,6 +77,13 @@ std::vector<std::string> ArchiveType_LIB_Mythos::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_LIB_Mythos::signatures() const
+{
+	return {
+		{0, "LIB\x1A"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_LIB_Mythos::isInstance(
 	stream::input& content) const
 {
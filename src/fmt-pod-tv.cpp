@@ -33,6 +33,7 @@
 #define POD_FAT_ENTRY_LEN         40  // filename + u32le offset + u32le size
 #define POD_MAX_FILENAME_LEN      32
 #define POD_FIRST_FILE_OFFSET     POD_FAT_OFFSET
+#define POD_DEFAULT_DESCRIPTION   "Empty POD file"
 
 #define POD_FATENTRY_OFFSET(e)   (POD_FAT_OFFSET + (e)->iIndex * POD_FAT_ENTRY_LEN)
 #define POD_FILENAME_OFFSET(e)    POD_FATENTRY_OFFSET(e)
@@ -42,6 +43,23 @@
 namespace camoto {
 namespace gamearchive {
 
+/// Create the attribute holding the archive description.
+/**
+ * @param textValue
+ *   Initial description.
+ */
+static Attribute podDescAttribute(const std::string& textValue)
+{
+	Attribute attrDesc;
+	attrDesc.changed = false;
+	attrDesc.type = Attribute::Type::Text;
+	attrDesc.name = CAMOTO_ATTRIBUTE_COMMENT;
+	attrDesc.desc = "POD file description";
+	attrDesc.textMaxLength = POD_DESCRIPTION_LEN;
+	attrDesc.textValue = textValue;
+	return attrDesc;
+}
+
 ArchiveType_POD_TV::ArchiveType_POD_TV()
 {
 }
@@ -135,10 +153,15 @@ std::shared_ptr<Archive> ArchiveType_POD_TV::create(
 	content->seekp(0, stream::start);
 	*content
 		<< u32le(0) // File count
-		<< nullPadded("Empty POD file", POD_DESCRIPTION_LEN);
+		<< nullPadded(POD_DEFAULT_DESCRIPTION, POD_DESCRIPTION_LEN);
 	return std::make_shared<Archive_POD_TV>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_POD_TV::builder() const
+{
+	return std::make_unique<ArchiveBuilder_POD_TV>();
+}
+
 std::shared_ptr<Archive> ArchiveType_POD_TV::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -152,6 +175,39 @@ SuppFilenames ArchiveType_POD_TV::getRequiredSupps(stream::input& content,
 }
 
 
+ArchiveBuilder_POD_TV::ArchiveBuilder_POD_TV()
+{
+	this->v_attributes.push_back(podDescAttribute(POD_DEFAULT_DESCRIPTION));
+}
+
+void ArchiveBuilder_POD_TV::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	this->checkFilenames(files, POD_MAX_FILENAME_LEN);
+	stream::pos offData = POD_FAT_OFFSET + files.size() * POD_FAT_ENTRY_LEN;
+	stream::len lenArchive = offData;
+	for (const auto& i : files) lenArchive += i.size;
+	this->checkArchiveSize(lenArchive, 0xFFFFFFFF);
+
+	const auto& attrDesc = this->v_attributes[0];
+	assert(attrDesc.textValue.length() <= POD_DESCRIPTION_LEN);
+	content
+		<< u32le(files.size())
+		<< nullPadded(attrDesc.textValue, POD_DESCRIPTION_LEN);
+	for (const auto& i : files) {
+		content
+			<< nullPadded(boost::to_upper_copy(i.strName), POD_MAX_FILENAME_LEN)
+			<< u32le(i.size)
+			<< u32le(offData);
+		offData += i.size;
+	}
+	for (const auto& i : files) {
+		this->writeData(content, i);
+	}
+	return;
+}
+
+
 Archive_POD_TV::Archive_POD_TV(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), POD_FIRST_FILE_OFFSET, POD_MAX_FILENAME_LEN)
 {
@@ -179,15 +235,10 @@ Archive_POD_TV::Archive_POD_TV(std::unique_ptr<stream::inout> content)
 	}
 
 	// Read metadata
-	this->v_attributes.emplace_back();
-	auto& attrDesc = this->v_attributes.back();
-	attrDesc.changed = false;
-	attrDesc.type = Attribute::Type::Text;
-	attrDesc.name = CAMOTO_ATTRIBUTE_COMMENT;
-	attrDesc.desc = "POD file description";
-	attrDesc.textMaxLength = POD_DESCRIPTION_LEN;
+	std::string desc;
 	this->content->seekg(POD_DESCRIPTION_OFFSET, stream::start);
-	*this->content >> nullTerminated(attrDesc.textValue, POD_DESCRIPTION_LEN);
+	*this->content >> nullTerminated(desc, POD_DESCRIPTION_LEN);
+	this->v_attributes.push_back(podDescAttribute(desc));
 }
 
 Archive_POD_TV::~Archive_POD_TV()
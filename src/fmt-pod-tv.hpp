@@ -41,12 +41,23 @@ class ArchiveType_POD_TV: virtual public ArchiveType
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Terminal Velocity .POD archive in one pass.
+class ArchiveBuilder_POD_TV: virtual public ArchiveBuilder
+{
+	public:
+		ArchiveBuilder_POD_TV();
+
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Terminal Velocity .POD archive instance.
 class Archive_POD_TV: virtual public Archive_FAT
 {
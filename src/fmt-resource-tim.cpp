@@ -171,6 +171,9 @@ Archive_Resource_TIM::~Archive_Resource_TIM()
 
 void Archive_Resource_TIM::flush()
 {
+	// Update the FAT before it is written out
+	this->flushFileOffsets();
+
 	this->psFAT->flush();
 	this->Archive_FAT::flush();
 	return;
@@ -233,11 +236,7 @@ void Archive_Resource_TIM::preInsertFile(const FATEntry *idBeforeThis, FATEntry
 	;
 
 	// Since we've inserted some data for the embedded header, we need to update
-	// the other file offsets accordingly.  This call updates the offset of the
-	// files, then calls updateFileOffset() on them, using the *new* offset, so
-	// we need to do this after the insert() call above to make sure the extra
-	// data has been inserted.  Then when updateFileOffset() writes data out it
-	// will go into the correct spot.
+	// the other file offsets accordingly.
 	this->shiftFiles(NULL, pNewEntry->iOffset, pNewEntry->lenHeader, 0);
 
 	// Write out same info again but into the external FAT
@@ -49,6 +49,61 @@
 namespace camoto {
 namespace gamearchive {
 
+/// Split a filename into the base name and extension fields of a FAT entry.
+/**
+ * @throws stream::error if the name doesn't fit in 8.3 format.
+ */
+static void splitFilename(const std::string& full, std::string *base,
+	std::string *ext)
+{
+	std::string::size_type posDot = full.find_last_of('.');
+	if (
+		(
+			// If no dot, base name must be <= 8 chars
+			// TESTED BY: fmt_rff_blood_insert_long_nodot
+			(posDot == std::string::npos) &&
+			(full.length() > 8)
+		) || (
+			// Extension must be <= 3 chars
+			// TESTED BY: fmt_rff_blood_insert_long_ext
+			full.length() - posDot > 4   // 4 == '.' + 3 chars
+		) || (
+			// Base name (without extension) must be <= 8 chars
+			// TESTED BY: fmt_rff_blood_insert_long_base
+			posDot > 8
+		)
+	) {
+		throw stream::error("maximum filename length is 8.3 chars");
+	}
+
+	if (posDot != std::string::npos) {
+		ext->assign(full, posDot + 1, 3);
+	} else {
+		ext->clear();
+	}
+	base->assign(full, 0, posDot);
+
+	return;
+}
+
+/// Create the attribute that selects the file format version.
+/**
+ * @param enumValue
+ *   Initial value, 0 for v2.0 or 1 for v3.1.
+ */
+static Attribute rffVersionAttribute(unsigned int enumValue)
+{
+	Attribute attrVer;
+	attrVer.changed = false;
+	attrVer.type = Attribute::Type::Enum;
+	attrVer.name = "Version";
+	attrVer.desc = "File version";
+	attrVer.enumValueNames.emplace_back("v2.0 - no encryption");
+	attrVer.enumValueNames.emplace_back("v3.1 - selectable encryption");
+	attrVer.enumValue = enumValue;
+	return attrVer;
+}
+
 ArchiveType_RFF_Blood::ArchiveType_RFF_Blood()
 {
 }
@@ -81,6 +136,13 @@ std::vector<std::string> ArchiveType_RFF_Blood::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_RFF_Blood::signatures() const
+{
+	return {
+		{0, "RFF\x1A"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_RFF_Blood::isInstance(
 	stream::input& content) const
 {
@@ -116,6 +178,11 @@ std::shared_ptr<Archive> ArchiveType_RFF_Blood::create(
 	return std::make_shared<Archive_RFF_Blood>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_RFF_Blood::builder() const
+{
+	return std::make_unique<ArchiveBuilder_RFF_Blood>();
+}
+
 std::shared_ptr<Archive> ArchiveType_RFF_Blood::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -129,6 +196,89 @@ SuppFilenames ArchiveType_RFF_Blood::getRequiredSupps(stream::input& content,
 }
 
 
+ArchiveBuilder_RFF_Blood::ArchiveBuilder_RFF_Blood()
+{
+	// Same default as ArchiveType_RFF_Blood::create()
+	this->v_attributes.push_back(rffVersionAttribute(0));
+}
+
+void ArchiveBuilder_RFF_Blood::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	uint32_t version;
+	switch (this->v_attributes[0].enumValue) {
+		case 0: version = 0x200; break;
+		case 1: version = 0x301; break;
+		default: assert(false); version = 0x200; break;
+	}
+
+	// Check all the names before anything is written
+	std::vector<std::string> bases(files.size()), exts(files.size());
+	stream::len lenData = 0;
+	for (unsigned int i = 0; i < files.size(); i++) {
+		splitFilename(boost::to_upper_copy(files[i].strName), &bases[i], &exts[i]);
+		lenData += files[i].size;
+	}
+	// Encryption doesn't change the size of the data
+	stream::pos offFAT = RFF_FIRST_FILE_OFFSET + lenData;
+	this->checkArchiveSize(offFAT + files.size() * RFF_FAT_ENTRY_LEN, 0xFFFFFFFF);
+
+	content.write("RFF\x1A", 4);
+	content
+		<< u32le(version)
+		<< u32le(offFAT)
+		<< u32le(files.size())
+		<< u32le(0)               // Unknown
+		<< u32le(0)               // Unknown
+		<< u32le(0)               // Unknown
+		<< u32le(0);              // Unknown
+
+	// The FAT comes after the data, so it can be put together as the data is
+	// written.
+	stream::string fat;
+	stream::pos offNext = RFF_FIRST_FILE_OFFSET;
+	for (unsigned int i = 0; i < files.size(); i++) {
+		const auto& file = files[i];
+		uint8_t flags = 0;
+		if ((file.fAttr & Archive::File::Attribute::Encrypted)
+			&& (version >= 0x301)
+		) {
+			// Versions without encryption just store the file as-is, like
+			// preInsertFile() does.
+			flags |= RFF_FILE_ENCRYPTED;
+			std::string data = this->encode(file, "xor-blood");
+			content.write(data.data(), data.length());
+		} else {
+			this->writeData(content, file);
+		}
+		fat
+			<< nullPadded("", 16) // unknown
+			<< u32le(offNext)
+			<< u32le(file.size)
+			<< u32le(0) // unknown
+			<< u32le(0) // last modified time
+			<< u8(flags)
+			<< nullPadded(exts[i], 3)
+			<< nullPadded(bases[i], 8)
+			<< u32le(0); // unknown
+		offNext += file.size;
+	}
+
+	fat.seekg(0, stream::start);
+	if (version >= 0x301) {
+		// The FAT is encrypted in this version
+		stream::input_filtered fatCiphertext(
+			std::make_unique<stream::string>(std::move(fat.data)),
+			std::make_shared<filter_rff_crypt>(0, offFAT & 0xFF)
+		);
+		stream::copy(content, fatCiphertext);
+	} else {
+		stream::copy(content, fat);
+	}
+	return;
+}
+
+
 Archive_RFF_Blood::Archive_RFF_Blood(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), RFF_FIRST_FILE_OFFSET, ARCH_STD_DOS_FILENAMES),
 		modifiedFAT(false)
@@ -222,22 +372,16 @@ Archive_RFF_Blood::Archive_RFF_Blood(std::unique_ptr<stream::inout> content)
 	}
 
 	// Populate attributes
-	this->v_attributes.emplace_back();
-	auto& attrVer = this->v_attributes.back();
-	attrVer.changed = false;
-	attrVer.type = Attribute::Type::Enum;
-	attrVer.name = "Version";
-	attrVer.desc = "File version";
-	attrVer.enumValueNames.emplace_back("v2.0 - no encryption");
-	attrVer.enumValueNames.emplace_back("v3.1 - selectable encryption");
+	unsigned int verValue;
 	switch (this->version) {
-		case 0x200: attrVer.enumValue = 0; break;
-		case 0x301: attrVer.enumValue = 1; break;
+		case 0x200: verValue = 0; break;
+		case 0x301: verValue = 1; break;
 		default:
 			throw camoto::error(createString("Unknown RFF version 0x" << std::hex
 				<< this->version
 				<< ".  Please report this, with a sample file if possible!"));
 	}
+	this->v_attributes.push_back(rffVersionAttribute(verValue));
 }
 
 Archive_RFF_Blood::~Archive_RFF_Blood()
@@ -292,6 +436,9 @@ void Archive_RFF_Blood::attribute(unsigned int index, int newValue)
 
 void Archive_RFF_Blood::flush()
 {
+	// Update the FAT (and set modifiedFAT) before it is written out
+	this->flushFileOffsets();
+
 	if (this->modifiedFAT) {
 
 		// Write the new FAT offset into the file header
@@ -374,7 +521,7 @@ void Archive_RFF_Blood::updateFileName(const FATEntry *pid, const std::string& s
 
 	// See if the filename is valid
 	std::string base, ext;
-	this->splitFilename(strNewName, &base, &ext);
+	splitFilename(strNewName, &base, &ext);
 
 	// If we reach here the filename was OK
 
@@ -427,7 +574,7 @@ void Archive_RFF_Blood::preInsertFile(const FATEntry *idBeforeThis,
 	// Prepare filename field
 	std::string base, ext;
 	boost::to_upper(pNewEntry->strName);
-	this->splitFilename(pNewEntry->strName, &base, &ext);
+	splitFilename(pNewEntry->strName, &base, &ext);
 
 	// Add the new entry into the on-disk FAT.  This has to happen here (rather
 	// than in postInsertFile()) because on return Archive_FAT will update the
@@ -492,37 +639,5 @@ stream::pos Archive_RFF_Blood::getDescOffset() const
 	return offDesc;
 }
 
-void Archive_RFF_Blood::splitFilename(const std::string& full, std::string *base, std::string *ext)
-{
-	std::string::size_type posDot = full.find_last_of('.');
-	if (
-		(
-			// If no dot, base name must be <= 8 chars
-			// TESTED BY: fmt_rff_blood_insert_long_nodot
-			(posDot == std::string::npos) &&
-			(full.length() > 8)
-		) || (
-			// Extension must be <= 3 chars
-			// TESTED BY: fmt_rff_blood_insert_long_ext
-			full.length() - posDot > 4   // 4 == '.' + 3 chars
-		) || (
-			// Base name (without extension) must be <= 8 chars
-			// TESTED BY: fmt_rff_blood_insert_long_base
-			posDot > 8
-		)
-	) {
-		throw stream::error("maximum filename length is 8.3 chars");
-	}
-
-	if (posDot != std::string::npos) {
-		ext->assign(full, posDot + 1, 3);
-	} else {
-		ext->clear();
-	}
-	base->assign(full, 0, posDot);
-
-	return;
-}
-
 } // namespace gamearchive
 } // namespace camoto
@@ -41,15 +41,27 @@ class ArchiveType_RFF_Blood: virtual public ArchiveType
 		virtual std::string friendlyName() const;
 		virtual std::vector<std::string> fileExtensions() const;
 		virtual std::vector<std::string> games() const;
+		virtual std::vector<Signature> signatures() const;
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Blood .RFF archive in one pass.
+class ArchiveBuilder_RFF_Blood: virtual public ArchiveBuilder
+{
+	public:
+		ArchiveBuilder_RFF_Blood();
+
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Blood .RFF archive instance.
 class Archive_RFF_Blood: virtual public Archive_FAT
 {
@@ -81,9 +93,6 @@ class Archive_RFF_Blood: virtual public Archive_FAT
 		void updateFileCount(uint32_t newCount);
 
 		stream::pos getDescOffset() const;
-
-		void splitFilename(const std::string& full, std::string *base,
-			std::string *ext);
 };
 
 } // namespace gamearchive
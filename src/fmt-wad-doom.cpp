@@ -23,6 +23,7 @@
 
 #include <boost/algorithm/string.hpp>
 #include <camoto/iostream_helpers.hpp>
+#include <camoto/stream_string.hpp>
 #include <camoto/util.hpp>
 #include "fmt-wad-doom.hpp"
 
@@ -45,6 +46,28 @@
 namespace camoto {
 namespace gamearchive {
 
+/// Create the attribute that chooses between an IWAD and a PWAD.
+/**
+ * @param enumValue
+ *   Initial value, 0 for IWAD or 1 for PWAD.
+ */
+static Attribute wadTypeAttribute(unsigned int enumValue)
+{
+	Attribute attrType;
+	attrType.changed = false;
+	attrType.type = Attribute::Type::Enum;
+	attrType.name = "Type";
+	attrType.desc = "Type of WAD format.  IWAD files must contain all data for "
+		"the game.  PWAD files take priority and can override files, with any "
+		"files missing from a PWAD being read from the IWAD instead.  In other "
+		"words, an IWAD contains the original game, and a PWAD contains a mod, "
+		"which replaces some parts of the original game where needed.";
+	attrType.enumValueNames.emplace_back("IWAD");
+	attrType.enumValueNames.emplace_back("PWAD");
+	attrType.enumValue = enumValue;
+	return attrType;
+}
+
 ArchiveType_WAD_Doom::ArchiveType_WAD_Doom()
 {
 }
@@ -84,6 +107,14 @@ std::vector<std::string> ArchiveType_WAD_Doom::games() const
 	};
 }
 
+std::vector<ArchiveType::Signature> ArchiveType_WAD_Doom::signatures() const
+{
+	return {
+		{0, "IWAD"},
+		{0, "PWAD"},
+	};
+}
+
 ArchiveType::Certainty ArchiveType_WAD_Doom::isInstance(
 	stream::input& content) const
 {
@@ -114,6 +145,11 @@ std::shared_ptr<Archive> ArchiveType_WAD_Doom::create(
 	return std::make_shared<Archive_WAD_Doom>(std::move(content));
 }
 
+std::unique_ptr<ArchiveBuilder> ArchiveType_WAD_Doom::builder() const
+{
+	return std::make_unique<ArchiveBuilder_WAD_Doom>();
+}
+
 std::shared_ptr<Archive> ArchiveType_WAD_Doom::open(
 	std::unique_ptr<stream::inout> content, SuppData& suppData) const
 {
@@ -127,6 +163,41 @@ SuppFilenames ArchiveType_WAD_Doom::getRequiredSupps(stream::input& content,
 }
 
 
+ArchiveBuilder_WAD_Doom::ArchiveBuilder_WAD_Doom()
+{
+	// Same default as ArchiveType_WAD_Doom::create()
+	this->v_attributes.push_back(wadTypeAttribute(0));
+}
+
+void ArchiveBuilder_WAD_Doom::write(stream::output& content,
+	const std::vector<Entry>& files, SuppData& suppData)
+{
+	this->checkFilenames(files, WAD_MAX_FILENAME_LEN);
+	stream::pos offData = WAD_FAT_OFFSET + files.size() * WAD_FAT_ENTRY_LEN;
+	stream::len lenArchive = offData;
+	for (const auto& i : files) lenArchive += i.size;
+	this->checkArchiveSize(lenArchive, 0xFFFFFFFF);
+
+	content.write((this->v_attributes[0].enumValue == 0) ? "IWAD" : "PWAD", 4);
+	content
+		<< u32le(files.size())
+		<< u32le(WAD_FAT_OFFSET)
+	;
+	for (const auto& i : files) {
+		content
+			<< u32le(offData)
+			<< u32le(i.size)
+			<< nullPadded(boost::to_upper_copy(i.strName), WAD_FILENAME_FIELD_LEN)
+		;
+		offData += i.size;
+	}
+	for (const auto& i : files) {
+		this->writeData(content, i);
+	}
+	return;
+}
+
+
 Archive_WAD_Doom::Archive_WAD_Doom(std::unique_ptr<stream::inout> content)
 	:	Archive_FAT(std::move(content), WAD_FIRST_FILE_OFFSET, WAD_MAX_FILENAME_LEN)
 {
@@ -168,24 +239,10 @@ Archive_WAD_Doom::Archive_WAD_Doom(std::unique_ptr<stream::inout> content)
 	}
 
 	// Read metadata
-	this->v_attributes.emplace_back();
-	auto& attrType = this->v_attributes.back();
-	attrType.changed = false;
-	attrType.type = Attribute::Type::Enum;
-	attrType.name = "Type";
-	attrType.desc = "Type of WAD format.  IWAD files must contain all data for "
-		"the game.  PWAD files take priority and can override files, with any "
-		"files missing from a PWAD being read from the IWAD instead.  In other "
-		"words, an IWAD contains the original game, and a PWAD contains a mod, "
-		"which replaces some parts of the original game where needed.";
-	attrType.enumValueNames.emplace_back("IWAD");
-	attrType.enumValueNames.emplace_back("PWAD");
-
 	this->content->seekg(0, stream::start);
 	char wadType;
 	this->content->read(&wadType, 1);
-	if (wadType == 'I') attrType.enumValue = 0;
-	else attrType.enumValue = 1;
+	this->v_attributes.push_back(wadTypeAttribute((wadType == 'I') ? 0 : 1));
 }
 
 Archive_WAD_Doom::~Archive_WAD_Doom()
@@ -228,6 +285,30 @@ void Archive_WAD_Doom::updateFileOffset(const FATEntry *pid, stream::delta offDe
 	return;
 }
 
+void Archive_WAD_Doom::updateFileOffsets(
+	MovedFileVector::const_iterator begin, MovedFileVector::const_iterator end)
+{
+	// TESTED BY: fmt_wad_doom_insert*
+	// TESTED BY: fmt_wad_doom_remove*
+
+	// Read in the affected part of the FAT, patch all the offsets, then write
+	// it back, rather than seeking to each entry in turn.
+	stream::pos offRun = WAD_FILEOFFSET_OFFSET(begin->first);
+	stream::string fat;
+	fat.data.resize((end - begin) * WAD_FAT_ENTRY_LEN);
+	this->content->seekg(offRun, stream::start);
+	this->content->read((uint8_t *)&fat.data[0], fat.data.length());
+
+	for (auto i = begin; i != end; i++) {
+		fat.seekp((i - begin) * WAD_FAT_ENTRY_LEN, stream::start);
+		fat << u32le(i->first->iOffset);
+	}
+
+	this->content->seekp(offRun, stream::start);
+	this->content->write(fat.data);
+	return;
+}
+
 void Archive_WAD_Doom::updateFileSize(const FATEntry *pid, stream::delta sizeDelta)
 {
 	// TESTED BY: fmt_wad_doom_insert*
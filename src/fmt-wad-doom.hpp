@@ -38,15 +38,27 @@ class ArchiveType_WAD_Doom: virtual public ArchiveType
 		virtual std::string friendlyName() const;
 		virtual std::vector<std::string> fileExtensions() const;
 		virtual std::vector<std::string> games() const;
+		virtual std::vector<Signature> signatures() const;
 		virtual ArchiveType::Certainty isInstance(stream::input& content) const;
 		virtual std::shared_ptr<Archive> create(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
+		virtual std::unique_ptr<ArchiveBuilder> builder() const;
 		virtual std::shared_ptr<Archive> open(
 			std::unique_ptr<stream::inout> content, SuppData& suppData) const;
 		virtual SuppFilenames getRequiredSupps(stream::input& content,
 			const std::string& filename) const;
 };
 
+/// Writes a new Doom .WAD archive in one pass.
+class ArchiveBuilder_WAD_Doom: virtual public ArchiveBuilder
+{
+	public:
+		ArchiveBuilder_WAD_Doom();
+
+		virtual void write(stream::output& content,
+			const std::vector<Entry>& files, SuppData& suppData);
+};
+
 /// Doom .WAD archive instance.
 class Archive_WAD_Doom: virtual public Archive_FAT
 {
@@ -59,6 +71,8 @@ class Archive_WAD_Doom: virtual public Archive_FAT
 		virtual void updateFileName(const FATEntry *pid,
 			const std::string& strNewName);
 		virtual void updateFileOffset(const FATEntry *pid, stream::delta offDelta);
+		virtual void updateFileOffsets(MovedFileVector::const_iterator begin,
+			MovedFileVector::const_iterator end);
 		virtual void updateFileSize(const FATEntry *pid, stream::delta sizeDelta);
 		virtual void preInsertFile(const FATEntry *idBeforeThis,
 			FATEntry *pNewEntry);
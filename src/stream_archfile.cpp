@@ -18,20 +18,100 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <camoto/util.hpp>
+#include <camoto/gamearchive/cache.hpp>
 #include <camoto/gamearchive/manager.hpp>
 #include <camoto/gamearchive/stream_archfile.hpp>
 
 namespace camoto {
 namespace gamearchive {
 
-std::unique_ptr<stream::inout> applyFilter(std::unique_ptr<archfile> s,
-	const std::string& filter)
+/// Filtered file that is decoded into memory all at once where worthwhile.
+/**
+ * The data comes either from DecodedCache, or from FilterType::decodeAll().
+ * Unless the file was already in the cache, nothing is decoded until the
+ * first read.  If that read is for the whole file, the whole file is decoded
+ * with decodeAll() and added to the cache, otherwise (e.g. only a header is
+ * being read) the usual filtered stream is used, so only as much is decoded
+ * as is read.
+ *
+ * Reads come straight from the decoded data.  The first time anything is
+ * written, the file is decoded again in the usual way and everything from
+ * then on goes through that stream instead, so the changes get encoded and
+ * written back to the archive when the stream is flushed.
+ */
+class cached_archfile: virtual public stream::inout
 {
-	if (filter.empty()) return std::move(s);
+	public:
+		/// Wrap a filtered file.
+		/**
+		 * @param data
+		 *   Decoded file content, or nullptr to decide how to decode the file on
+		 *   the first read.
+		 *
+		 * @param raw
+		 *   Unfiltered file.
+		 *
+		 * @param filter
+		 *   Filter code to decode raw with.
+		 *
+		 * @param cache
+		 *   true to add the data to DecodedCache if the whole file is decoded.
+		 *
+		 * @param generation
+		 *   Value from DecodedCache::find(), if cache is true.
+		 */
+		cached_archfile(DecodedCache::Data data, std::unique_ptr<archfile> raw,
+			const std::string& filter, bool cache, unsigned long generation);
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len);
+		virtual void seekg(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellg() const;
+		virtual stream::len size() const;
+
+		virtual stream::len try_write(const uint8_t *buffer, stream::len len);
+		virtual void seekp(stream::delta off, stream::seek_from from);
+		virtual stream::pos tellp() const;
+		virtual void truncate(stream::len size);
+		virtual void flush();
+
+	protected:
+		DecodedCache::Data data;             ///< Decoded file content, if any
+		std::unique_ptr<archfile> raw;       ///< Unfiltered file, until filtered
+		std::string filter;                  ///< Filter code to decode raw with
+		std::unique_ptr<stream::inout> real; ///< Filtered stream, once in use
+		stream::pos offRead;                 ///< Read position, until filtered
+		stream::pos offWrite;                ///< Write position, until filtered
+		bool cache;                          ///< Add decoded data to the cache
+		unsigned long generation;            ///< File version for the cache
+
+		/// Decode the whole file, and add it to the cache if it's in use.
+		/**
+		 * If the filter can't decode the whole file in one go, data is left
+		 * unset, although with the cache in use the data is still cached by
+		 * reading it through the filtered stream.
+		 */
+		void decode();
+
+		/// Switch over to a real filtered stream.
+		/**
+		 * This happens when the file is written to, or when it hasn't been
+		 * decoded and something other than the whole file is needed.
+		 */
+		stream::inout& filtered();
+
+		/// Work out the target of a seek, or throw if it is out of range.
+		stream::pos seekTarget(stream::pos cur, stream::delta off,
+			stream::seek_from from) const;
+};
 
-	// The file needs to be filtered first
+/// Apply a filter to a file, without going through the cache.
+static std::unique_ptr<stream::inout> decodeFile(std::unique_ptr<archfile> s,
+	const std::string& filter)
+{
 	auto pFilterType = FilterManager::byCode(filter);
 	if (!pFilterType) {
 		throw stream::error(createString(
@@ -62,6 +142,202 @@ std::unique_ptr<stream::inout> applyFilter(std::unique_ptr<archfile> s,
 	);
 }
 
+/// Decode a whole file in one go with FilterType::decodeAll().
+/**
+ * @return The decoded data, or nullptr if the filter can only be used through
+ *   a filtered stream.
+ */
+static DecodedCache::Data decodeWhole(archfile& s, const std::string& filter)
+{
+	auto pFilterType = FilterManager::byCode(filter);
+	if (!pFilterType) return nullptr; // decodeFile() reports the error
+
+	// Files in read-only archives are already in memory
+	const Archive *archive = s.owner();
+	const uint8_t *in = archive ? archive->mappedData(s.id) : nullptr;
+	stream::len lenIn = s.id->storedSize;
+	std::vector<uint8_t> raw;
+	if (!in) {
+		raw.resize(lenIn);
+		s.seekg(0, stream::start);
+		s.read(raw.data(), lenIn);
+		in = raw.data();
+	}
+
+	auto content = std::make_shared<std::vector<uint8_t>>(s.id->realSize);
+	if (!pFilterType->decodeAll(in, lenIn, content.get())) return nullptr;
+	return content;
+}
+
+std::unique_ptr<stream::inout> applyFilter(std::unique_ptr<archfile> s,
+	const std::string& filter)
+{
+	if (filter.empty()) return std::move(s);
+
+	auto& cache = DecodedCache::instance();
+	bool useCache = cache.budget() > 0;
+	DecodedCache::Data data;
+	unsigned long generation = 0;
+	if (useCache) data = cache.find(s->owner(), s->id, &generation);
+
+	// If it's not in the cache, leave it until the first read to decide
+	// whether to decode it all
+	return std::make_unique<cached_archfile>(data, std::move(s), filter,
+		useCache, generation);
+}
+
+cached_archfile::cached_archfile(DecodedCache::Data data,
+	std::unique_ptr<archfile> raw, const std::string& filter, bool cache,
+	unsigned long generation)
+	:	data(data),
+		raw(std::move(raw)),
+		filter(filter),
+		offRead(0),
+		offWrite(0),
+		cache(cache),
+		generation(generation)
+{
+}
+
+stream::len cached_archfile::try_read(uint8_t *buffer, stream::len len)
+{
+	if (this->real) return this->real->try_read(buffer, len);
+
+	if (!this->data) {
+		// Only decode everything up front if everything is being read
+		if ((this->offRead == 0) && (len >= this->raw->id->realSize)) {
+			this->decode();
+		}
+		if (!this->data) return this->filtered().try_read(buffer, len);
+	}
+
+	if (this->offRead >= this->data->size()) return 0;
+	len = std::min<stream::len>(len, this->data->size() - this->offRead);
+	memcpy(buffer, this->data->data() + this->offRead, len);
+	this->offRead += len;
+	return len;
+}
+
+void cached_archfile::seekg(stream::delta off, stream::seek_from from)
+{
+	// Seeking from the end needs the decoded size
+	if (this->real || (!this->data && (from == stream::end))) {
+		this->filtered().seekg(off, from);
+		return;
+	}
+	this->offRead = this->seekTarget(this->offRead, off, from);
+	return;
+}
+
+stream::pos cached_archfile::tellg() const
+{
+	if (this->real) return this->real->tellg();
+	return this->offRead;
+}
+
+stream::len cached_archfile::size() const
+{
+	if (this->real) return this->real->size();
+	if (!this->data) {
+		return const_cast<cached_archfile *>(this)->filtered().size();
+	}
+	return this->data->size();
+}
+
+stream::len cached_archfile::try_write(const uint8_t *buffer, stream::len len)
+{
+	return this->filtered().try_write(buffer, len);
+}
+
+void cached_archfile::seekp(stream::delta off, stream::seek_from from)
+{
+	if (this->real || (!this->data && (from == stream::end))) {
+		this->filtered().seekp(off, from);
+		return;
+	}
+	this->offWrite = this->seekTarget(this->offWrite, off, from);
+	return;
+}
+
+stream::pos cached_archfile::tellp() const
+{
+	if (this->real) return this->real->tellp();
+	return this->offWrite;
+}
+
+void cached_archfile::truncate(stream::len size)
+{
+	if (!this->real && this->data && (size == this->data->size())) return;
+	this->filtered().truncate(size);
+	return;
+}
+
+void cached_archfile::flush()
+{
+	// Nothing to do unless something has been written
+	if (this->real) this->real->flush();
+	return;
+}
+
+void cached_archfile::decode()
+{
+	auto& cache = DecodedCache::instance();
+	const Archive *archive = this->raw->owner();
+	auto id = this->raw->id;
+
+	this->data = decodeWhole(*this->raw, this->filter);
+	if (this->data) {
+		if (this->cache) cache.store(archive, id, this->generation, this->data);
+		return;
+	}
+	if (!this->cache) return;
+
+	// The filter can only be used through a stream, but the cache holds whole
+	// files, so read it all through the stream that will be used from now on.
+	auto& decoded = this->filtered();
+	stream::len lenDecoded = decoded.size();
+	if (lenDecoded <= cache.budget()) {
+		auto content = std::make_shared<std::vector<uint8_t>>(lenDecoded);
+		decoded.seekg(0, stream::start);
+		decoded.read(content->data(), lenDecoded);
+		decoded.seekg(this->offRead, stream::start);
+		cache.store(archive, id, this->generation, content);
+	}
+	return;
+}
+
+stream::inout& cached_archfile::filtered()
+{
+	if (!this->real) {
+		this->real = decodeFile(std::move(this->raw), this->filter);
+		this->real->seekg(this->offRead, stream::start);
+		this->real->seekp(this->offWrite, stream::start);
+	}
+	return *this->real;
+}
+
+stream::pos cached_archfile::seekTarget(stream::pos cur, stream::delta off,
+	stream::seek_from from) const
+{
+	// Without any decoded data, the end isn't known yet.  seekg() and seekp()
+	// hand seeks from the end to the filtered stream, and a target past the
+	// end is left for it to deal with.
+	stream::delta target;
+	switch (from) {
+		case stream::start: target = off; break;
+		case stream::cur: target = cur + off; break;
+		case stream::end: target = this->data->size() + off; break;
+		default: throw stream::seek_error("Invalid seek origin");
+	}
+	if (target < 0) {
+		throw stream::seek_error("Attempt to seek to before start of file");
+	}
+	if (this->data && ((stream::len)target > this->data->size())) {
+		throw stream::seek_error("Attempt to seek past end of file");
+	}
+	return target;
+}
+
 archfile_core::archfile_core(const Archive::FileHandle& id)
 	:	sub_core(0, 0),
 		id(const_cast<Archive::FileHandle&>(id)),
@@ -125,6 +401,14 @@ output_archfile::output_archfile(std::shared_ptr<Archive> archive,
 {
 }
 
+stream::len output_archfile::try_write(const uint8_t *buffer, stream::len len)
+{
+	// Anything cached from before this write is now out of date
+	this->id->generation++;
+	DecodedCache::instance().invalidate(this->archive.get(), this->id);
+	return this->output_sub::try_write(buffer, len);
+}
+
 void output_archfile::truncate(stream::len size)
 {
 	if (this->sub_size() == size) return; // nothing to do
@@ -159,6 +443,11 @@ void output_archfile::truncate(stream::len size)
 	return;
 }
 
+const Archive *output_archfile::owner() const
+{
+	return this->archive.get();
+}
+
 void output_archfile::setRealSize(stream::len newRealSize)
 {
 	this->archive->resize(this->id, this->id->storedSize, newRealSize);
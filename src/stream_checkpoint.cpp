@@ -0,0 +1,280 @@
+/**
+ * @file  stream_checkpoint.cpp
+ * @brief Filtered stream that can seek without decoding from the start.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <camoto/util.hpp> // std::make_unique
+#include <camoto/gamearchive/manager.hpp>
+#include <camoto/gamearchive/stream_checkpoint.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Amount of input to give each decoder at a time.
+#define CHECKPOINT_BUFFER_SIZE 4096
+
+CheckpointIndex::CheckpointIndex(stream::len interval)
+	:	lenInterval(std::max<stream::len>(interval, 1)),
+		lenSource(0),
+		generation(0),
+		sizeKnown(false),
+		lenDecoded(0)
+{
+}
+
+stream::len CheckpointIndex::interval() const
+{
+	return this->lenInterval;
+}
+
+std::size_t CheckpointIndex::count() const
+{
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->checkpoints.size();
+}
+
+input_checkpointed::input_checkpointed(std::unique_ptr<stream::input> source,
+	std::vector<FilterStage> decoders, std::shared_ptr<CheckpointIndex> index,
+	unsigned long generation)
+	:	source(std::move(source)),
+		filters(std::move(decoders)),
+		index(index),
+		offRead(0)
+{
+	this->lenSource = this->source->size();
+
+	// Checkpoints for a different version of the file are no use
+	std::lock_guard<std::mutex> guard(this->index->lock);
+	if (
+		(this->index->lenSource != this->lenSource)
+		|| (this->index->generation != generation)
+	) {
+		this->index->checkpoints.clear();
+		this->index->sizeKnown = false;
+		this->index->lenSource = this->lenSource;
+		this->index->generation = generation;
+	}
+}
+
+input_checkpointed::~input_checkpointed()
+{
+}
+
+stream::len input_checkpointed::try_read(uint8_t *buffer, stream::len len)
+{
+	if (this->current.stages.empty() || (this->current.offOut != this->offRead)) {
+		this->seekState(&this->current, this->offRead);
+	}
+	stream::len lenRead = this->decode(&this->current, buffer, len);
+	this->offRead += lenRead;
+	return lenRead;
+}
+
+void input_checkpointed::seekg(stream::delta off, stream::seek_from from)
+{
+	// Seeking past the end isn't caught here, as that would mean decoding the
+	// whole file to find its size.  Reads from there will just return no data.
+	stream::delta target;
+	switch (from) {
+		case stream::start: target = off; break;
+		case stream::cur: target = this->offRead + off; break;
+		case stream::end: target = this->size() + off; break;
+		default: throw stream::seek_error("Invalid seek origin");
+	}
+	if (target < 0) {
+		throw stream::seek_error("Attempt to seek to before start of file");
+	}
+	this->offRead = target;
+	return;
+}
+
+stream::pos input_checkpointed::tellg() const
+{
+	return this->offRead;
+}
+
+stream::len input_checkpointed::size() const
+{
+	{
+		std::lock_guard<std::mutex> guard(this->index->lock);
+		if (this->index->sizeKnown) return this->index->lenDecoded;
+	}
+
+	// Decode from the last checkpoint until the data runs out, which will save
+	// the size in the index.  This uses its own state so the read position is
+	// left alone.
+	State st;
+	this->seekState(&st, (stream::pos)-1);
+	return st.offOut;
+}
+
+void input_checkpointed::seekState(State *st, stream::pos target) const
+{
+	auto& idx = *this->index;
+	{
+		std::lock_guard<std::mutex> guard(idx.lock);
+		std::size_t k = std::min<stream::pos>(target / idx.lenInterval,
+			idx.checkpoints.size());
+		stream::pos offCheckpoint = k * idx.lenInterval;
+		if (
+			st->stages.empty()
+			|| (target < st->offOut)
+			|| (offCheckpoint > st->offOut)
+		) {
+			st->finished = false;
+			if (k == 0) {
+				// Start again from the beginning
+				st->stages.clear();
+				for (std::size_t i = 0; i < this->filters.size(); i++) {
+					auto decoder = this->filters[i].clone(*this->filters[i].decoder);
+					// Only the first decoder knows how much input it will get
+					decoder->reset((i == 0) ? this->lenSource : 0);
+					st->stages.push_back({decoder, {}, false});
+				}
+				st->offIn = 0;
+				st->offOut = 0;
+			} else {
+				const auto& cp = idx.checkpoints[k - 1];
+				st->stages = this->copyStages(cp.stages);
+				st->offIn = cp.offIn;
+				st->offOut = offCheckpoint;
+			}
+		}
+	}
+
+	// Decode and discard anything between there and the target
+	uint8_t skip[CHECKPOINT_BUFFER_SIZE];
+	while ((st->offOut < target) && !st->finished) {
+		this->decode(st, skip,
+			std::min<stream::pos>(target - st->offOut, sizeof(skip)));
+	}
+	return;
+}
+
+stream::len input_checkpointed::decode(State *st, uint8_t *out,
+	stream::len len) const
+{
+	auto& idx = *this->index;
+	stream::len lenDone = 0;
+	while ((lenDone < len) && !st->finished) {
+		// Stop at the next checkpoint so the state can be saved exactly there
+		stream::pos offNext = (st->offOut / idx.lenInterval + 1) * idx.lenInterval;
+		stream::len lenWant = std::min<stream::len>(len - lenDone,
+			offNext - st->offOut);
+		stream::len lenGot = this->pull(st, st->stages.size() - 1,
+			out + lenDone, lenWant);
+		if (lenGot == 0) {
+			st->finished = true;
+			std::lock_guard<std::mutex> guard(idx.lock);
+			idx.sizeKnown = true;
+			idx.lenDecoded = st->offOut;
+			break;
+		}
+		lenDone += lenGot;
+		st->offOut += lenGot;
+
+		if (st->offOut == offNext) {
+			std::lock_guard<std::mutex> guard(idx.lock);
+			// Checkpoints are always added in order, because decoding only ever
+			// starts from the last one before the read position.  If this one is
+			// already there, another stream got here first.
+			if (idx.checkpoints.size() == offNext / idx.lenInterval - 1) {
+				idx.checkpoints.push_back({st->offIn, this->copyStages(st->stages)});
+			}
+		}
+	}
+	return lenDone;
+}
+
+stream::len input_checkpointed::pull(State *st, std::size_t i, uint8_t *out,
+	stream::len len) const
+{
+	auto& stage = st->stages[i];
+	bool stuck = false;
+	for (;;) {
+		// Top up the decoder's input, allowing more than usual if it wasn't
+		// able to do anything with what it already had.
+		std::size_t lenPending = stage.pending.size();
+		if (!stage.eof && ((lenPending < CHECKPOINT_BUFFER_SIZE) || stuck)) {
+			stage.pending.resize(lenPending + CHECKPOINT_BUFFER_SIZE);
+			stream::len lenGot;
+			if (i == 0) {
+				this->source->seekg(st->offIn, stream::start);
+				lenGot = this->source->try_read(&stage.pending[lenPending],
+					CHECKPOINT_BUFFER_SIZE);
+				st->offIn += lenGot;
+			} else {
+				lenGot = this->pull(st, i - 1, &stage.pending[lenPending],
+					CHECKPOINT_BUFFER_SIZE);
+			}
+			stage.pending.resize(lenPending + lenGot);
+			if (lenGot == 0) stage.eof = true;
+		}
+
+		// Once the input has run out, an empty buffer tells the decoder to
+		// flush anything it's still holding on to.
+		stream::len lenIn = stage.pending.size();
+		stream::len lenOut = len;
+		stage.decoder->transform(out, &lenOut, stage.pending.data(), &lenIn);
+		stage.pending.erase(stage.pending.begin(),
+			stage.pending.begin() + lenIn);
+		if (lenOut) return lenOut;
+
+		// No output, so give it more input if there is any
+		if (stage.eof && (lenIn == 0)) return 0;
+		stuck = (lenIn == 0);
+	}
+}
+
+std::vector<CheckpointIndex::Stage> input_checkpointed::copyStages(
+	const std::vector<CheckpointIndex::Stage>& stages) const
+{
+	std::vector<CheckpointIndex::Stage> copy;
+	copy.reserve(stages.size());
+	for (std::size_t i = 0; i < stages.size(); i++) {
+		copy.push_back({
+			this->filters[i].clone(*stages[i].decoder),
+			stages[i].pending,
+			stages[i].eof,
+		});
+	}
+	return copy;
+}
+
+std::unique_ptr<stream::input> openCheckpointed(
+	std::shared_ptr<Archive> archive, const Archive::FileHandle& id,
+	std::shared_ptr<CheckpointIndex> index)
+{
+	if (!id->filter.empty()) {
+		auto pFilterType = FilterManager::byCode(id->filter);
+		if (pFilterType) {
+			auto decoders = pFilterType->decoders();
+			if (!decoders.empty()) {
+				return std::make_unique<input_checkpointed>(
+					archive->open(id, false), std::move(decoders), index,
+					id->generation);
+			}
+		}
+	}
+	// Unknown filters throw an error from here
+	return archive->open(id, true);
+}
+
+} // namespace gamearchive
+} // namespace camoto
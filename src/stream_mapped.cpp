@@ -0,0 +1,181 @@
+/**
+ * @file  stream_mapped.cpp
+ * @brief Read-only streams backed by memory or a memory-mapped file.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#ifdef WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <camoto/gamearchive/stream_mapped.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Work out the target of a seek, or throw if it is out of range.
+static stream::pos seekTarget(stream::pos cur, stream::len size,
+	stream::delta off, stream::seek_from from)
+{
+	stream::delta target;
+	switch (from) {
+		case stream::start: target = off; break;
+		case stream::cur: target = cur + off; break;
+		case stream::end: target = size + off; break;
+		default: throw stream::seek_error("Invalid seek origin");
+	}
+	if (target < 0) {
+		throw stream::seek_error("Attempt to seek to before start of file");
+	}
+	if ((stream::len)target > size) {
+		throw stream::seek_error("Attempt to seek past end of read-only file");
+	}
+	return target;
+}
+
+memory_view::memory_view(const uint8_t *base, stream::len len)
+	:	base(base),
+		lenData(len),
+		offRead(0),
+		offWrite(0)
+{
+}
+
+memory_view::~memory_view()
+{
+}
+
+mapped_file::mapped_file(const std::string& filename)
+	:	memory_view(nullptr, 0)
+{
+#ifdef WIN32
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file) throw stream::open_error("Unable to open " + filename);
+	this->lenData = file.tellg();
+	this->buffer.resize(this->lenData);
+	file.seekg(0, std::ios::beg);
+	if (!file.read((char *)this->buffer.data(), this->lenData)) {
+		throw stream::open_error("Unable to read " + filename);
+	}
+	this->base = this->buffer.data();
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw stream::open_error("Unable to open " + filename + ": "
+			+ strerror(errno));
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int e = errno;
+		::close(fd);
+		throw stream::open_error("Unable to get size of " + filename + ": "
+			+ strerror(e));
+	}
+	this->lenData = st.st_size;
+
+	// mmap() refuses to map zero bytes, but an empty file doesn't need mapping
+	// anyway.
+	if (this->lenData > 0) {
+		void *m = mmap(nullptr, this->lenData, PROT_READ, MAP_SHARED, fd, 0);
+		if (m == MAP_FAILED) {
+			int e = errno;
+			::close(fd);
+			throw stream::open_error("Unable to map " + filename + ": "
+				+ strerror(e));
+		}
+		this->base = (const uint8_t *)m;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+#ifndef WIN32
+	if (this->base) munmap((void *)this->base, this->lenData);
+#endif
+}
+
+stream::len memory_view::try_read(uint8_t *buffer, stream::len len)
+{
+	if (this->offRead >= this->lenData) return 0;
+	stream::len lenAvail = this->lenData - this->offRead;
+	if (len > lenAvail) len = lenAvail;
+	memcpy(buffer, this->base + this->offRead, len);
+	this->offRead += len;
+	return len;
+}
+
+void memory_view::seekg(stream::delta off, stream::seek_from from)
+{
+	this->offRead = seekTarget(this->offRead, this->lenData, off, from);
+	return;
+}
+
+stream::pos memory_view::tellg() const
+{
+	return this->offRead;
+}
+
+stream::len memory_view::size() const
+{
+	return this->lenData;
+}
+
+stream::len memory_view::try_write(const uint8_t *buffer, stream::len len)
+{
+	throw stream::write_error("Cannot write to a file opened read-only");
+}
+
+void memory_view::seekp(stream::delta off, stream::seek_from from)
+{
+	this->offWrite = seekTarget(this->offWrite, this->lenData, off, from);
+	return;
+}
+
+stream::pos memory_view::tellp() const
+{
+	return this->offWrite;
+}
+
+void memory_view::truncate(stream::len size)
+{
+	if (size == this->lenData) return;
+	throw stream::write_error("Cannot resize a file opened read-only");
+}
+
+void memory_view::flush()
+{
+	// Nothing can have been written, so there's nothing to do
+	return;
+}
+
+const uint8_t *memory_view::data() const
+{
+	return this->base;
+}
+
+} // namespace gamearchive
+} // namespace camoto
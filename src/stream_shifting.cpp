@@ -0,0 +1,412 @@
+/**
+ * @file  stream_shifting.cpp
+ * @brief Read/write file stream that can insert and remove data in place.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <camoto/gamearchive/stream_shifting.hpp>
+
+namespace camoto {
+namespace gamearchive {
+
+/// Size of the buffer used when data has to be copied.
+#define SHIFT_BUFFER_SIZE 65536
+
+/// Write exactly len bytes to a file descriptor at a given offset.
+static void writeFd(int fd, stream::pos offset, const uint8_t *buffer,
+	stream::len len)
+{
+	while (len) {
+		ssize_t lenWritten = pwrite(fd, buffer, len, offset);
+		if (lenWritten < 0) {
+			if (errno == EINTR) continue;
+			throw stream::write_error(std::string("Unable to write file: ")
+				+ strerror(errno));
+		}
+		buffer += lenWritten;
+		offset += lenWritten;
+		len -= lenWritten;
+	}
+	return;
+}
+
+/// Work out the target of a seek, or throw if it is before the start.
+/**
+ * Seeking past the end is allowed, as it is for any other file.  Writing
+ * there will extend the file, and reading will return no data.
+ */
+static stream::pos seekTarget(stream::pos cur, stream::len size,
+	stream::delta off, stream::seek_from from)
+{
+	stream::delta target;
+	switch (from) {
+		case stream::start: target = off; break;
+		case stream::cur: target = cur + off; break;
+		case stream::end: target = size + off; break;
+		default: throw stream::seek_error("Invalid seek origin");
+	}
+	if (target < 0) {
+		throw stream::seek_error("Attempt to seek to before start of file");
+	}
+	return target;
+}
+
+shifting_file::shifting_file(const std::string& filename)
+	:	filename(filename),
+		fd(-1),
+		offRead(0),
+		offWrite(0),
+		lenBlock(4096),
+		lenCopied(0),
+		detached(false),
+		lenDetach(0)
+{
+	this->fd = ::open(filename.c_str(), O_RDWR);
+	if (this->fd < 0) {
+		throw stream::open_error("Unable to open " + filename + ": "
+			+ strerror(errno));
+	}
+	struct stat st;
+	if ((fstat(this->fd, &st) == 0) && (st.st_blksize > 0)) {
+		this->lenBlock = st.st_blksize;
+	}
+}
+
+shifting_file::~shifting_file()
+{
+	if (this->fd >= 0) ::close(this->fd);
+}
+
+stream::len shifting_file::try_read(uint8_t *buffer, stream::len len)
+{
+	if (this->detached) {
+		memset(buffer, 0, len);
+		this->offRead += len;
+		return len;
+	}
+	ssize_t lenRead;
+	do {
+		lenRead = pread(this->fd, buffer, len, this->offRead);
+	} while ((lenRead < 0) && (errno == EINTR));
+	if (lenRead < 0) {
+		throw stream::read_error(std::string("Unable to read file: ")
+			+ strerror(errno));
+	}
+	this->offRead += lenRead;
+	return lenRead;
+}
+
+void shifting_file::seekg(stream::delta off, stream::seek_from from)
+{
+	this->offRead = seekTarget(this->offRead, this->size(), off, from);
+	return;
+}
+
+stream::pos shifting_file::tellg() const
+{
+	return this->offRead;
+}
+
+stream::len shifting_file::size() const
+{
+	if (this->detached) return this->lenDetach;
+	struct stat st;
+	if (fstat(this->fd, &st) < 0) {
+		throw stream::error(std::string("Unable to get file size: ")
+			+ strerror(errno));
+	}
+	return st.st_size;
+}
+
+stream::len shifting_file::try_write(const uint8_t *buffer, stream::len len)
+{
+	if (this->detached) {
+		this->offWrite += len;
+		return len;
+	}
+	ssize_t lenWritten;
+	do {
+		lenWritten = pwrite(this->fd, buffer, len, this->offWrite);
+	} while ((lenWritten < 0) && (errno == EINTR));
+	if (lenWritten < 0) {
+		throw stream::write_error(std::string("Unable to write file: ")
+			+ strerror(errno));
+	}
+	this->offWrite += lenWritten;
+	return lenWritten;
+}
+
+void shifting_file::seekp(stream::delta off, stream::seek_from from)
+{
+	this->offWrite = seekTarget(this->offWrite, this->size(), off, from);
+	return;
+}
+
+stream::pos shifting_file::tellp() const
+{
+	return this->offWrite;
+}
+
+void shifting_file::truncate(stream::len size)
+{
+	if (this->detached) {
+		this->lenDetach = size;
+		return;
+	}
+	if (ftruncate(this->fd, size) < 0) {
+		throw stream::write_error(std::string("Unable to resize file: ")
+			+ strerror(errno));
+	}
+	return;
+}
+
+void shifting_file::flush()
+{
+	// Nothing is buffered, everything goes straight to the file
+	return;
+}
+
+void shifting_file::insert(stream::pos offset, stream::len len)
+{
+	stream::len lenFile = this->size();
+	if (offset > lenFile) {
+		throw stream::seek_error("Attempt to insert data past end of file");
+	}
+	if (len == 0) return;
+
+#ifdef FALLOC_FL_INSERT_RANGE
+	if ((offset < lenFile) && (len % this->lenBlock == 0)) {
+		// The range has to start on a block boundary, so insert from the start
+		// of the block containing offset and then move the bytes before offset
+		// back down.
+		stream::pos offAligned = offset - offset % this->lenBlock;
+		if (fallocate(this->fd, FALLOC_FL_INSERT_RANGE, offAligned, len) == 0) {
+			stream::len lenHead = offset - offAligned;
+			this->copy(offAligned + len, offAligned, lenHead);
+			// The rest of the new space is already a hole full of zeroes
+			this->zero(offAligned + len, lenHead);
+			return;
+		}
+		// Not supported by this filesystem, so fall through and copy instead
+	}
+#endif
+
+	this->truncate(lenFile + len);
+	this->copy(offset, offset + len, lenFile - offset);
+	this->zero(offset, std::min(len, lenFile - offset));
+	return;
+}
+
+void shifting_file::remove(stream::pos offset, stream::len len)
+{
+	stream::len lenFile = this->size();
+	if (offset + len > lenFile) {
+		throw stream::seek_error("Attempt to remove data past end of file");
+	}
+	if (len == 0) return;
+
+#ifdef FALLOC_FL_COLLAPSE_RANGE
+	stream::pos offAligned = offset - offset % this->lenBlock;
+	// The range can't reach the end of the file, but then there's nothing to
+	// move anyway.
+	if ((offAligned + len < lenFile) && (len % this->lenBlock == 0)) {
+		// The range has to start on a block boundary, so remove from the start
+		// of the block containing offset and then put back the bytes before
+		// offset that went with it.
+		std::vector<uint8_t> head(offset - offAligned);
+		this->readAt(offAligned, head.data(), head.size());
+		if (fallocate(this->fd, FALLOC_FL_COLLAPSE_RANGE, offAligned, len) == 0) {
+			this->writeAt(offAligned, head.data(), head.size());
+			this->lenCopied += head.size();
+			return;
+		}
+		// Not supported by this filesystem, so fall through and copy instead
+	}
+#endif
+
+	this->copy(offset + len, offset, lenFile - offset - len);
+	this->truncate(lenFile - len);
+	return;
+}
+
+stream::len shifting_file::blockSize() const
+{
+	return this->lenBlock;
+}
+
+stream::len shifting_file::bytesCopied() const
+{
+	return this->lenCopied;
+}
+
+bool shifting_file::rewrite(stream::input& src)
+{
+	struct stat st;
+	if (fstat(this->fd, &st) < 0) {
+		throw stream::error(std::string("Unable to get file size: ")
+			+ strerror(errno));
+	}
+
+	// Renaming over the name would turn a symlink into a separate file, and
+	// leave any other hard links pointing at the old copy.
+	if (st.st_nlink > 1) return false;
+	struct stat stName;
+	if (
+		(lstat(this->filename.c_str(), &stName) < 0)
+		|| S_ISLNK(stName.st_mode)
+		|| (stName.st_dev != st.st_dev)
+		|| (stName.st_ino != st.st_ino)
+	) {
+		return false;
+	}
+
+	std::string tempName = this->filename + ".XXXXXX";
+	int fdTemp = mkstemp(&tempName[0]);
+	if (fdTemp < 0) return false;
+
+	// mkstemp() makes a file only the owner can access.  If the original's
+	// owner or permissions can't be copied, it's better to leave it in place.
+	// The owner goes first, as changing it can clear the setuid bits.
+	if (
+		(fchown(fdTemp, st.st_uid, st.st_gid) < 0)
+		|| (fchmod(fdTemp, st.st_mode & 07777) < 0)
+	) {
+		::close(fdTemp);
+		unlink(tempName.c_str());
+		return false;
+	}
+
+	// src may well be reading from this stream (e.g. a stream::seg on top of
+	// it) so this->fd must keep pointing at the original file until the new
+	// copy is complete.
+	try {
+		std::vector<uint8_t> buffer(SHIFT_BUFFER_SIZE);
+		stream::pos off = 0;
+		src.seekg(0, stream::start);
+		for (;;) {
+			stream::len lenRead = src.try_read(buffer.data(), buffer.size());
+			if (lenRead == 0) break;
+			writeFd(fdTemp, off, buffer.data(), lenRead);
+			off += lenRead;
+		}
+		if (fsync(fdTemp) < 0) {
+			throw stream::write_error(std::string("Unable to sync file: ")
+				+ strerror(errno));
+		}
+		if (::rename(tempName.c_str(), this->filename.c_str()) < 0) {
+			throw stream::write_error(std::string("Unable to replace file: ")
+				+ strerror(errno));
+		}
+	} catch (...) {
+		::close(fdTemp);
+		unlink(tempName.c_str());
+		throw;
+	}
+	::close(this->fd);
+	this->fd = fdTemp;
+
+	// Make sure the rename itself has reached the disk too.  If it hasn't, a
+	// crash will only lose the new copy, so there's nothing to do on error.
+	std::string::size_type slash = this->filename.find_last_of('/');
+	std::string dir = (slash == std::string::npos)
+		? "." : this->filename.substr(0, slash + 1);
+	int fdDir = ::open(dir.c_str(), O_RDONLY);
+	if (fdDir >= 0) {
+		fsync(fdDir);
+		::close(fdDir);
+	}
+	return true;
+}
+
+void shifting_file::setDetached(bool detach)
+{
+	if (detach && !this->detached) this->lenDetach = this->size();
+	this->detached = detach;
+	return;
+}
+
+void shifting_file::copy(stream::pos from, stream::pos to, stream::len len)
+{
+	std::vector<uint8_t> buffer(std::min<stream::len>(len, SHIFT_BUFFER_SIZE));
+	stream::len lenDone = 0;
+	while (lenDone < len) {
+		stream::len lenChunk = std::min<stream::len>(len - lenDone, buffer.size());
+		// Moving data up has to start from the end, so nothing is overwritten
+		// before it has been copied.
+		stream::pos offChunk = (to > from) ? len - lenDone - lenChunk : lenDone;
+		this->readAt(from + offChunk, buffer.data(), lenChunk);
+		this->writeAt(to + offChunk, buffer.data(), lenChunk);
+		lenDone += lenChunk;
+	}
+	this->lenCopied += len;
+	return;
+}
+
+void shifting_file::zero(stream::pos offset, stream::len len)
+{
+	std::vector<uint8_t> buffer(std::min<stream::len>(len, SHIFT_BUFFER_SIZE));
+	stream::len lenDone = 0;
+	while (lenDone < len) {
+		stream::len lenChunk = std::min<stream::len>(len - lenDone, buffer.size());
+		this->writeAt(offset + lenDone, buffer.data(), lenChunk);
+		lenDone += lenChunk;
+	}
+	return;
+}
+
+void shifting_file::readAt(stream::pos offset, uint8_t *buffer,
+	stream::len len)
+{
+	while (len) {
+		ssize_t lenRead = pread(this->fd, buffer, len, offset);
+		if (lenRead < 0) {
+			if (errno == EINTR) continue;
+			throw stream::read_error(std::string("Unable to read file: ")
+				+ strerror(errno));
+		}
+		if (lenRead == 0) {
+			throw stream::read_error("Unexpected end of file");
+		}
+		buffer += lenRead;
+		offset += lenRead;
+		len -= lenRead;
+	}
+	return;
+}
+
+void shifting_file::writeAt(stream::pos offset, const uint8_t *buffer,
+	stream::len len)
+{
+	writeFd(this->fd, offset, buffer, len);
+	return;
+}
+
+} // namespace gamearchive
+} // namespace camoto
+
+#endif // WIN32
@@ -18,8 +18,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #define BOOST_FILESYSTEM_VERSION 3
 #include <boost/filesystem.hpp>
+#include <camoto/stream_file.hpp>
 
 #include <camoto/gamearchive/util.hpp>
 #include <camoto/gamearchive/archive-fat.hpp>
@@ -102,6 +106,73 @@ void findFile(std::shared_ptr<Archive> *pArchive,
 	return;
 }
 
+/// Largest buffer extractOne() will allocate for a filtered file.
+#define EXTRACT_BUFFER_MAX (16 * 1024 * 1024)
+
+/// Extract a single file for extractFiles().
+static void extractOne(Archive& archive, ExtractJob& job, bool useFilters)
+{
+	try {
+		auto pfsIn = archive.open(job.id, useFilters);
+		stream::output_file fsOut(job.target, true);
+		if (useFilters && !job.id->filter.empty()) {
+			// Ask for the whole file in one read, so it can be decoded in one go.
+			// realSize comes from the archive and can't be trusted, so larger files
+			// are read a buffer at a time instead.
+			std::vector<uint8_t> buffer(
+				std::min<stream::len>(job.id->realSize, EXTRACT_BUFFER_MAX));
+			for (;;) {
+				stream::len lenRead = pfsIn->try_read(buffer.data(), buffer.size());
+				if (lenRead == 0) break;
+				fsOut.write(buffer.data(), lenRead);
+			}
+		}
+		// Copy anything left over, e.g. if realSize was too small
+		stream::copy(fsOut, *pfsIn);
+		fsOut.flush();
+		job.success = true;
+	} catch (const std::exception& e) {
+		job.success = false;
+		job.error = e.what();
+	} catch (...) {
+		// This may be running on a worker thread, where anything escaping would
+		// end the whole program.
+		job.success = false;
+		job.error = "Unknown error";
+	}
+	return;
+}
+
+bool extractFiles(std::shared_ptr<Archive> archive,
+	std::vector<ExtractJob>& jobs, bool useFilters, unsigned int numThreads)
+{
+	if (!archive->canReadConcurrently()) numThreads = 1;
+	if (numThreads > jobs.size()) numThreads = jobs.size();
+
+	if (numThreads <= 1) {
+		for (auto& i : jobs) extractOne(*archive, i, useFilters);
+	} else {
+		// Each worker claims the next job in the list until there are none left.
+		std::atomic<std::size_t> nextJob(0);
+		auto worker = [&]() {
+			for (;;) {
+				std::size_t j = nextJob++;
+				if (j >= jobs.size()) break;
+				extractOne(*archive, jobs[j], useFilters);
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads);
+		for (unsigned int t = 0; t < numThreads; t++) threads.emplace_back(worker);
+		for (auto& t : threads) t.join();
+	}
+
+	for (const auto& i : jobs) {
+		if (!i.success) return false;
+	}
+	return true;
+}
+
 void preventResize(stream::output_sub* sub, stream::len len)
 {
 	throw stream::write_error("This file is a fixed size, it cannot be made "
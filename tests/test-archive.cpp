@@ -18,11 +18,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <functional>
+#include <thread>
+#ifndef WIN32
+#include <sys/stat.h> // stat
+#endif
 #include <camoto/util.hpp>
 #include <camoto/gamearchive/archive-fat.hpp> // Archive_FAT::FATEntry
 #include <camoto/gamearchive/fixedarchive.hpp> // FixedArchive::FixedEntry
+#include <camoto/gamearchive/stream_shifting.hpp>
 #include "test-archive.hpp"
 
 using namespace camoto;
@@ -84,9 +93,15 @@ void test_archive::addTests()
 {
 	// Tests on existing archives (in the initial state)
 	ADD_ARCH_TEST(false, &test_archive::test_isinstance_others);
+	ADD_ARCH_TEST(false, &test_archive::test_detect);
 	if (!this->virtualFiles) {
 		ADD_ARCH_TEST(false, &test_archive::test_open);
 	}
+	if ((!this->virtualFiles) && (!this->staticFiles) && (!this->foldersOnly)) {
+		ADD_ARCH_TEST(false, &test_archive::test_open_mapped);
+		ADD_ARCH_TEST(false, &test_archive::test_concurrent_read);
+		ADD_ARCH_TEST(false, &test_archive::test_extract_parallel);
+	}
 	if (this->lenMaxFilename >= 0) {
 		// Only perform the rename test if the archive has filenames
 		ADD_ARCH_TEST(false, &test_archive::test_rename);
@@ -107,6 +122,9 @@ void test_archive::addTests()
 		ADD_ARCH_TEST(false, &test_archive::test_insert_remove);
 		ADD_ARCH_TEST(false, &test_archive::test_remove_insert);
 		ADD_ARCH_TEST(false, &test_archive::test_move);
+		if ((this->lenMaxFilename >= 0) && (!this->foldersOnly)) {
+			ADD_ARCH_TEST(false, &test_archive::test_find_duplicate);
+		}
 		if (this->lenFilesizeFixed < 0) {
 			// Only perform these tests if the archive's files can be resized
 			ADD_ARCH_TEST(false, &test_archive::test_resize_larger);
@@ -115,6 +133,12 @@ void test_archive::addTests()
 			ADD_ARCH_TEST(false, &test_archive::test_resize_after_close);
 			ADD_ARCH_TEST(false, &test_archive::test_insert_zero_then_resize);
 			ADD_ARCH_TEST(false, &test_archive::test_resize_over64k);
+#ifndef WIN32
+			if (!this->foldersOnly) {
+				ADD_ARCH_TEST(false, &test_archive::test_resize_shifting);
+				ADD_ARCH_TEST(false, &test_archive::test_flush_shadow);
+			}
+#endif
 		}
 		ADD_ARCH_TEST(false, &test_archive::test_remove_all_re_add);
 	}
@@ -134,6 +158,9 @@ void test_archive::addTests()
 			// Only perform these tests if the archive's files can be resized
 			ADD_ARCH_TEST(true, &test_archive::test_new_manipulate_zero_length_files);
 		}
+		if ((!this->foldersOnly) && ArchiveManager::byCode(this->type)->builder()) {
+			ADD_ARCH_TEST(true, &test_archive::test_build_initialstate);
+		}
 	}
 	return;
 }
@@ -304,25 +331,65 @@ void test_archive::populateSuppData()
 	return;
 }
 
+test_archive::temp_file::temp_file(test_archive& test,
+	const std::string& suffix)
+	:	filename(test.basename + "." + suffix + ".tmp"),
+		test(test)
+{
+	std::ofstream f(this->filename, std::ios::binary | std::ios::trunc);
+	f << test.content_12();
+}
+
+test_archive::temp_file::~temp_file()
+{
+	// Close (and unmap) the file before deleting it
+	this->test.pArchive.reset();
+	for (const auto& i : this->extras) std::remove(i.c_str());
+	std::remove(this->filename.c_str());
+}
+
+void test_archive::temp_file::open(std::function<std::shared_ptr<Archive>(
+	const std::string& filename, SuppData& suppData)> fnOpen)
+{
+	this->test.pArchive.reset();
+	this->test.populateSuppData();
+	this->test.pArchive = fnOpen(this->filename, this->test.suppData);
+	BOOST_REQUIRE_MESSAGE(this->test.pArchive,
+		"Could not open archive from " << this->filename);
+	return;
+}
+
+std::string test_archive::temp_file::extra(const std::string& suffix)
+{
+	this->extras.push_back(this->filename + "." + suffix);
+	return this->extras.back();
+}
+
 void test_archive::setAttributes()
+{
+	this->setAttributes(*this->pArchive);
+	return;
+}
+
+void test_archive::setAttributes(HasAttributes& target)
 {
 	int i = 0;
 	for (auto& a : this->attributes) {
 		switch (a.type) {
 			case Attribute::Type::Integer:
-				this->pArchive->attribute(i, a.integerValue);
+				target.attribute(i, a.integerValue);
 				break;
 			case Attribute::Type::Enum:
-				this->pArchive->attribute(i, a.enumValue);
+				target.attribute(i, a.enumValue);
 				break;
 			case Attribute::Type::Filename:
-				this->pArchive->attribute(i, a.filenameValue);
+				target.attribute(i, a.filenameValue);
 				break;
 			case Attribute::Type::Text:
-				this->pArchive->attribute(i, a.textValue);
+				target.attribute(i, a.textValue);
 				break;
 			case Attribute::Type::Image:
-				this->pArchive->attribute(i, a.imageIndex);
+				target.attribute(i, a.imageIndex);
 				break;
 		}
 		i++;
@@ -553,6 +620,60 @@ void test_archive::test_isinstance_others()
 	return;
 }
 
+void test_archive::test_detect()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Detect format with signature table");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	std::string raw = this->content_12();
+	stream::string content;
+	content << raw;
+
+	// If the format claims a signature, the test data had better contain it
+	auto sigs = pArchType->signatures();
+	if (!sigs.empty()) {
+		bool found = false;
+		for (const auto& i : sigs) {
+			if (raw.compare(i.offset, i.magic.length(), i.magic) == 0) found = true;
+		}
+		BOOST_CHECK_MESSAGE(found,
+			"None of the signatures for " << this->type << " are in the test data");
+	}
+
+	auto expected = pArchType->isInstance(content);
+	Detector detector;
+	auto results = detector.detect(content);
+
+	// Checking formats in parallel must give the same answer
+	auto resultsMT = detector.detect(content, 4);
+	BOOST_REQUIRE_EQUAL(resultsMT.size(), results.size());
+	for (unsigned int i = 0; i < results.size(); i++) {
+		BOOST_CHECK_EQUAL(resultsMT[i].type, results[i].type);
+		BOOST_CHECK_EQUAL(resultsMT[i].certainty, results[i].certainty);
+	}
+
+	bool otherDefinite = false;
+	for (const auto& i : results) {
+		if (i.type->code().compare(this->type) == 0) {
+			BOOST_CHECK_EQUAL(i.certainty, expected);
+			return;
+		}
+		if (i.certainty == ArchiveType::Certainty::DefinitelyYes) {
+			otherDefinite = true;
+		}
+	}
+
+	// Only acceptable if the format doesn't recognise its own data (e.g. it
+	// needs supp data) or a format known to give false matches got in first.
+	BOOST_CHECK_MESSAGE(
+		(expected == ArchiveType::Certainty::DefinitelyNo) || otherDefinite,
+		"Detector didn't report " << this->type << " for its own test data"
+	);
+	return;
+}
+
 void test_archive::test_open()
 {
 	BOOST_TEST_MESSAGE(this->basename << ": Opening file in archive");
@@ -586,6 +707,154 @@ void test_archive::test_open()
 	// No changes, so no flush
 }
 
+void test_archive::test_open_mapped()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Open archive read-only");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	// Reopen the archive from a real file, so it can be mapped, instead of the
+	// string stream
+	temp_file file(*this, "mapped");
+	file.open([&](const std::string& filename, SuppData& suppData) {
+		return pArchType->openReadOnly(filename, suppData);
+	});
+
+	auto ep = this->findFile(0);
+	auto data = this->pArchive->mappedData(ep);
+	BOOST_REQUIRE_MESSAGE(data, "File data in read-only archive isn't mapped");
+
+	// The mapped data should be the same as what's read via a normal stream
+	{
+		auto pfsIn = this->pArchive->open(ep, false);
+		stream::string out;
+		stream::copy(out, *pfsIn);
+		BOOST_CHECK_MESSAGE(
+			this->is_equal(out.data,
+				std::string((const char *)data, ep->storedSize)),
+			"Mapped file data doesn't match file content"
+		);
+	}
+
+	BOOST_CHECK_THROW(this->pArchive->remove(ep), stream::error);
+
+	auto attrs = this->pArchive->attributes();
+	if (!attrs.empty()) {
+		if (attrs[0].type == Attribute::Type::Text) {
+			BOOST_CHECK_THROW(this->pArchive->attribute(0, attrs[0].textValue),
+				stream::error);
+		} else if (attrs[0].type == Attribute::Type::Integer) {
+			BOOST_CHECK_THROW(this->pArchive->attribute(0, attrs[0].integerValue),
+				stream::error);
+		} else if (attrs[0].type == Attribute::Type::Enum) {
+			BOOST_CHECK_THROW(this->pArchive->attribute(0,
+				(int)attrs[0].enumValue), stream::error);
+		}
+	}
+}
+
+void test_archive::test_concurrent_read()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Read read-only archive from many "
+		"threads at once");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	temp_file file(*this, "threads");
+	file.open([&](const std::string& filename, SuppData& suppData) {
+		return pArchType->openReadOnly(filename, suppData);
+	});
+
+	Archive::FileHandle ep[2];
+	ep[0] = this->findFile(0);
+	ep[1] = this->findFile(1);
+
+	// Boost.Test isn't thread safe, so the threads only count failures and the
+	// checks are done once they have all finished.
+	std::atomic<unsigned int> failures(0);
+	std::shared_ptr<Archive> arch = this->pArchive;
+	auto reader = [&](unsigned int seed) {
+		try {
+			for (unsigned int i = 0; i < 100; i++) {
+				unsigned int n = (seed + i) % 2;
+				if (!arch->isValid(ep[n])) {
+					failures++;
+					continue;
+				}
+				if (
+					(this->lenMaxFilename >= 0)
+					&& (arch->find(this->filename[n]) != ep[n])
+				) {
+					failures++;
+					continue;
+				}
+				auto pfsIn = arch->open(ep[n], true);
+
+				// Read the second half first, so each stream's position is moved
+				// around while the other threads are reading.
+				const std::string& expected = this->content[n];
+				std::string actual(expected.length(), '\0');
+				stream::len half = expected.length() / 2;
+				pfsIn->seekg(half, stream::start);
+				pfsIn->read((uint8_t *)&actual[half], expected.length() - half);
+				pfsIn->seekg(0, stream::start);
+				pfsIn->read((uint8_t *)&actual[0], half);
+				if (actual != expected) failures++;
+			}
+		} catch (...) {
+			failures++;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < 8; t++) threads.emplace_back(reader, t);
+	for (auto& t : threads) t.join();
+
+	BOOST_CHECK_MESSAGE(failures == 0,
+		createString("Concurrent reads failed " << failures << " times"));
+}
+
+void test_archive::test_extract_parallel()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Extract files on multiple threads");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	temp_file file(*this, "extract");
+	file.open([&](const std::string& filename, SuppData& suppData) {
+		return pArchType->openReadOnly(filename, suppData);
+	});
+	BOOST_REQUIRE(this->pArchive->canReadConcurrently());
+
+	// Extract each file several times so there's more work than threads
+	std::vector<ExtractJob> jobs;
+	for (unsigned int j = 0; j < 8; j++) {
+		ExtractJob job;
+		job.id = this->findFile(j % 2);
+		job.target = file.extra(createString(j));
+		job.success = false;
+		jobs.push_back(job);
+	}
+
+	bool ok = extractFiles(this->pArchive, jobs, true, 4);
+	BOOST_CHECK_MESSAGE(ok, "extractFiles() reported a failure");
+
+	for (unsigned int j = 0; j < jobs.size(); j++) {
+		BOOST_CHECK_MESSAGE(jobs[j].success,
+			createString("Extracting file " << j << " failed: " << jobs[j].error));
+		std::ifstream f(jobs[j].target, std::ios::binary);
+		std::string actual((std::istreambuf_iterator<char>(f)),
+			std::istreambuf_iterator<char>());
+		BOOST_CHECK_MESSAGE(
+			this->is_equal(this->content[j % 2], actual),
+			createString("Extracted file " << j << " has the wrong content")
+		);
+	}
+}
+
 void test_archive::test_rename()
 {
 	BOOST_TEST_MESSAGE(this->basename << ": Renaming file inside archive");
@@ -597,6 +866,13 @@ void test_archive::test_rename()
 
 	this->pArchive->rename(ep, this->filename[2]);
 
+	// Make sure the file can only be found under its new name
+	BOOST_CHECK_MESSAGE(!this->pArchive->isValid(
+		this->pArchive->find(this->filename[0])),
+		"File can still be found under its old name after a rename");
+	BOOST_CHECK_MESSAGE(this->pArchive->find(this->filename[2]) == ep,
+		"File can't be found under its new name after a rename");
+
 	this->checkData(&test_archive::content_1r2,
 		"Error renaming file");
 }
@@ -886,6 +1162,35 @@ void test_archive::test_remove_open()
 	);
 }
 
+void test_archive::test_find_duplicate()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Finding files with duplicate names");
+
+	auto ep1 = this->findFile(0);
+
+	// Add a second file with the same name at the end of the archive
+	auto epDup = this->pArchive->insert(nullptr, this->filename[0],
+		this->content[0].length(), this->insertType, this->insertAttr);
+
+	BOOST_REQUIRE_MESSAGE(this->pArchive->isValid(epDup),
+		"Couldn't create new file in sample archive");
+
+	// The original file comes first so it should still be the one found
+	BOOST_CHECK_MESSAGE(this->pArchive->find(this->filename[0]) == ep1,
+		"Duplicate filename appended to the archive was found instead of the "
+		"original file");
+
+	// Once the original is gone, the duplicate should be found instead
+	this->pArchive->remove(ep1);
+	BOOST_CHECK_MESSAGE(this->pArchive->find(this->filename[0]) == epDup,
+		"Remaining duplicate couldn't be found after removing the original file");
+
+	this->pArchive->remove(epDup);
+	BOOST_CHECK_MESSAGE(!this->pArchive->isValid(
+		this->pArchive->find(this->filename[0])),
+		"Removed file could still be found");
+}
+
 void test_archive::test_insert_remove()
 {
 	BOOST_TEST_MESSAGE(this->basename << ": Insert then remove file from archive");
@@ -1196,6 +1501,39 @@ void test_archive::test_remove_all_re_add()
 	);
 }
 
+void test_archive::test_build_initialstate()
+{
+	BOOST_TEST_MESSAGE(this->basename << ": Building archive in one pass");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+	auto builder = pArchType->builder();
+	BOOST_REQUIRE(builder);
+
+	this->setAttributes(*builder);
+
+	std::vector<ArchiveBuilder::Entry> files;
+	for (unsigned int i = 0; i < 2; i++) {
+		const std::string& data = this->content[i];
+		files.push_back({
+			this->filename[i], data.length(), this->insertType, this->insertAttr,
+			[&data]() {
+				return std::make_unique<stream::string>(data);
+			}
+		});
+	}
+
+	// The empty archive created for this test has taken the original suppData
+	this->populateSuppData();
+	stream::string out;
+	builder->write(out, files, this->suppData);
+
+	BOOST_CHECK_MESSAGE(
+		this->is_equal(this->content_12(), out.data),
+		"Error building archive in one pass"
+	);
+}
+
 // The function shifting files can get confused if a zero-length file is
 // inserted, incorrectly moving it because of the zero size.
 void test_archive::test_insert_zero_then_resize()
@@ -1257,6 +1595,144 @@ void test_archive::test_resize_over64k()
 	}
 }
 
+void test_archive::test_resize_shifting()
+{
+#ifndef WIN32
+	BOOST_TEST_MESSAGE(this->basename << ": Enlarge and shrink a file by whole "
+		"blocks in an archive opened from a shifting_file");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	temp_file file(*this, "shifting");
+	stream::len lenGrow = 0;
+	file.open([&](const std::string& filename, SuppData& suppData) {
+		auto content = std::make_unique<shifting_file>(filename);
+		lenGrow = content->blockSize() * 2;
+		return pArchType->open(std::move(content), suppData);
+	});
+
+	// Read a file's stored data, without any filter
+	auto readRaw = [this](const Archive::FileHandle& id) {
+		auto pfsIn = this->pArchive->open(id, false);
+		stream::string out;
+		stream::copy(out, *pfsIn);
+		return out.data;
+	};
+
+	// Growing and then shrinking by the same amount should put everything back
+	// the way it was, whether or not the filesystem can shift the data itself.
+	auto ep = this->findFile(0);
+	stream::len origStored = ep->storedSize;
+	stream::len origReal = ep->realSize;
+	std::string orig0 = readRaw(ep);
+	std::string orig1 = readRaw(this->findFile(1));
+
+	this->pArchive->resize(ep, origStored + lenGrow, origReal + lenGrow);
+	this->pArchive->flush();
+
+	// The new space must be zeroed, and the file after it moved intact
+	BOOST_CHECK_MESSAGE(
+		this->is_equal(orig0 + std::string(lenGrow, '\0'), readRaw(ep)),
+		"Enlarged file wasn't zero-filled after growing it by whole blocks"
+	);
+	BOOST_CHECK_MESSAGE(
+		this->is_equal(orig1, readRaw(this->findFile(1))),
+		"Following file changed after growing the one before it by whole blocks"
+	);
+
+	this->pArchive->resize(ep, origStored, origReal);
+	this->pArchive->flush();
+	this->pArchive.reset();
+
+	std::ifstream f(file.filename, std::ios::binary);
+	std::string result((std::istreambuf_iterator<char>(f)),
+		std::istreambuf_iterator<char>());
+
+	BOOST_CHECK_MESSAGE(
+		this->is_equal(this->content_12(), result),
+		"Archive changed after growing and shrinking a file by whole blocks"
+	);
+#endif
+}
+
+void test_archive::test_flush_shadow()
+{
+#ifndef WIN32
+	BOOST_TEST_MESSAGE(this->basename << ": Flush enough changes to an archive "
+		"opened from a shifting_file that it gets rewritten");
+
+	auto pArchType = ArchiveManager::byCode(this->type);
+	BOOST_REQUIRE_MESSAGE(pArchType, "Could not find archive type " + this->type);
+
+	temp_file file(*this, "shadow");
+	struct stat stBefore;
+	BOOST_REQUIRE_EQUAL(stat(file.filename.c_str(), &stBefore), 0);
+
+	// Grow by more than the whole archive, so there is more to move than to
+	// rewrite, but not by whole blocks so the filesystem can't move it either.
+	stream::len lenGrow = this->content_12().length();
+	file.open([&](const std::string& filename, SuppData& suppData) {
+		auto content = std::make_unique<shifting_file>(filename);
+		if (lenGrow % content->blockSize() == 0) lenGrow++;
+		return pArchType->open(std::move(content), suppData);
+	});
+
+	auto ep = this->findFile(0);
+	stream::len origStored = ep->storedSize;
+	stream::len origReal = ep->realSize;
+	this->pArchive->resize(ep, origStored + lenGrow, origReal + lenGrow);
+	this->pArchive->resize(ep, origStored, origReal);
+	this->pArchive->flush();
+
+	struct stat stAfter;
+	BOOST_REQUIRE_EQUAL(stat(file.filename.c_str(), &stAfter), 0);
+	if (std::dynamic_pointer_cast<Archive_FAT>(this->pArchive)) {
+		// Archive_FAT gets the shifting_file directly, so it must have chosen to
+		// rewrite the archive.
+		BOOST_CHECK_MESSAGE(stBefore.st_ino != stAfter.st_ino,
+			"Archive was changed in place instead of being rewritten");
+	} else {
+		// Other formats can't tell their content is a shifting_file.
+		BOOST_WARN_MESSAGE(stBefore.st_ino != stAfter.st_ino,
+			"Archive was changed in place instead of being rewritten");
+	}
+
+	// The new copy must be complete before anything else touches it.
+	{
+		std::ifstream f(file.filename, std::ios::binary);
+		std::string rewritten((std::istreambuf_iterator<char>(f)),
+			std::istreambuf_iterator<char>());
+		BOOST_REQUIRE_MESSAGE(
+			this->is_equal(this->content_12(), rewritten),
+			"Archive changed after growing and shrinking a file and rewriting it"
+		);
+
+		this->populateSuppData();
+		auto pReopened = pArchType->open(
+			std::make_unique<stream::string>(rewritten), this->suppData);
+		BOOST_REQUIRE_EQUAL(pReopened->files().size(),
+			this->pArchive->files().size());
+	}
+
+	// A small change afterwards should go to the new file.
+	this->pArchive->resize(ep, origStored + 1, origReal + 1);
+	this->pArchive->flush();
+	this->pArchive->resize(ep, origStored, origReal);
+	this->pArchive->flush();
+	this->pArchive.reset();
+
+	std::ifstream f(file.filename, std::ios::binary);
+	std::string result((std::istreambuf_iterator<char>(f)),
+		std::istreambuf_iterator<char>());
+
+	BOOST_CHECK_MESSAGE(
+		this->is_equal(this->content_12(), result),
+		"Archive changed after further edits to the rewritten file"
+	);
+#endif
+}
+
 void test_archive::test_shortext()
 {
 	BOOST_TEST_MESSAGE(this->basename << ": Rename a file with a short extension");
@@ -71,7 +71,11 @@ class test_archive: public test_main
 			unsigned int index);
 
 		virtual void test_isinstance_others();
+		void test_detect();
 		void test_open();
+		void test_open_mapped();
+		void test_concurrent_read();
+		void test_extract_parallel();
 		void test_rename();
 		void test_rename_long();
 		void test_insert_long();
@@ -81,6 +85,7 @@ class test_archive: public test_main
 		void test_remove();
 		void test_remove2();
 		void test_remove_open();
+		void test_find_duplicate();
 		void test_insert_remove();
 		void test_remove_insert();
 		void test_move();
@@ -91,12 +96,15 @@ class test_archive: public test_main
 		void test_remove_all_re_add();
 		void test_insert_zero_then_resize();
 		void test_resize_over64k();
+		void test_resize_shifting();
+		void test_flush_shadow();
 		void test_shortext();
 		void test_attributes();
 
 		virtual void test_new_isinstance();
 		virtual void test_new_to_initialstate();
 		void test_new_manipulate_zero_length_files();
+		void test_build_initialstate();
 
 	protected:
 		/// Initial state.
@@ -178,9 +186,49 @@ class test_archive: public test_main
 		 */
 		void populateSuppData();
 
-		/// Set the attributes supplied by the test case.
+		/// content_12() written out to a real file for the duration of a test.
+		/**
+		 * The file is removed again when this goes out of scope, so it is cleaned
+		 * up even if a BOOST_REQUIRE fails part way through the test.
+		 */
+		class temp_file
+		{
+			public:
+				/// Write content_12() to <basename>.<suffix>.tmp.
+				temp_file(test_archive& test, const std::string& suffix);
+
+				/// Close pArchive, then remove the file and any extra() ones.
+				~temp_file();
+
+				/// Replace pArchive with one opened from the file.
+				/**
+				 * @param fnOpen
+				 *   Called with the filename and freshly populated suppData, to open
+				 *   the archive however the test needs.
+				 */
+				void open(std::function<std::shared_ptr<Archive>(
+					const std::string& filename, SuppData& suppData)> fnOpen);
+
+				/// Name another file to be removed along with this one.
+				std::string extra(const std::string& suffix);
+
+				const std::string filename; ///< Name of the temporary file
+
+			protected:
+				test_archive& test;              ///< Test the file belongs to
+				std::vector<std::string> extras; ///< Other files to remove
+		};
+
+		/// Set the attributes supplied by the test case on the archive.
 		void setAttributes();
 
+		/// Set the attributes supplied by the test case.
+		/**
+		 * @param target
+		 *   Object to set the attributes on, e.g. an ArchiveBuilder.
+		 */
+		void setAttributes(HasAttributes& target);
+
 		/// Check if all supp data streams match the expected values.
 		/**
 		 * @param fnExpected
@@ -0,0 +1,148 @@
+/**
+ * @file   test-filter-bash.cpp
+ * @brief  Test code for Monster Bash LZW+RLE compression.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <camoto/bitstream.hpp>
+#include <camoto/filter-lzw.hpp>
+#include "test-filter.hpp"
+#include "../src/filter-bash.hpp"
+#include "../src/filter-bash-rle.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+class test_filter_bash: public test_filter
+{
+	public:
+		test_filter_bash()
+		{
+			this->type = "lzw-bash";
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// Same data as in the compressed .DAT archive tests
+			this->content("literal", 15, STRING_WITH_NULLS(
+				"\x54\xD0\xA4\x99\x03\x22\xCD\x1C" "\x10\x6F\xDC\x94\x71\x41\x26\x0C"
+				"\x1D\x80"
+			), STRING_WITH_NULLS(
+				"This is one.dat"
+			));
+
+			{
+				// Runs go through the RLE stage, split up if they are too long for
+				// one count, and the RLE event byte is escaped.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 0x90, 0xFF, 0x90, 0x2E, 0x90, 0x00, 256
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content("rle", 1+300+1, exp->data,
+					STRING_WITH_NULLS("A")
+					+ std::string(300, 'B')
+					+ STRING_WITH_NULLS("\x90")
+				);
+			}
+
+			{
+				// Codewords widen to 10 bits once 9 bits can't hold the next
+				// dictionary entry.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				std::string plain;
+				for (unsigned int i = 0; i < 300; i++) {
+					plain += (char)(i & 0x7F);
+					bit_exp.write((i < 256) ? 9 : 10, i & 0x7F);
+				}
+				bit_exp.write(10, 256);
+				bit_exp.flushByte();
+
+				this->content("widen", 300, exp->data, plain);
+			}
+
+			{
+				// Dictionary codewords, including one used in the same step it is
+				// added to the dictionary.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 257, 259, 256
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content_decode("dictionary", exp->data, STRING_WITH_NULLS(
+					"ABABABA"
+				));
+			}
+
+			{
+				// RLE events both split across LZW strings and within a single one
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 0x90, 0x04, 'C', 259, 256
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content_decode("rle_dictionary", exp->data, STRING_WITH_NULLS(
+					"ABBBBCCCC"
+				));
+			}
+
+			{
+				// Long enough to fill the dictionary
+				std::string plain;
+				for (unsigned int i = 0; i < 40000; i++) {
+					if (i % 1000 < 400) plain += (char)(i / 1000);
+					else plain += (char)((i * 7) ^ (i >> 5));
+				}
+				this->content_roundtrip("long", plain);
+			}
+			this->content_roundtrip("varied", test_filter::varied(LZW_LONG_LEN));
+
+			// Seeking within a file by resuming from saved decoder states
+			this->content_checkpoint("varied", test_filter::varied(20000));
+
+			ADD_FILTER_TEST(&test_filter_bash::reference);
+		}
+
+		/// Compare against libgamecommon's LZW filters with the RLE stage
+		void reference()
+		{
+			this->lzw_reference<LZWParams_Bash>(
+				std::make_shared<filter_bash_rle>(),
+				std::make_shared<filter_bash_unrle>()
+			);
+		}
+};
+
+IMPLEMENT_TESTS(filter_bash);
@@ -381,6 +381,32 @@ class test_filter_ddave_rle: public test_filter
 				"\x82\x80\x80\x81\x82\x83\x84\x85\x85\x87\x87\x87\x86\x84\x83\x83"
 			);
 			this->content("splitbuf_escape3", 3968 + 62 + 3 + 64, c, p);
+
+			ADD_FILTER_TEST(&test_filter_ddave_rle::decode_all_size);
+		}
+
+		/// Decoding in one go must not trust a size the data can't produce
+		void decode_all_size()
+		{
+			auto filterType = FilterManager::byCode(this->type);
+			std::vector<uint8_t> out;
+
+			// Largest possible expansion of the data is accepted
+			std::string full = STRING_WITH_NULLS("\x82\x00\x00\x00" "\x7F\x41");
+			BOOST_REQUIRE(filterType->decodeAll((const uint8_t *)full.data(),
+				full.length(), &out));
+			BOOST_CHECK_EQUAL(out.size(), 0x82);
+
+			// Sizes of 2GB and over, and ones bigger than the data can expand to,
+			// are left to the stream
+			for (const auto& data : {
+				STRING_WITH_NULLS("\x00\x00\x00\x80" "\x7F\x41"),
+				STRING_WITH_NULLS("\xFF\xFF\xFF\xFF" "\x7F\x41"),
+				STRING_WITH_NULLS("\x83\x00\x00\x00" "\x7F\x41"),
+			}) {
+				BOOST_CHECK(!filterType->decodeAll((const uint8_t *)data.data(),
+					data.length(), &out));
+			}
 		}
 
 		std::string encoded1()
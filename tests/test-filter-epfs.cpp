@@ -0,0 +1,113 @@
+/**
+ * @file   test-filter-epfs.cpp
+ * @brief  Test code for East Point Software EPFS decompression.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <camoto/bitstream.hpp>
+#include <camoto/filter-lzw.hpp>
+#include "test-filter.hpp"
+#include "../src/filter-epfs.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+class test_filter_epfs: public test_filter
+{
+	public:
+		test_filter_epfs()
+		{
+			this->type = "lzw-epfs";
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// First codeword is past the end of the dictionary
+			this->invalidContent(STRING_WITH_NULLS(
+				"\x96\x00"
+			));
+
+			{
+				// Dictionary codewords, including one used in the same step it is
+				// added to the dictionary, then the EOF codeword.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::bigEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 256, 258, 511
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content_decode("dictionary", exp->data, STRING_WITH_NULLS(
+					"ABABABA"
+				));
+			}
+
+			{
+				// Dictionary reset, which is one less than the EOF codeword
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::bigEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 510, 'C', 256, 511
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content_decode("reset", exp->data, STRING_WITH_NULLS(
+					"ABCCC"
+				));
+			}
+
+			{
+				// Codewords widen to 10 bits before the dictionary reaches the two
+				// reserved codewords, which then move to the top of the new size.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::bigEndian);
+				std::string plain;
+				for (unsigned int i = 0; i < 300; i++) {
+					plain += (char)(i & 0x7F);
+					bit_exp.write((i < 255) ? 9 : 10, i & 0x7F);
+				}
+				bit_exp.write(10, 1023);
+				bit_exp.flushByte();
+
+				this->content_decode("widen", exp->data, plain);
+			}
+
+			// Seeking within a file by resuming from saved decoder states
+			this->content_checkpoint("varied", test_filter::varied(20000));
+
+			// Long enough that the encoder runs past the largest codeword size
+			this->content_roundtrip("long", test_filter::varied(LZW_LONG_LEN));
+
+			ADD_FILTER_TEST(&test_filter_epfs::reference);
+		}
+
+		/// Decode the same data with libgamecommon's LZW decompressor
+		void reference()
+		{
+			this->lzw_reference<LZWParams_EPFS>();
+		}
+};
+
+IMPLEMENT_TESTS(filter_epfs);
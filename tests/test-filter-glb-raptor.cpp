@@ -42,6 +42,36 @@ class test_filter_glb_raptor_file: public test_filter
 				"\x00\x00\x00\x00\xFF\x05\x00\x00" "\x00\x00\x00\x00\x00\x00\x00\x00" "\x00\x00\x00\x00\x00\x00\x00\x00" "\x00\x00\x00\x00"
 				"\x00\x00\x00\x00\x00\xA8\x00\x00"
 			));
+
+			ADD_FILTER_TEST(&test_filter_glb_raptor_file::long_data);
+		}
+
+		/// Encrypt then decrypt enough data to use the vectorised decrypter
+		void long_data()
+		{
+			auto sTemp = std::make_unique<stream::output_string>();
+			auto& sEncrypted_data = sTemp->data;
+			auto sEncrypted = this->apply_out(std::move(sTemp), nullptr);
+
+			std::string src;
+			uint32_t x = 1;
+			for (unsigned int i = 0; i < 5000; i++) {
+				x = x * 1103515245 + 12345;
+				src += (char)(x >> 24);
+			}
+			sEncrypted->write(src);
+			sEncrypted->flush();
+
+			auto input = this->apply_in(std::make_unique<stream::string>(sEncrypted_data));
+
+			BOOST_TEST_CHECKPOINT("Read back through in filter");
+			auto filterResult = std::make_unique<stream::string>();
+			stream::copy(*filterResult, *input);
+
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(src, filterResult->data),
+				"Encrypting then decrypting GLB data produced incorrect result"
+			);
 		}
 };
 
@@ -65,6 +95,36 @@ class test_filter_glb_raptor_fat: public test_filter
 				"\x00\x00\x00\x00\xFF\x05\x00\x00" "\x00\x00\x00\x00\x00\x00\x00\x00" "\x00\x00\x00\x00\x00\x00\x00\x00" "\x00\x00\x00\x00"
 				"\x00\x00\x00\x00\x00\xA8\x00\x00"
 			));
+
+			ADD_FILTER_TEST(&test_filter_glb_raptor_fat::long_data);
+		}
+
+		/// Encrypt then decrypt enough data to use the vectorised decrypter
+		void long_data()
+		{
+			auto sTemp = std::make_unique<stream::output_string>();
+			auto& sEncrypted_data = sTemp->data;
+			auto sEncrypted = this->apply_out(std::move(sTemp), nullptr);
+
+			std::string src;
+			uint32_t x = 1;
+			for (unsigned int i = 0; i < 5000; i++) {
+				x = x * 1103515245 + 12345;
+				src += (char)(x >> 24);
+			}
+			sEncrypted->write(src);
+			sEncrypted->flush();
+
+			auto input = this->apply_in(std::make_unique<stream::string>(sEncrypted_data));
+
+			BOOST_TEST_CHECKPOINT("Read back through in filter");
+			auto filterResult = std::make_unique<stream::string>();
+			stream::copy(*filterResult, *input);
+
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(src, filterResult->data),
+				"Encrypting then decrypting GLB data produced incorrect result"
+			);
 		}
 };
 
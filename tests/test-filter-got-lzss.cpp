@@ -47,6 +47,46 @@ class test_filter_got_lzss: public test_filter
 			), STRING_WITH_NULLS(
 				"ABCDE"
 			));
+
+			this->content("repeat", 12, STRING_WITH_NULLS(
+				"\x0C\x00\x01\x00" "\xF7" "ABC" "\x03\x70"
+			), STRING_WITH_NULLS(
+				"ABCABCABCABC"
+			));
+
+			// Runs longer than the longest back-reference
+			this->content("run", 40, STRING_WITH_NULLS(
+				"\x28\x00\x01\x00" "\xF1" "A" "\x01\xF0" "\x01\xF0" "\x01\x30"
+			), STRING_WITH_NULLS(
+				"AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+			));
+
+			// Long enough to go through the whole-group decoder
+			this->content_decode("backref_group", STRING_WITH_NULLS(
+				"\x90\x00\x01\x00"
+				"\xFF""ABCDEFGH"
+				"\x00"
+				"\x08\xF0" "\x08\xF0" "\x08\xF0" "\x08\xF0"
+				"\x08\xF0" "\x08\xF0" "\x08\xF0" "\x08\xF0"
+			), STRING_WITH_NULLS(
+				"ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH"
+				"ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH"
+				"ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH" "ABCDEFGH"
+			));
+
+			// Distance of zero reaches back 4096 bytes, into the initial zeroes
+			this->content_decode("backref_zero", STRING_WITH_NULLS(
+				"\x04\x00\x01\x00" "\x03" "AB" "\x00\x00"
+			), STRING_WITH_NULLS(
+				"AB\x00\x00"
+			));
+
+			// Copy overlaps the data being written
+			this->content_decode("backref_overlap", STRING_WITH_NULLS(
+				"\x12\x00\x01\x00" "\x01" "A" "\x01\xF0"
+			), STRING_WITH_NULLS(
+				"AAAAAAAAAAAAAAAAAA"
+			));
 		}
 };
 
@@ -67,6 +67,14 @@ class test_filter_prehistorik: public test_filter
 			STRING_WITH_NULLS(
 				"Hello hello hello."
 			));
+
+			{
+				std::string plain;
+				for (unsigned int i = 0; i < 20000; i++) {
+					plain += (char)((i / 7) ^ (i % 13));
+				}
+				this->content_checkpoint("long", plain);
+			}
 		}
 };
 
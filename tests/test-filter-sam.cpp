@@ -39,6 +39,23 @@ class test_filter_sam: public test_filter
 			), STRING_WITH_NULLS(
 				"\x00\x01\x02\x03\xFF\xFF\xFF\xFF"
 			));
+
+			// Two whole rows, so the key restarts and each row ends in a zero
+			this->content_decode("rows", STRING_WITH_NULLS(
+				"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+				"\x00\x00\x00\x00"
+			), STRING_WITH_NULLS(
+				"\x43\x6F\x70\x79\x72\x69\x67\x68\x74\x20\x31\x39\x39\x31\x20\x50"
+				"\x65\x64\x65\x72\x20\x4A\x75\x6E\x67\x63\x6B\x00\x43\x6F\x70\x79"
+				"\x72\x69\x67\x68\x74\x20\x31\x39\x39\x00\x43\x6F\x70\x79\x72\x69"
+				"\x67\x68\x74\x20\x31\x39\x39\x31\x20\x50\x65\x64\x65\x72\x20\x4A"
+				"\x75\x6E\x67\x63\x6B\x00\x43\x6F\x70\x79\x72\x69\x67\x68\x74\x20"
+				"\x31\x39\x39\x00"
+			));
 		}
 };
 
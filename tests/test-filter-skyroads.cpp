@@ -0,0 +1,138 @@
+/**
+ * @file   test-filter-skyroads.cpp
+ * @brief  Test code for SkyRoads LZS compression.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test-filter.hpp"
+#include "../src/filter-skyroads.hpp"
+
+using namespace camoto::gamearchive;
+
+class test_filter_skyroads: public test_filter
+{
+	public:
+		test_filter_skyroads()
+		{
+			this->type = "lzs-skyroads";
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// Short-distance code width is too large
+			this->invalidContent(STRING_WITH_NULLS(
+				"\x04\x30\x0A"
+				"\xD0\x74\x2D\x0F\x44\xD1\x7F"
+			));
+
+			// No matches, so the default code widths are kept
+			this->content("literal", 5, STRING_WITH_NULLS(
+				"\x04\x06\x0A"
+				"\xD0\x74\x2D\x0F\x44\xD1\x7F"
+			), STRING_WITH_NULLS(
+				"ABCDE"
+			));
+
+			// Narrowest widths that fit the one back-reference
+			this->content("repeat", 10, STRING_WITH_NULLS(
+				"\x03\x01\x01"
+				"\xD0\x74\x23\x7F"
+			), STRING_WITH_NULLS(
+				"ABABABABAB"
+			));
+
+			this->content("run", 20, STRING_WITH_NULLS(
+				"\x05\x01\x01"
+				"\xD0\x74\x12\x1F"
+			), STRING_WITH_NULLS(
+				"AAAAAAAAAAAAAAAAAAAA"
+			));
+		}
+};
+
+IMPLEMENT_TESTS(filter_skyroads);
+
+/// Same as above but with the fast compressor, which keeps the default widths.
+class test_filter_skyroads_fast: public test_filter
+{
+	public:
+		test_filter_skyroads_fast()
+		{
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// Back-reference code ends in the last byte, so the decoder has to
+			// finish it after all the input has been read
+			this->content("repeat", 10, STRING_WITH_NULLS(
+				"\x04\x06\x0A"
+				"\xD0\x74\x20\x0D"
+			), STRING_WITH_NULLS(
+				"ABABABABAB"
+			));
+
+			// Run longer than the longest back-reference
+			this->content("run", 20, STRING_WITH_NULLS(
+				"\x04\x06\x0A"
+				"\xD0\x74\x10\x1F\xA0\xFF"
+			), STRING_WITH_NULLS(
+				"AAAAAAAAAAAAAAAAAAAA"
+			));
+		}
+
+		std::unique_ptr<stream::input> apply_in(
+			std::unique_ptr<stream::input> content)
+		{
+			return std::make_unique<stream::input_filtered>(
+				std::move(content),
+				std::make_unique<filter_skyroads_unlzs>()
+			);
+		}
+
+		std::unique_ptr<stream::output> apply_out(
+			std::unique_ptr<stream::output> content, stream::len *setPrefiltered)
+		{
+			return std::make_unique<stream::output_filtered>(
+				std::move(content),
+				std::make_unique<filter_skyroads_lzs>(
+					filter_skyroads_lzs::Effort::Fast),
+				[setPrefiltered](stream::output_filtered* s, stream::len l) {
+					if (setPrefiltered) *setPrefiltered = l;
+				}
+			);
+		}
+
+		std::unique_ptr<stream::inout> apply_inout(
+			std::unique_ptr<stream::inout> content, stream::len *setPrefiltered)
+		{
+			return std::make_unique<stream::filtered>(
+				std::move(content),
+				std::make_unique<filter_skyroads_unlzs>(),
+				std::make_unique<filter_skyroads_lzs>(
+					filter_skyroads_lzs::Effort::Fast),
+				[setPrefiltered](stream::output_filtered* s, stream::len l) {
+					if (setPrefiltered) *setPrefiltered = l;
+				}
+			);
+		}
+};
+
+IMPLEMENT_TESTS(filter_skyroads_fast);
@@ -0,0 +1,125 @@
+/**
+ * @file   test-filter-stargunner.cpp
+ * @brief  Test code for Stargunner compression.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test-filter.hpp"
+#include "../src/filter-stargunner.hpp"
+
+using namespace camoto::gamearchive;
+
+class test_filter_stargunner: public test_filter
+{
+	public:
+		test_filter_stargunner()
+		{
+			this->type = "bpe-stargunner";
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// No pairs repeat, so the dictionary is empty
+			this->content("short", 5, STRING_WITH_NULLS(
+				"PGBP" "\x05\x00\x00\x00"
+				"\x0A\x00" "\xFF\x80\xFE" "\x05\x00" "ABCDE"
+			), STRING_WITH_NULLS(
+				"ABCDE"
+			));
+
+			this->content("repeat", 8, STRING_WITH_NULLS(
+				"PGBP" "\x08\x00\x00\x00"
+				"\x0C\x00" "\x00" "AB" "\xFF\x81\xFD" "\x04\x00" "\x00\x00\x00\x00"
+			), STRING_WITH_NULLS(
+				"ABABABAB"
+			));
+
+			// Codewords that expand to other codewords
+			this->content("nested", 20, STRING_WITH_NULLS(
+				"PGBP" "\x14\x00\x00\x00"
+				"\x11\x00" "\x02" "AB" "\x00" "C" "\x01" "D" "\xFF\x83\xFB"
+				"\x05\x00" "\x02\x02\x02\x02\x02"
+			), STRING_WITH_NULLS(
+				"ABCDABCDABCDABCDABCD"
+			));
+
+			ADD_FILTER_TEST(&test_filter_stargunner::compress_chunks);
+			ADD_FILTER_TEST(&test_filter_stargunner::compress_random);
+			ADD_FILTER_TEST(&test_filter_stargunner::compress_threads);
+		}
+
+		/// Compress then decompress data.
+		void roundtrip(const std::string& src)
+		{
+			auto sTemp = std::make_unique<stream::output_string>();
+			auto& sCompressed_data = sTemp->data;
+			auto sCompressed = this->apply_out(std::move(sTemp), nullptr);
+			sCompressed->write(src);
+			sCompressed->flush();
+
+			auto input = this->apply_in(std::make_unique<stream::string>(sCompressed_data));
+
+			BOOST_TEST_CHECKPOINT("Read back through in filter");
+			auto filterResult = std::make_unique<stream::string>();
+			stream::copy(*filterResult, *input);
+
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(src, filterResult->data),
+				"Compressing then decompressing Stargunner data produced incorrect result"
+			);
+		}
+
+		/// Compress several chunks, the last one partial
+		void compress_chunks()
+		{
+			std::string src;
+			for (unsigned int i = 0; i < 10000; i++) {
+				src += (char)('A' + (i / 7) % 26);
+			}
+			this->roundtrip(src);
+		}
+
+		/// Compress data that uses every byte value, leaving no codewords free
+		void compress_random()
+		{
+			std::string src;
+			uint32_t x = 1;
+			for (unsigned int i = 0; i < 20000; i++) {
+				x = x * 1103515245 + 12345;
+				src += (char)(x >> 24);
+			}
+			this->roundtrip(src);
+		}
+
+		/// Compressing chunks on several threads must give the same result
+		void compress_threads()
+		{
+			std::string src = test_filter::varied(CHUNK_SIZE * 5 + 100);
+			std::string serial = test_filter::filter_string(src,
+				std::make_shared<filter_stargunner_compress>());
+			std::string threaded = test_filter::filter_string(src,
+				std::make_shared<filter_stargunner_compress>(4));
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(serial, threaded),
+				"Compressing on several threads produced a different result"
+			);
+		}
+};
+
+IMPLEMENT_TESTS(filter_stargunner);
@@ -0,0 +1,94 @@
+/**
+ * @file   test-filter-stellar7.cpp
+ * @brief  Test code for Stellar 7 decompression.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <camoto/bitstream.hpp>
+#include <camoto/filter-lzw.hpp>
+#include "test-filter.hpp"
+#include "../src/filter-stellar7.hpp"
+
+using namespace camoto;
+using namespace camoto::gamearchive;
+
+class test_filter_stellar7: public test_filter
+{
+	public:
+		test_filter_stellar7()
+		{
+			this->type = "lzw-stellar7";
+		}
+
+		void addTests()
+		{
+			this->test_filter::addTests();
+
+			// First codeword is past the end of the dictionary
+			this->invalidContent(STRING_WITH_NULLS(
+				"\x2C\x01"
+			));
+
+			{
+				// Dictionary codewords, including one used in the same step it is
+				// added to the dictionary.
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				const unsigned int codes[] = {
+					'A', 'B', 257, 259
+				};
+				for (auto c : codes) {
+					bit_exp.write(9, c);
+				}
+				bit_exp.flushByte();
+
+				this->content_decode("dictionary", exp->data, STRING_WITH_NULLS(
+					"ABABABA"
+				));
+			}
+
+			{
+				// The codeword after a dictionary reset starts on a 16-bit boundary
+				std::shared_ptr<stream::string> exp(new stream::string());
+				bitstream bit_exp(exp, bitstream::littleEndian);
+				bit_exp.write(9, 'A');
+				bit_exp.write(9, 256);
+				bit_exp.write(14, 0);
+				bit_exp.write(9, 'B');
+				bit_exp.write(9, 'C');
+				bit_exp.write(9, 257);
+				bit_exp.flushByte();
+
+				this->content_decode("reset", exp->data, STRING_WITH_NULLS(
+					"ABCBC"
+				));
+			}
+
+			// Long enough that the encoder runs past the largest codeword size
+			this->content_roundtrip("long", test_filter::varied(LZW_LONG_LEN));
+
+			ADD_FILTER_TEST(&test_filter_stellar7::reference);
+		}
+
+		/// Decode the same data with libgamecommon's LZW decompressor
+		void reference()
+		{
+			this->lzw_reference<LZWParams_Stellar7>();
+		}
+};
+
+IMPLEMENT_TESTS(filter_stellar7);
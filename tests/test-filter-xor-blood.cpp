@@ -18,7 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "test-filter.hpp"
+#include "test-filter-xor.hpp"
 #include "../src/filter-xor-blood.hpp"
 
 using namespace camoto::gamearchive;
@@ -39,6 +39,17 @@ class test_filter_xor_blood: public test_filter
 			), STRING_WITH_NULLS(
 				"\x00\x01\x03\x02\xFD\xFD\xFC\xFC"
 			));
+
+			ADD_FILTER_TEST(&test_filter_xor_blood::long_data);
+		}
+
+		/// Decrypt more data than fits in one key block with each kernel
+		void long_data()
+		{
+			test_xor_kernels(*this,
+				[]() { return std::make_shared<filter_rff_crypt>(0, 0); },
+				[](unsigned int i) { return (uint8_t)(i >> 1); }
+			);
 		}
 
 		std::unique_ptr<stream::input> apply_in(
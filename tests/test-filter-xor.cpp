@@ -18,8 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "test-filter.hpp"
-#include "../src/filter-xor.hpp"
+#include "test-filter-xor.hpp"
 
 using namespace camoto::gamearchive;
 
@@ -39,6 +38,17 @@ class test_filter_xor: public test_filter
 			), STRING_WITH_NULLS(
 				"\x00\x00\x00\x00\xFB\xFA\xF9\xF8"
 			));
+
+			ADD_FILTER_TEST(&test_filter_xor::long_data);
+		}
+
+		/// Decrypt more data than fits in one key block with each kernel
+		void long_data()
+		{
+			test_xor_kernels(*this,
+				[]() { return std::make_shared<filter_xor_crypt>(0, 0); },
+				[](unsigned int i) { return (uint8_t)i; }
+			);
 		}
 
 		std::unique_ptr<stream::input> apply_in(
@@ -0,0 +1,81 @@
+/**
+ * @file   test-filter-xor.hpp
+ * @brief  Test code shared by the XOR encryption filters.
+ *
+ * Copyright (C) 2010-2016 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEARCHIVE_TEST_FILTER_XOR_HPP_
+#define _CAMOTO_GAMEARCHIVE_TEST_FILTER_XOR_HPP_
+
+#include <functional>
+#include <camoto/stream_filtered.hpp>
+#include "test-filter.hpp"
+#include "../src/filter-xor.hpp"
+
+/// Decrypt more data than fits in one key block with every XOR kernel.
+/**
+ * The plain C++ kernel must produce the data XOR'd with the expected keys, and
+ * every vector kernel the CPU can run must then produce the same result.
+ *
+ * @param test
+ *   Test being run, for comparing the results.
+ *
+ * @param create
+ *   Create a new instance of the filter being tested.
+ *
+ * @param key
+ *   Get the key byte the filter should use at the given offset.
+ */
+inline void test_xor_kernels(test_main& test,
+	std::function<std::shared_ptr<filter_xor_crypt>()> create,
+	std::function<uint8_t(unsigned int)> key)
+{
+	std::string src, expected;
+	for (unsigned int i = 0; i < 5000; i++) {
+		src += (char)(i * 7);
+		expected += (char)((uint8_t)(i * 7) ^ key(i));
+	}
+
+	std::string scalar;
+	for (auto& k : filter_xor_crypt::kernels()) {
+		BOOST_TEST_CHECKPOINT("Decrypt with " << k.name << " kernel");
+		auto crypt = create();
+		crypt->setKernel(k.fn);
+
+		stream::input_filtered input(
+			std::make_shared<stream::input_string>(src), crypt
+		);
+		stream::string result;
+		stream::copy(result, input);
+
+		if (k.fn == filter_xor_crypt::kernels().front().fn) {
+			BOOST_REQUIRE_MESSAGE(
+				test.is_equal(expected, result.data),
+				"Decrypting data longer than one key block produced incorrect result"
+			);
+			scalar = result.data;
+		} else {
+			BOOST_REQUIRE_MESSAGE(
+				test.is_equal(scalar, result.data),
+				createString("Decrypting with the " << k.name
+					<< " kernel gave a different result to the scalar kernel")
+			);
+		}
+	}
+}
+
+#endif // _CAMOTO_GAMEARCHIVE_TEST_FILTER_XOR_HPP_
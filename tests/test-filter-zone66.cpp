@@ -35,10 +35,9 @@ class test_filter_zone66: public test_filter
 		{
 			this->test_filter::addTests();
 
-			// Decode some data compressed with the official compressor.  We can't
-			// compress this and get an exact match, since we don't match the original
-			// compressor byte-for-byte, we just produce a compatible file.
-			this->content_decode("official", STRING_WITH_NULLS(
+			// Data compressed with the official compressor.  This builds the
+			// dictionary the same way, so it produces identical output.
+			this->content("official", 768, STRING_WITH_NULLS(
 				"\x00\x03\x00\x00\x00\x00\x40\x00\x05\x40\x10\x20\x01\x51\x54\x0c"
 				"\xa8\x00\x54\x2a\x15\x83\x15\x41\xc5\x42\xa2\xa1\x53\xf8\x58\xac"
 				"\x2c\xfc\x7e\x2b\x0c\x3f\x1f\x9f\xc3\x4f\xc7\x67\x63\xb3\x41\xa1"
@@ -134,8 +133,9 @@ class test_filter_zone66: public test_filter
 				"\x00\x3f\x00\x00\x10\x2d\x20\x13\x33\x26\x3f\x15\x00\x3f\x3f\x3f"
 			));
 
-			// This data matches the Camoto compressor so works both ways
-			this->content("camoto", 32, STRING_WITH_NULLS(
+			// Older versions of Camoto wrote every byte as a literal, which must
+			// still decode
+			this->content_decode("literal_only", STRING_WITH_NULLS(
 				"\x20\x00\x00\x00"
 				"\x00\x00\x00\x00\x00\x05\x40\x02\xa0\x00\x00\xa8\xa8\x54\x00\x00"
 				"\x2a\x00\x15\x0a\x85\x40\x05\x42\xa2\xa0\xa8\xa8\x54\x54\x2a\x7e"
@@ -146,6 +146,7 @@ class test_filter_zone66: public test_filter
 			));
 
 			ADD_FILTER_TEST(&test_filter_zone66::compress_20k);
+			ADD_FILTER_TEST(&test_filter_zone66::compress_reset);
 		}
 
 		/// Compress >20k bytes in Zone 66 format
@@ -174,6 +175,34 @@ class test_filter_zone66: public test_filter
 				"Compressing then decompressing Zone 66 data produced incorrect result"
 			);
 		}
+
+		/// Compress enough varied data to fill the dictionary several times
+		void compress_reset()
+		{
+			auto sTemp = std::make_unique<stream::output_string>();
+			auto& sCompressed_data = sTemp->data;
+			auto sCompressed = this->apply_out(std::move(sTemp), nullptr);
+
+			std::string src;
+			uint32_t x = 1;
+			for (unsigned int i = 0; i < 65536; i++) {
+				x = x * 1103515245 + 12345;
+				src += (char)(x >> 24);
+			}
+			sCompressed->write(src);
+			sCompressed->flush();
+
+			auto input = this->apply_in(std::make_unique<stream::string>(sCompressed_data));
+
+			BOOST_TEST_CHECKPOINT("Read back through in filter");
+			auto filterResult = std::make_unique<stream::string>();
+			stream::copy(*filterResult, *input);
+
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(src, filterResult->data),
+				"Compressing then decompressing Zone 66 data produced incorrect result"
+			);
+		}
 };
 
 IMPLEMENT_TESTS(filter_zone66);
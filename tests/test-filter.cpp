@@ -21,6 +21,7 @@
 #include <iomanip>
 #include <functional>
 #include <camoto/util.hpp>
+#include <camoto/stream_filtered.hpp>
 #include "test-filter.hpp"
 
 using namespace camoto;
@@ -142,6 +143,13 @@ void test_filter::content_decode(const std::string& name,
 		createString("content_read_inout/" << name)
 	);
 
+	// Decode in one go
+	this->addBoundTest(
+		std::bind(&test_filter::test_content_decode_all, this, filtered, plain),
+		__FILE__, __LINE__,
+		createString("content_decode_all/" << name)
+	);
+
 	return;
 }
 
@@ -168,6 +176,114 @@ void test_filter::content_encode(const std::string& name,
 	return;
 }
 
+void test_filter::content_roundtrip(const std::string& name,
+	const std::string& plain)
+{
+	this->addBoundTest(
+		std::bind(&test_filter::test_content_roundtrip, this, plain),
+		__FILE__, __LINE__,
+		createString("content_roundtrip/" << name)
+	);
+
+	return;
+}
+
+void test_filter::content_checkpoint(const std::string& name,
+	const std::string& plain)
+{
+	this->addBoundTest(
+		std::bind(&test_filter::test_content_checkpoint, this, plain),
+		__FILE__, __LINE__,
+		createString("content_checkpoint/" << name)
+	);
+
+	return;
+}
+
+std::string test_filter::encode(const std::string& plain)
+{
+	auto filterResult = std::make_unique<stream::output_string>();
+	auto& filterResult_data = filterResult->data;
+
+	auto output = this->apply_out(std::move(filterResult), nullptr);
+	output->write(plain);
+	output->flush();
+
+	return filterResult_data;
+}
+
+std::string test_filter::filter_string(const std::string& content,
+	std::shared_ptr<filter> fn)
+{
+	stream::input_filtered input(
+		std::make_shared<stream::input_string>(content), fn
+	);
+	stream::string result;
+	stream::copy(result, input);
+	return result.data;
+}
+
+std::string test_filter::varied(stream::len len)
+{
+	std::string data;
+	data.reserve(len);
+	uint32_t seed = 1;
+	while (data.length() < len) {
+		seed = seed * 1103515245 + 12345;
+		unsigned int run = (seed >> 16) & 0x0F;
+		if (run < 4) data.append(run + 2, (char)(seed >> 8));
+		else data += (char)(seed >> 24);
+	}
+	data.resize(len);
+	return data;
+}
+
+void test_filter::test_content_roundtrip(const std::string& plain)
+{
+	BOOST_TEST_MESSAGE(this->basename << ": "
+		<< boost::unit_test::framework::current_test_case().p_name);
+
+	BOOST_TEST_CHECKPOINT("Write through output filter");
+	std::string filtered = this->encode(plain);
+
+	this->test_content_read_in(filtered, plain);
+	this->test_content_read_inout(filtered, plain);
+	this->test_content_decode_all(filtered, plain);
+
+	return;
+}
+
+void test_filter::test_content_checkpoint(const std::string& plain)
+{
+	BOOST_TEST_MESSAGE(this->basename << ": "
+		<< boost::unit_test::framework::current_test_case().p_name);
+
+	BOOST_REQUIRE_MESSAGE(this->pFilterType, "Must specify type in test case");
+	std::string filtered = this->encode(plain);
+
+	auto index = std::make_shared<CheckpointIndex>(1024);
+	input_checkpointed input(std::make_unique<stream::string>(filtered),
+		this->pFilterType->decoders(), index);
+	BOOST_REQUIRE_EQUAL(input.size(), plain.length());
+	BOOST_CHECK_EQUAL(index->count(), plain.length() / 1024);
+
+	stream::pos len = plain.length();
+	for (stream::pos off : {len * 3 / 4, (stream::pos)100, (stream::pos)1024,
+		len - 10, len / 4, len / 4 + 1, (stream::pos)0}
+	) {
+		input.seekg(off, stream::start);
+		stream::len lenRead = std::min<stream::len>(500, len - off);
+		std::string data = input.read(lenRead);
+		BOOST_REQUIRE_MESSAGE(
+			this->is_equal(plain.substr(off, lenRead), data),
+			createString("Reading from a checkpoint at offset " << off
+				<< " produced incorrect result")
+		);
+	}
+
+	return;
+}
+
 void test_filter::test_content_read_in(const std::string& filtered,
 	const std::string& plain)
 {
@@ -213,6 +329,39 @@ void test_filter::test_content_read_inout(const std::string& filtered,
 	return;
 }
 
+void test_filter::test_content_decode_all(const std::string& filtered,
+	const std::string& plain)
+{
+	BOOST_TEST_MESSAGE(this->basename << ": "
+		<< boost::unit_test::framework::current_test_case().p_name);
+
+	// Tests with their own apply functions have no filter type to call
+	if (!this->pFilterType) return;
+
+	const uint8_t *in = (const uint8_t *)filtered.data();
+
+	BOOST_TEST_CHECKPOINT("Decode with the correct size");
+	std::vector<uint8_t> out(plain.size());
+	if (!this->pFilterType->decodeAll(in, filtered.size(), &out)) {
+		BOOST_TEST_MESSAGE("Filter doesn't support decodeAll(), skipping");
+		return;
+	}
+	BOOST_REQUIRE_MESSAGE(
+		this->is_equal(plain, std::string(out.begin(), out.end())),
+		"Decoding in one go produced incorrect result"
+	);
+
+	BOOST_TEST_CHECKPOINT("Decode without knowing the size");
+	out.clear();
+	BOOST_REQUIRE(this->pFilterType->decodeAll(in, filtered.size(), &out));
+	BOOST_REQUIRE_MESSAGE(
+		this->is_equal(plain, std::string(out.begin(), out.end())),
+		"Decoding in one go without the size produced incorrect result"
+	);
+
+	return;
+}
+
 void test_filter::test_content_write_out(const std::string& filtered,
 	const std::string& plain, stream::len prefilteredSize)
 {
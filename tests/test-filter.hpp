@@ -24,6 +24,8 @@
 #include <map>
 #include <functional>
 #include <boost/test/unit_test.hpp>
+#include <camoto/filter.hpp>
+#include <camoto/filter-lzw.hpp>
 #include <camoto/stream_string.hpp>
 #include <camoto/gamearchive.hpp>
 #include "tests.hpp"
@@ -98,6 +100,120 @@ class test_filter: public test_main
 		void content_encode(const std::string& name, stream::len prefilteredSize,
 			const std::string& filtered, const std::string& plain);
 
+		/// Add a decoding test for data produced by the filter's own encoder.
+		/**
+		 * This is for data too long to list the filtered bytes by hand, such as
+		 * enough to fill a compressor's dictionary.
+		 *
+		 * @param name
+		 *   Name to identify the test in error messages.
+		 *
+		 * @param plain
+		 *   Unfiltered content, passed through apply_out() to get the filtered
+		 *   data which must then decode back to this.
+		 */
+		void content_roundtrip(const std::string& name, const std::string& plain);
+
+		/// Add a test reading from all over a long file, resuming from saved
+		/// checkpoints.
+		/**
+		 * @param name
+		 *   Name to identify the test in error messages.
+		 *
+		 * @param plain
+		 *   Unfiltered content, passed through apply_out() and then read back
+		 *   through input_checkpointed.
+		 */
+		void content_checkpoint(const std::string& name, const std::string& plain);
+
+		/// Pass plain data through apply_out() and return the filtered result.
+		std::string encode(const std::string& plain);
+
+		/// Pass data through a single filter and return the result.
+		static std::string filter_string(const std::string& content,
+			std::shared_ptr<filter> fn);
+
+		/// Generate repeatable data mixing short runs and noise.
+		static std::string varied(stream::len len);
+
+		/// Length of varied() data long enough to fill an LZW dictionary several
+		/// times over.
+		static constexpr stream::len LZW_LONG_LEN = 120000;
+
+		/// Compare an LZW filter against libgamecommon's LZW filters.
+		/**
+		 * LZW_LONG_LEN bytes of varied() data are encoded with this filter, then
+		 * decoded both with this filter and with filter_lzw_decompress, and the
+		 * two results must match.
+		 *
+		 * @param Params
+		 *   LZW parameters of the filter being tested, as passed to
+		 *   filter_lzw_static_decompress.
+		 *
+		 * @param rle
+		 *   Optional filter run over the plain data before LZW compression.  If
+		 *   given, the encoded data must also match this followed by
+		 *   filter_lzw_compress.
+		 *
+		 * @param unrle
+		 *   Filter run after filter_lzw_decompress to undo rle, or nullptr.
+		 */
+		template<class Params>
+		void lzw_reference(std::shared_ptr<filter> rle = nullptr,
+			std::shared_ptr<filter> unrle = nullptr)
+		{
+			std::string plain = test_filter::varied(LZW_LONG_LEN);
+			std::string filtered = this->encode(plain);
+
+			// Every codeword is at most maxBits long, so this guarantees the data
+			// has widened all the way and gone past a full dictionary.
+			BOOST_REQUIRE_MESSAGE(
+				filtered.length() * 8 / Params::maxBits > (1u << Params::maxBits),
+				"Sample data too short to fill the dictionary"
+			);
+
+			if (rle) {
+				std::string expFiltered = test_filter::filter_string(
+					test_filter::filter_string(plain, rle),
+					std::make_shared<filter_lzw_compress>(
+						Params::initialBits,
+						Params::maxBits,
+						Params::firstCode,
+						Params::eofCode,
+						Params::resetCode,
+						Params::flags
+					)
+				);
+				BOOST_REQUIRE_MESSAGE(
+					this->is_equal(expFiltered, filtered),
+					"Encoding differs from the RLE stage + filter_lzw_compress"
+				);
+			}
+
+			std::string expected = test_filter::filter_string(filtered,
+				std::make_shared<filter_lzw_decompress>(
+					Params::initialBits,
+					Params::maxBits,
+					Params::firstCode,
+					Params::eofCode,
+					Params::resetCode,
+					Params::flags
+				)
+			);
+			if (unrle) expected = test_filter::filter_string(expected, unrle);
+
+			auto input = this->apply_in(
+				std::make_unique<stream::input_string>(filtered)
+			);
+			stream::string result;
+			stream::copy(result, *input);
+
+			BOOST_REQUIRE_MESSAGE(
+				this->is_equal(expected, result.data),
+				"Decoding differs from filter_lzw_decompress"
+			);
+		}
+
 		virtual std::unique_ptr<stream::input> apply_in(
 			std::unique_ptr<stream::input> content);
 
@@ -120,6 +236,16 @@ class test_filter: public test_main
 		void test_content_read_inout(const std::string& filtered,
 			const std::string& plain);
 
+		/// Perform a content check now, decoding with FilterType::decodeAll().
+		void test_content_decode_all(const std::string& filtered,
+			const std::string& plain);
+
+		/// Perform a content_roundtrip check now.
+		void test_content_roundtrip(const std::string& plain);
+
+		/// Perform a content_checkpoint check now.
+		void test_content_checkpoint(const std::string& plain);
+
 		/// Perform a content check now, writing the data through a stream::output.
 		void test_content_write_out(const std::string& filtered,
 			const std::string& plain, stream::len prefilteredSize);
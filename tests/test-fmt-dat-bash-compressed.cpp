@@ -86,6 +86,158 @@ class test_dat_bash_compressed: public test_archive
 				"\x20\x00" "\x12\x00"
 					"TWO.DA"
 			));
+
+			ADD_ARCH_TEST(false, &test_dat_bash_compressed::test_decoded_cache);
+			ADD_ARCH_TEST(false, &test_dat_bash_compressed::test_read_whole_or_part);
+			ADD_ARCH_TEST(false, &test_dat_bash_compressed::test_checkpoint_rewrite);
+		}
+
+		/// Seek into a file after rewriting it with data of the same size
+		void test_checkpoint_rewrite()
+		{
+			BOOST_TEST_MESSAGE(this->basename << ": Seeking with checkpoints after "
+				"rewriting a file at the same size");
+
+			auto ep = this->findFile(0);
+			auto index = std::make_shared<CheckpointIndex>(4);
+			{
+				auto pfsIn = openCheckpointed(this->pArchive, ep, index);
+				stream::string out;
+				stream::copy(out, *pfsIn);
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(this->content[0], out.data),
+					"Error reading file through checkpoints"
+				);
+			}
+			BOOST_REQUIRE_GT(index->count(), 0);
+
+			// Replace the compressed data with the second file's, which is the same
+			// size, without going through the filter.
+			std::string raw;
+			{
+				auto pfsOther = this->pArchive->open(this->findFile(1), false);
+				stream::string out;
+				stream::copy(out, *pfsOther);
+				raw = out.data;
+			}
+			BOOST_REQUIRE_EQUAL(raw.length(), ep->storedSize);
+			{
+				auto pfsRaw = this->pArchive->open(ep, false);
+				pfsRaw->seekp(0, stream::start);
+				pfsRaw->write(raw);
+				pfsRaw->flush();
+			}
+			BOOST_REQUIRE_EQUAL(raw.length(), ep->storedSize);
+
+			// Seeking must not resume from a checkpoint of the old data
+			auto pfsIn = openCheckpointed(this->pArchive, ep, index);
+			stream::pos off = 8;
+			pfsIn->seekg(off, stream::start);
+			stream::string out;
+			stream::copy(out, *pfsIn);
+			BOOST_CHECK_MESSAGE(
+				this->is_equal(this->content[1].substr(off), out.data),
+				"Seeking used checkpoints from before the file was rewritten"
+			);
+		}
+
+		/// Read a compressed file both in one go and a bit at a time
+		void test_read_whole_or_part()
+		{
+			BOOST_TEST_MESSAGE(this->basename << ": Reading part and all of a file");
+
+			auto ep = this->findFile(0);
+			const std::string& expected = this->content[0];
+
+			// A short read from the start, as if only reading a header
+			{
+				auto pfsIn = this->pArchive->open(ep, true);
+				std::string header(4, '\0');
+				pfsIn->read(&header[0], header.length());
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(expected.substr(0, header.length()), header),
+					"Error reading the start of a file"
+				);
+				// Then the rest of it
+				stream::string out;
+				stream::copy(out, *pfsIn);
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(expected.substr(header.length()), out.data),
+					"Error reading the rest of a file after its start"
+				);
+			}
+
+			// The whole file in one read, which decodes it all at once
+			{
+				auto pfsIn = this->pArchive->open(ep, true);
+				std::string all(ep->realSize, '\0');
+				BOOST_REQUIRE_EQUAL(pfsIn->try_read((uint8_t *)&all[0], all.length()),
+					expected.length());
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(expected, all),
+					"Error reading a whole file in one go"
+				);
+				BOOST_CHECK_EQUAL(pfsIn->size(), expected.length());
+			}
+		}
+
+		/// Open a compressed file repeatedly through the decoded data cache
+		void test_decoded_cache()
+		{
+			BOOST_TEST_MESSAGE(this->basename << ": Reopening a file through the cache");
+
+			auto& cache = DecodedCache::instance();
+			cache.clear();
+			cache.setBudget(1024 * 1024);
+
+			auto ep = this->findFile(0);
+
+			// Only reading the start of a file must not decode it all or track it
+			{
+				auto pfsIn = this->pArchive->open(ep, true);
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(this->content[0].substr(0, 2), pfsIn->read(2)),
+					"Error reading the start of a file with the cache enabled"
+				);
+			}
+			BOOST_CHECK_EQUAL(cache.stats().size, 0);
+			BOOST_CHECK_EQUAL(cache.stats().tracked, 0);
+
+			for (int i = 0; i < 3; i++) {
+				auto pfsIn = this->pArchive->open(ep, true);
+				stream::string out;
+				stream::copy(out, *pfsIn);
+				BOOST_CHECK_MESSAGE(
+					this->is_equal(this->content[0], out.data),
+					"Error reading file through the cache"
+				);
+			}
+			auto stats = cache.stats();
+			BOOST_CHECK_EQUAL(stats.misses, 2);
+			BOOST_CHECK_EQUAL(stats.hits, 2);
+			BOOST_CHECK_EQUAL(stats.size, this->content[0].length());
+
+			// Writing to the file must drop it from the cache
+			{
+				auto pfsNew = this->pArchive->open(ep, true);
+				pfsNew->truncate(this->content0_overwritten.length());
+				pfsNew->seekp(0, stream::start);
+				pfsNew->write(this->content0_overwritten);
+				pfsNew->flush();
+			}
+
+			auto pfsIn = this->pArchive->open(ep, true);
+			stream::string out;
+			stream::copy(out, *pfsIn);
+			BOOST_CHECK_MESSAGE(
+				this->is_equal(this->content0_overwritten, out.data),
+				"Cache returned data from before the file was changed"
+			);
+
+			// Dropping the data must stop the file being tracked too
+			cache.setBudget(0);
+			BOOST_CHECK_EQUAL(cache.stats().tracked, 0);
+			cache.clear();
 		}
 
 		virtual std::string content_12()